@@ -799,6 +799,21 @@ public:
 // info for drawing
 // NOTE: The first member variable *must* be x.
 	fixed_t	 		x,y,z;
+
+// Everything blockmap searches look at before deciding whether an actor is
+// interesting (PIT_CheckThing, P_RadiusAttack and the like) is kept right
+// after the position, so rejecting an actor usually touches one cache line.
+	fixed_t			radius, height;		// for movement checking
+	DWORD			flags;
+	DWORD			flags2;			// Heretic flags
+	DWORD			flags3;			// [RH] Hexen/Heretic actor-dependant behavior made flaggable
+	DWORD			flags4;			// [RH] Even more flags!
+	DWORD			flags5;			// OMG! We need another one.
+	DWORD			flags6;			// Shit! Where did all the flags go?
+	FBlockNode		*BlockNode;			// links in blocks (if needed)
+	WORD			BlockX, BlockY;		// first block linked into with p_actorcells
+	WORD			BlockW, BlockH;		// blocks linked into (BlockW is 0 if none)
+
 	AActor			*snext, **sprev;	// links in sector (if needed)
 	angle_t			angle;
 	WORD			sprite;				// used to find patch_t and flip value
@@ -813,7 +828,6 @@ public:
 
 // interaction info
 	fixed_t			pitch, roll;
-	FBlockNode		*BlockNode;			// links in blocks (if needed)
 	struct sector_t	*Sector;
 	subsector_t *		subsector;
 	fixed_t			floorz, ceilingz;	// closest together of contacted secs
@@ -823,19 +837,12 @@ public:
 	FTextureID		floorpic;			// contacted sec floorpic
 	struct sector_t	*ceilingsector;
 	FTextureID		ceilingpic;			// contacted sec ceilingpic
-	fixed_t			radius, height;		// for movement checking
 	fixed_t			projectilepassheight;	// height for clipping projectile movement against this actor
 	fixed_t			velx, vely, velz;	// velocity
 	SDWORD			tics;				// state tic counter
 	FState			*state;
 	SDWORD			Damage;			// For missiles and monster railgun
 	int				projectileKickback;
-	DWORD			flags;
-	DWORD			flags2;			// Heretic flags
-	DWORD			flags3;			// [RH] Hexen/Heretic actor-dependant behavior made flaggable
-	DWORD			flags4;			// [RH] Even more flags!
-	DWORD			flags5;			// OMG! We need another one.
-	DWORD			flags6;			// Shit! Where did all the flags go?
 
 	// [BB] If 0, everybody can see the actor, if > 0, only members of team (VisibleToTeam-1) can see it.
 	DWORD			VisibleToTeam;
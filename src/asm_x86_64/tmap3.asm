@@ -5,13 +5,13 @@
 BITS 64
 DEFAULT REL
 
-EXTERN vplce
-EXTERN vince
-EXTERN palookupoffse
-EXTERN bufplce
+EXTERN asm_vplce
+EXTERN asm_vince
+EXTERN asm_palookupoffse
+EXTERN asm_bufplce
 
-EXTERN dc_count
-EXTERN dc_dest
+EXTERN asm_dc_count
+EXTERN asm_dc_dest
 EXTERN dc_pitch
 
 SECTION .text
@@ -57,17 +57,17 @@ END_PROLOGUE
 ; r8d-r11d = column offsets
 ; r12-r15 = palookupoffse[0] - palookupoffse[4]
 
-	mov		ecx, [dc_count]
-	mov		rdi, [dc_dest]
+	mov		ecx, [asm_dc_count]
+	mov		rdi, [asm_dc_dest]
 	test	ecx, ecx
 	jle		vltepilog		; count must be positive
 
-	mov		rax, [bufplce]
-	mov		r8,  [bufplce+8]
+	mov		rax, [asm_bufplce]
+	mov		r8,  [asm_bufplce+8]
 	sub		r8,  rax
-	mov		r9,  [bufplce+16]
+	mov		r9,  [asm_bufplce+16]
 	sub		r9,  rax
-	mov		r10, [bufplce+24]
+	mov		r10, [asm_bufplce+24]
 	sub		r10, rax
 	mov		[source2+4], r8d
 	mov		[source3+4], r9d
@@ -75,15 +75,15 @@ END_PROLOGUE
 
 pm:	imul	rcx, 320
 
-	mov		r12, [palookupoffse]
-	mov		r13, [palookupoffse+8]
-	mov		r14, [palookupoffse+16]
-	mov		r15, [palookupoffse+24]
+	mov		r12, [asm_palookupoffse]
+	mov		r13, [asm_palookupoffse+8]
+	mov		r14, [asm_palookupoffse+16]
+	mov		r15, [asm_palookupoffse+24]
 
-	mov		r8d,  [vince]
-	mov		r9d,  [vince+4]
-	mov		r10d, [vince+8]
-	mov		r11d, [vince+12]
+	mov		r8d,  [asm_vince]
+	mov		r9d,  [asm_vince+4]
+	mov		r10d, [asm_vince+8]
+	mov		r11d, [asm_vince+12]
 	mov		[step1+3], r8d
 	mov		[step2+3], r9d
 	mov		[step3+3], r10d
@@ -92,10 +92,10 @@ pm:	imul	rcx, 320
 	add		rdi, rcx
 	neg		rcx
 
-	mov		r8d,  [vplce]
-	mov		r9d,  [vplce+4]
-	mov		r10d, [vplce+8]
-	mov		r11d, [vplce+12]
+	mov		r8d,  [asm_vplce]
+	mov		r9d,  [asm_vplce+4]
+	mov		r10d, [asm_vplce+8]
+	mov		r11d, [asm_vplce+12]
 	jmp		loopit
 
 ALIGN	16
@@ -128,10 +128,10 @@ source4:	movzx	esi, BYTE [rax+rsi+0x88888888]
 vltpitch:	add		rcx, 320
 			jl		loopit
 
-	mov		[vplce], r8d
-	mov		[vplce+4], r9d
-	mov		[vplce+8], r10d
-	mov		[vplce+12], r11d
+	mov		[asm_vplce], r8d
+	mov		[asm_vplce+4], r9d
+	mov		[asm_vplce+8], r10d
+	mov		[asm_vplce+12], r11d
 
 vltepilog:
 	add		rsp, 8
@@ -46,17 +46,17 @@ vlinetallasm4:
 # r8d-r11d = column offsets
 # r12-r15 = palookupoffse[0] - palookupoffse[4]
 
-		movl		dc_count(%rip), %ecx
-		movq		dc_dest(%rip), %rdi
+		movl		asm_dc_count(%rip), %ecx
+		movq		asm_dc_dest(%rip), %rdi
 		testl		%ecx, %ecx
 		jle			vltepilog	# count must be positive
 
-		movq		bufplce(%rip), %rax
-		movq		bufplce+8(%rip), %r8
+		movq		asm_bufplce(%rip), %rax
+		movq		asm_bufplce+8(%rip), %r8
 		subq		%rax, %r8
-		movq		bufplce+16(%rip), %r9
+		movq		asm_bufplce+16(%rip), %r9
 		subq		%rax, %r9
-		movq		bufplce+24(%rip), %r10
+		movq		asm_bufplce+24(%rip), %r10
 		subq		%rax, %r10
 		movl		%r8d, source2+4(%rip)
 		movl		%r9d, source3+4(%rip)
@@ -64,15 +64,15 @@ vlinetallasm4:
 
 pm:		imulq		$320, %rcx
 
-		movq		palookupoffse(%rip), %r12
-		movq		palookupoffse+8(%rip), %r13
-		movq		palookupoffse+16(%rip), %r14
-		movq		palookupoffse+24(%rip), %r15
+		movq		asm_palookupoffse(%rip), %r12
+		movq		asm_palookupoffse+8(%rip), %r13
+		movq		asm_palookupoffse+16(%rip), %r14
+		movq		asm_palookupoffse+24(%rip), %r15
 
-		movl		vince(%rip), %r8d
-		movl		vince+4(%rip), %r9d
-		movl		vince+8(%rip), %r10d
-		movl		vince+12(%rip), %r11d
+		movl		asm_vince(%rip), %r8d
+		movl		asm_vince+4(%rip), %r9d
+		movl		asm_vince+8(%rip), %r10d
+		movl		asm_vince+12(%rip), %r11d
 		movl		%r8d, step1+3(%rip)
 		movl		%r9d, step2+3(%rip)
 		movl		%r10d, step3+3(%rip)
@@ -81,10 +81,10 @@ pm:		imulq		$320, %rcx
 		addq		%rcx, %rdi
 		negq		%rcx
 
-		movl		vplce(%rip), %r8d
-		movl		vplce+4(%rip), %r9d
-		movl		vplce+8(%rip), %r10d
-		movl		vplce+12(%rip), %r11d
+		movl		asm_vplce(%rip), %r8d
+		movl		asm_vplce+4(%rip), %r9d
+		movl		asm_vplce+8(%rip), %r10d
+		movl		asm_vplce+12(%rip), %r11d
 #		selfmod loopit, vltepilog
 		jmp			loopit
 
@@ -118,10 +118,10 @@ source4:	movzbl	0x44444444(%rax,%rsi), %esi
 vltpitch:	addq	$320, %rcx
 			jl		loopit
 
-		movl		%r8d, vplce(%rip)
-		movl		%r9d, vplce+4(%rip)
-		movl		%r10d, vplce+8(%rip)
-		movl		%r11d, vplce+12(%rip)
+		movl		%r8d, asm_vplce(%rip)
+		movl		%r9d, asm_vplce+4(%rip)
+		movl		%r10d, asm_vplce+8(%rip)
+		movl		%r11d, asm_vplce+12(%rip)
 
 vltepilog:
 		addq		$8, %rsp
@@ -66,6 +66,12 @@ bool FBaseCVar::m_UseCallback = false;
 
 FBaseCVar *CVars = NULL;
 
+// Cvars are also chained by name so lookups don't have to walk the whole
+// list. Most cvars are registered by static constructors, so this must not
+// need any initialization of its own.
+enum { CVAR_HASH_SIZE = 251 };
+static FBaseCVar *CVarHash[CVAR_HASH_SIZE];
+
 int cvar_defflags;
 
 FBaseCVar::FBaseCVar (const FBaseCVar &var)
@@ -89,6 +95,12 @@ FBaseCVar::FBaseCVar (const char *var_name, DWORD flags, void (*callback)(FBaseC
 		Name = copystring (var_name);
 		m_Next = CVars;
 		CVars = this;
+
+		// Newer cvars go in front so they shadow any older one with the
+		// same name, just like in the main list.
+		FBaseCVar **bucket = &CVarHash[MakeKey (var_name) % CVAR_HASH_SIZE];
+		m_HashNext = *bucket;
+		*bucket = this;
 	}
 
 	if (var)
@@ -127,6 +139,14 @@ FBaseCVar::~FBaseCVar ()
 			else
 				CVars = m_Next;
 		}
+		for (FBaseCVar **probe = &CVarHash[MakeKey (Name) % CVAR_HASH_SIZE]; *probe != NULL; probe = &(*probe)->m_HashNext)
+		{
+			if (*probe == this)
+			{
+				*probe = m_HashNext;
+				break;
+			}
+		}
 		C_RemoveTabCommand(Name);
 		delete[] Name;
 	}
@@ -1433,13 +1453,20 @@ void C_ForgetCVars (void)
 FBaseCVar *FindCVar (const char *var_name, FBaseCVar **prev)
 {
 	FBaseCVar *var;
-	FBaseCVar *dummy;
 
 	if (var_name == NULL)
 		return NULL;
 
 	if (prev == NULL)
-		prev = &dummy;
+	{
+		// Nobody needs the list neighbor, so the hash chain will do.
+		for (var = CVarHash[MakeKey (var_name) % CVAR_HASH_SIZE]; var != NULL; var = var->m_HashNext)
+		{
+			if (stricmp (var->GetName (), var_name) == 0)
+				break;
+		}
+		return var;
+	}
 
 	var = CVars;
 	*prev = NULL;
@@ -1460,7 +1487,7 @@ FBaseCVar *FindCVarSub (const char *var_name, int namelen)
 	if (var_name == NULL)
 		return NULL;
 
-	var = CVars;
+	var = CVarHash[MakeKey (var_name, namelen) % CVAR_HASH_SIZE];
 	while (var)
 	{
 		const char *probename = var->GetName ();
@@ -1470,7 +1497,7 @@ FBaseCVar *FindCVarSub (const char *var_name, int namelen)
 		{
 			break;
 		}
-		var = var->m_Next;
+		var = var->m_HashNext;
 	}
 	return var;
 }
@@ -149,6 +149,7 @@ private:
 
 	void (*m_Callback)(FBaseCVar &);
 	FBaseCVar *m_Next;
+	FBaseCVar *m_HashNext;	// next cvar in the same CVarHash bucket
 
 	static bool m_UseCallback;
 	static bool m_DoNoSet;
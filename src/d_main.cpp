@@ -74,6 +74,7 @@
 #include "am_map.h"
 #include "p_setup.h"
 #include "r_utility.h"
+#include "r_main.h"
 #include "r_sky.h"
 #include "d_main.h"
 #include "d_dehacked.h"
@@ -923,6 +924,9 @@ void D_Display ()
 		GSnd->SetSfxPaused(false, 1);
 	}
 
+	// Nothing holds on to texture data between frames.
+	FTexture::StaticTrimCache ();
+
 	cycles.Unclock();
 	FrameCycles = cycles;
 }
@@ -1029,6 +1033,7 @@ void D_DoomLoop ()
 			}
 			// Update display, next frame, with current state.
 			I_StartTic ();
+			R_BenchViewsTicker ();
 			D_Display ();
 		}
 		catch (CRecoverableError &error)
@@ -2501,6 +2506,11 @@ void D_DoomMain (void)
 				G_LoadGame (file);
 			}
 
+			if (Args->CheckParm ("-sightcheck"))
+			{
+				P_StartSightCheck ();
+			}
+
 			v = Args->CheckValue("-playdemo");
 			if (v != NULL)
 			{
@@ -2516,6 +2526,13 @@ void D_DoomMain (void)
 				D_DoomLoop ();	// never returns
 			}
 
+			v = Args->CheckValue ("-benchviews");
+			if (v != NULL)
+			{
+				// quits once every viewpoint has been rendered
+				R_StartBenchViews (v, Args->CheckValue ("-benchout"), true);
+			}
+
 			if (gameaction != ga_loadgame && gameaction != ga_loadgamehidecon)
 			{
 				if (autostart || netgame)
@@ -416,8 +416,13 @@ void DThinker::RunThinkers ()
 	// Tick every thinker left from last time
 	for (i = STAT_FIRST_THINKING; i <= MAX_STATNUM; ++i)
 	{
+		if (i == STAT_DEFAULT)
+		{
+			P_PrepareSightChecks ();
+		}
 		TickThinkers (&Thinkers[i], NULL);
 	}
+	P_InvalidateSightChecks ();
 
 	// Keep ticking the fresh thinkers until there are no new ones.
 	do
@@ -463,6 +468,10 @@ int DThinker::TickThinkers (FThinkerList *list, FThinkerList *dest)
 
 		if (!(node->ObjectFlags & OF_EuthanizeMe))
 		{ // Only tick thinkers not scheduled for destruction
+			if (SightChecksCached && !node->IsKindOf (RUNTIME_CLASS(AActor)))
+			{ // Sector movers, polyobjects and the like can block sight
+				P_InvalidateSightChecks ();
+			}
 			node->Tick();
 			node->ObjectFlags &= ~OF_JustSpawned;
 			GC::CheckGC();
@@ -33,6 +33,10 @@
 **
 */
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
 #include "files.h"
 #include "i_system.h"
 #include "templates.h"
@@ -527,3 +531,37 @@ char *MemoryReader::Gets(char *strbuf, int len)
 {
 	return GetsFromBuffer(bufptr, strbuf, len);
 }
+
+//==========================================================================
+//
+// MappedFileReader
+//
+// The mapping is private, so anything that scribbles over a cached lump
+// only changes its own copy of the page and never the file.
+//
+//==========================================================================
+
+MappedFileReader::MappedFileReader (const char *filename)
+: FileReader(filename), Mapping(NULL)
+{
+#ifndef _WIN32
+	if (Length > 0)
+	{
+		void *map = mmap (NULL, Length, PROT_READ|PROT_WRITE, MAP_PRIVATE, fileno(File), 0);
+		if (map != MAP_FAILED)
+		{
+			Mapping = (const char *)map;
+		}
+	}
+#endif
+}
+
+MappedFileReader::~MappedFileReader ()
+{
+#ifndef _WIN32
+	if (Mapping != NULL)
+	{
+		munmap ((void *)Mapping, Length);
+	}
+#endif
+}
@@ -80,6 +80,18 @@ public:
 	FILE *GetFile () const { return File; }
 	virtual const char *GetBuffer() const { return NULL; }
 
+	// Returns GetBuffer() + pos, but only if the range [pos, pos+len) lies
+	// completely inside the file. Otherwise it returns NULL.
+	const char *GetBufferAt(long pos, long len) const
+	{
+		const char *buffer = GetBuffer();
+		if (buffer == NULL || pos < 0 || len < 0 || pos > Length || len > Length - pos)
+		{
+			return NULL;
+		}
+		return buffer + pos;
+	}
+
 	FileReader &operator>> (BYTE &v)
 	{
 		Read (&v, 1);
@@ -335,6 +347,22 @@ protected:
 	const char * bufptr;
 };
 
+// Reads a file like FileReader does, but also maps it into memory where the
+// platform allows it, so uncompressed lumps can point straight into the
+// mapping instead of being read into a buffer of their own. If the file
+// cannot be mapped, GetBuffer() returns NULL and it is just a FileReader.
+class MappedFileReader : public FileReader
+{
+public:
+	MappedFileReader (const char *filename);
+	~MappedFileReader ();
+
+	virtual const char *GetBuffer() const { return Mapping; }
+
+protected:
+	const char *Mapping;
+};
+
 
 
 #endif
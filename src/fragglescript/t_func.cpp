@@ -2286,6 +2286,7 @@ void FParser::SF_SetLineBlocking(void)
 			{
 				lines[i].flags = (lines[i].flags & ~(ML_BLOCKING|ML_BLOCKEVERYTHING)) | blocking;
 			}
+			P_InvalidateSightChecks ();
 		}
 	}
 }
@@ -3632,6 +3633,7 @@ void FParser::SF_LineFlag()
 			line->flags &= ~(1 << flagnum);
 			if(intvalue(t_argv[2]))
 				line->flags |= (1 << flagnum);
+			P_InvalidateSightChecks ();
 		}
 		
 		t_return.type = svt_int;
@@ -4358,6 +4360,7 @@ void FParser::SF_SetLineTrigger()
 										(f & ~(ML_MONSTERSCANACTIVATE|ML_REPEAT_SPECIAL|ML_SPAC_MASK|ML_FIRSTSIDEONLY));
 
 		}
+		P_InvalidateSightChecks ();
 	}
 }
 
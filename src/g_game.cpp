@@ -2635,6 +2635,11 @@ bool G_CheckDemoStatus (void)
 		if (timingdemo)
 			endtime = I_GetTime (false) - starttime;
 
+		if (!P_FinishSightCheck ())
+		{
+			I_FatalError ("Sight prepass results differed from tracing during the demo.\n");
+		}
+
 		C_RestoreCVars ();		// [RH] Restore cvars demo might have changed
 		M_Free (demobuffer);
 		demobuffer = NULL;
@@ -196,16 +196,17 @@ DEFINE_ACTION_FUNCTION(AActor, A_MStaffTrack)
 
 static AActor *FrontBlockCheck (AActor *mo, int index, void *)
 {
-	FBlockNode *link;
+	FBlockLinkIterator it(index);
+	AActor *link;
 
-	for (link = blocklinks[index]; link != NULL; link = link->NextActor)
+	while ((link = it.Next()) != NULL)
 	{
-		if (link->Me != mo)
+		if (link != mo)
 		{
-			if (P_PointOnDivlineSide (link->Me->x, link->Me->y, &BlockCheckLine) == 0 &&
-				mo->IsOkayToAttack (link->Me))
+			if (P_PointOnDivlineSide (link->x, link->y, &BlockCheckLine) == 0 &&
+				mo->IsOkayToAttack (link))
 			{
-				return link->Me;
+				return link;
 			}
 		}
 	}
@@ -36,6 +36,7 @@ DEFINE_ACTION_FUNCTION(AActor, A_RemoveForceField)
 			line->sidedef[1]->SetTexture(side_t::mid, FNullTextureID());
 		}
 	}
+	P_InvalidateSightChecks ();
 }
 
 bool ADegninOre::Use (bool pickup)
@@ -145,6 +145,7 @@ struct FState
 	}
 	static const PClass *StaticFindStateOwner (const FState *state);
 	static const PClass *StaticFindStateOwner (const FState *state, const FActorInfo *info);
+	static void StaticBuildOwnerIndex ();
 	static FRandom pr_statetics;
 };
 
@@ -228,6 +228,30 @@ void FRandom::Init(DWORD seed)
 	InitByArray(seeds, 2);
 }
 
+//==========================================================================
+//
+// FRandom :: SaveState
+//
+//==========================================================================
+
+void FRandom::SaveState(DWORD *state) const
+{
+	memcpy(state, sfmt.u, sizeof(sfmt.u));
+	state[SFMT::N32] = idx;
+}
+
+//==========================================================================
+//
+// FRandom :: RestoreState
+//
+//==========================================================================
+
+void FRandom::RestoreState(const DWORD *state)
+{
+	memcpy(sfmt.u, state, sizeof(sfmt.u));
+	idx = state[SFMT::N32];
+}
+
 //==========================================================================
 //
 // FRandom :: StaticSumSeeds
@@ -86,6 +86,12 @@ public:
 
 	void Init(DWORD seed);
 
+	// Copies the generator's state to or from STATE_SIZE DWORDs, so a
+	// sequence of numbers can be drawn again.
+	enum { STATE_SIZE = SFMT::N32 + 1 };
+	void SaveState(DWORD *state) const;
+	void RestoreState(const DWORD *state);
+
 	// SFMT interface
 	unsigned int GenRand32();
 	QWORD GenRand64();
@@ -73,6 +73,8 @@
 #include "po_man.h"
 #include "actorptrselect.h"
 #include "farchive.h"
+#include "files.h"
+#include "stats.h"
 #include "decallib.h"
 
 #include "g_shared/a_pickups.h"
@@ -81,6 +83,14 @@ extern FILE *Logfile;
 
 FRandom pr_acs ("ACS");
 
+// Timing every script run costs a little, so it's only done on request.
+CVAR (Bool, acs_profiletime, false, 0)
+// When set, profile data is appended to this file whenever the ACS modules are unloaded.
+CVAR (String, acs_profiledump, "", CVAR_ARCHIVE)
+
+static FString ProfileMapName;	// map the loaded modules' profile data belongs to
+static bool WriteProfileData (const char *filename);
+
 // I imagine this much stack space is probably overkill, but it could
 // potentially get used with recursive functions.
 #define STACK_SIZE 4096
@@ -1415,6 +1425,10 @@ FBehavior *FBehavior::StaticLoadModule (int lumpnum, FileReader *fr, int len)
 {
 	if (lumpnum == -1 && fr == NULL) return NULL;
 
+	if (StaticModules.Size() == 0)
+	{
+		ProfileMapName = level.mapname;
+	}
 	for (unsigned int i = 0; i < StaticModules.Size(); ++i)
 	{
 		if (StaticModules[i]->LumpNum == lumpnum)
@@ -1440,6 +1454,10 @@ bool FBehavior::StaticCheckAllGood ()
 
 void FBehavior::StaticUnloadModules ()
 {
+	if (StaticModules.Size() > 0 && *acs_profiledump != 0)
+	{
+		WriteProfileData (acs_profiledump);
+	}
 	for (unsigned int i = StaticModules.Size(); i-- > 0; )
 	{
 		delete StaticModules[i];
@@ -1669,6 +1687,10 @@ FBehavior::FBehavior (int lumpnum, FileReader * fr, int len)
 	ArrayStore = NULL;
 	Chunks = NULL;
 	Data = NULL;
+	Code = NULL;
+	CodeSize = 0;
+	CodeMap = NULL;
+	CodeOfs = NULL;
 	Format = ACS_Unknown;
 	LumpNum = lumpnum;
 	memset (MapVarStore, 0, sizeof(MapVarStore));
@@ -1744,6 +1766,8 @@ FBehavior::FBehavior (int lumpnum, FileReader * fr, int len)
 
 	Data = object;
 	DataSize = len;
+	Code = object;
+	CodeSize = len;
 
 	if (Format == ACS_Old)
 	{
@@ -2088,6 +2112,8 @@ FBehavior::FBehavior (int lumpnum, FileReader * fr, int len)
 		}
 	}
 
+	DecodeCode ();
+
 	DPrintf ("Loaded %d scripts, %d functions\n", NumScripts, NumFunctions);
 }
 
@@ -2121,6 +2147,15 @@ FBehavior::~FBehavior ()
 		delete[] FunctionProfileData;
 		FunctionProfileData = NULL;
 	}
+	if (Code != Data)
+	{
+		delete[] Code;
+		delete[] CodeMap;
+		delete[] CodeOfs;
+	}
+	Code = NULL;
+	CodeMap = NULL;
+	CodeOfs = NULL;
 	if (Data != NULL)
 	{
 		delete[] Data;
@@ -2393,6 +2428,491 @@ void FBehavior::UnescapeStringTable(BYTE *chunkstart, BYTE *datastart, bool has_
 	}
 }
 
+//============================================================================
+//
+// GetPCodeOperands
+//
+// Describes the operands that follow a p-code in a compressed (ACSe)
+// object. w = 4-byte word, b = byte, s = short, r = raw byte that the
+// interpreter reads as a byte in every format, j = 4-byte jump target.
+// PCD_PUSHBYTES and PCD_CASEGOTOSORTED have variable sizes and are not
+// listed here.
+//
+//============================================================================
+
+static const char *GetPCodeOperands (int pcd)
+{
+	switch (pcd)
+	{
+	case DLevelScript::PCD_PUSHNUMBER:
+	case DLevelScript::PCD_DELAYDIRECT:
+	case DLevelScript::PCD_TAGWAITDIRECT:
+	case DLevelScript::PCD_POLYWAITDIRECT:
+	case DLevelScript::PCD_SCRIPTWAITDIRECT:
+	case DLevelScript::PCD_SETFONTDIRECT:
+	case DLevelScript::PCD_SETGRAVITYDIRECT:
+	case DLevelScript::PCD_SETAIRCONTROLDIRECT:
+	case DLevelScript::PCD_CHECKINVENTORYDIRECT:
+		return "w";
+
+	case DLevelScript::PCD_RANDOMDIRECT:
+	case DLevelScript::PCD_THINGCOUNTDIRECT:
+	case DLevelScript::PCD_CHANGEFLOORDIRECT:
+	case DLevelScript::PCD_CHANGECEILINGDIRECT:
+	case DLevelScript::PCD_GIVEINVENTORYDIRECT:
+	case DLevelScript::PCD_TAKEINVENTORYDIRECT:
+		return "ww";
+
+	case DLevelScript::PCD_SETMUSICDIRECT:
+	case DLevelScript::PCD_LOCALSETMUSICDIRECT:
+		return "www";
+
+	case DLevelScript::PCD_SPAWNSPOTDIRECT:
+		return "wwww";
+
+	case DLevelScript::PCD_SPAWNDIRECT:
+		return "wwwwww";
+
+	case DLevelScript::PCD_PUSHBYTE:
+	case DLevelScript::PCD_DELAYDIRECTB:
+		return "r";
+
+	case DLevelScript::PCD_PUSH2BYTES:
+	case DLevelScript::PCD_LSPEC1DIRECTB:
+	case DLevelScript::PCD_RANDOMDIRECTB:
+		return "rr";
+
+	case DLevelScript::PCD_PUSH3BYTES:
+	case DLevelScript::PCD_LSPEC2DIRECTB:
+		return "rrr";
+
+	case DLevelScript::PCD_PUSH4BYTES:
+	case DLevelScript::PCD_LSPEC3DIRECTB:
+		return "rrrr";
+
+	case DLevelScript::PCD_PUSH5BYTES:
+	case DLevelScript::PCD_LSPEC4DIRECTB:
+		return "rrrrr";
+
+	case DLevelScript::PCD_LSPEC5DIRECTB:
+		return "rrrrrr";
+
+	case DLevelScript::PCD_LSPEC1:
+	case DLevelScript::PCD_LSPEC2:
+	case DLevelScript::PCD_LSPEC3:
+	case DLevelScript::PCD_LSPEC4:
+	case DLevelScript::PCD_LSPEC5:
+	case DLevelScript::PCD_LSPEC5RESULT:
+	case DLevelScript::PCD_PUSHFUNCTION:
+	case DLevelScript::PCD_CALL:
+	case DLevelScript::PCD_CALLDISCARD:
+	case DLevelScript::PCD_ASSIGNSCRIPTVAR:
+	case DLevelScript::PCD_ASSIGNMAPVAR:
+	case DLevelScript::PCD_ASSIGNWORLDVAR:
+	case DLevelScript::PCD_ASSIGNGLOBALVAR:
+	case DLevelScript::PCD_ASSIGNMAPARRAY:
+	case DLevelScript::PCD_ASSIGNWORLDARRAY:
+	case DLevelScript::PCD_ASSIGNGLOBALARRAY:
+	case DLevelScript::PCD_PUSHSCRIPTVAR:
+	case DLevelScript::PCD_PUSHMAPVAR:
+	case DLevelScript::PCD_PUSHWORLDVAR:
+	case DLevelScript::PCD_PUSHGLOBALVAR:
+	case DLevelScript::PCD_PUSHMAPARRAY:
+	case DLevelScript::PCD_PUSHWORLDARRAY:
+	case DLevelScript::PCD_PUSHGLOBALARRAY:
+	case DLevelScript::PCD_ADDSCRIPTVAR:
+	case DLevelScript::PCD_ADDMAPVAR:
+	case DLevelScript::PCD_ADDWORLDVAR:
+	case DLevelScript::PCD_ADDGLOBALVAR:
+	case DLevelScript::PCD_ADDMAPARRAY:
+	case DLevelScript::PCD_ADDWORLDARRAY:
+	case DLevelScript::PCD_ADDGLOBALARRAY:
+	case DLevelScript::PCD_SUBSCRIPTVAR:
+	case DLevelScript::PCD_SUBMAPVAR:
+	case DLevelScript::PCD_SUBWORLDVAR:
+	case DLevelScript::PCD_SUBGLOBALVAR:
+	case DLevelScript::PCD_SUBMAPARRAY:
+	case DLevelScript::PCD_SUBWORLDARRAY:
+	case DLevelScript::PCD_SUBGLOBALARRAY:
+	case DLevelScript::PCD_MULSCRIPTVAR:
+	case DLevelScript::PCD_MULMAPVAR:
+	case DLevelScript::PCD_MULWORLDVAR:
+	case DLevelScript::PCD_MULGLOBALVAR:
+	case DLevelScript::PCD_MULMAPARRAY:
+	case DLevelScript::PCD_MULWORLDARRAY:
+	case DLevelScript::PCD_MULGLOBALARRAY:
+	case DLevelScript::PCD_DIVSCRIPTVAR:
+	case DLevelScript::PCD_DIVMAPVAR:
+	case DLevelScript::PCD_DIVWORLDVAR:
+	case DLevelScript::PCD_DIVGLOBALVAR:
+	case DLevelScript::PCD_DIVMAPARRAY:
+	case DLevelScript::PCD_DIVWORLDARRAY:
+	case DLevelScript::PCD_DIVGLOBALARRAY:
+	case DLevelScript::PCD_MODSCRIPTVAR:
+	case DLevelScript::PCD_MODMAPVAR:
+	case DLevelScript::PCD_MODWORLDVAR:
+	case DLevelScript::PCD_MODGLOBALVAR:
+	case DLevelScript::PCD_MODMAPARRAY:
+	case DLevelScript::PCD_MODWORLDARRAY:
+	case DLevelScript::PCD_MODGLOBALARRAY:
+	case DLevelScript::PCD_ANDSCRIPTVAR:
+	case DLevelScript::PCD_ANDMAPVAR:
+	case DLevelScript::PCD_ANDWORLDVAR:
+	case DLevelScript::PCD_ANDGLOBALVAR:
+	case DLevelScript::PCD_ANDMAPARRAY:
+	case DLevelScript::PCD_ANDWORLDARRAY:
+	case DLevelScript::PCD_ANDGLOBALARRAY:
+	case DLevelScript::PCD_EORSCRIPTVAR:
+	case DLevelScript::PCD_EORMAPVAR:
+	case DLevelScript::PCD_EORWORLDVAR:
+	case DLevelScript::PCD_EORGLOBALVAR:
+	case DLevelScript::PCD_EORMAPARRAY:
+	case DLevelScript::PCD_EORWORLDARRAY:
+	case DLevelScript::PCD_EORGLOBALARRAY:
+	case DLevelScript::PCD_ORSCRIPTVAR:
+	case DLevelScript::PCD_ORMAPVAR:
+	case DLevelScript::PCD_ORWORLDVAR:
+	case DLevelScript::PCD_ORGLOBALVAR:
+	case DLevelScript::PCD_ORMAPARRAY:
+	case DLevelScript::PCD_ORWORLDARRAY:
+	case DLevelScript::PCD_ORGLOBALARRAY:
+	case DLevelScript::PCD_LSSCRIPTVAR:
+	case DLevelScript::PCD_LSMAPVAR:
+	case DLevelScript::PCD_LSWORLDVAR:
+	case DLevelScript::PCD_LSGLOBALVAR:
+	case DLevelScript::PCD_LSMAPARRAY:
+	case DLevelScript::PCD_LSWORLDARRAY:
+	case DLevelScript::PCD_LSGLOBALARRAY:
+	case DLevelScript::PCD_RSSCRIPTVAR:
+	case DLevelScript::PCD_RSMAPVAR:
+	case DLevelScript::PCD_RSWORLDVAR:
+	case DLevelScript::PCD_RSGLOBALVAR:
+	case DLevelScript::PCD_RSMAPARRAY:
+	case DLevelScript::PCD_RSWORLDARRAY:
+	case DLevelScript::PCD_RSGLOBALARRAY:
+	case DLevelScript::PCD_INCSCRIPTVAR:
+	case DLevelScript::PCD_INCMAPVAR:
+	case DLevelScript::PCD_INCWORLDVAR:
+	case DLevelScript::PCD_INCGLOBALVAR:
+	case DLevelScript::PCD_INCMAPARRAY:
+	case DLevelScript::PCD_INCWORLDARRAY:
+	case DLevelScript::PCD_INCGLOBALARRAY:
+	case DLevelScript::PCD_DECSCRIPTVAR:
+	case DLevelScript::PCD_DECMAPVAR:
+	case DLevelScript::PCD_DECWORLDVAR:
+	case DLevelScript::PCD_DECGLOBALVAR:
+	case DLevelScript::PCD_DECMAPARRAY:
+	case DLevelScript::PCD_DECWORLDARRAY:
+	case DLevelScript::PCD_DECGLOBALARRAY:
+		return "b";
+
+	case DLevelScript::PCD_LSPEC1DIRECT:
+		return "bw";
+
+	case DLevelScript::PCD_LSPEC2DIRECT:
+		return "bww";
+
+	case DLevelScript::PCD_LSPEC3DIRECT:
+		return "bwww";
+
+	case DLevelScript::PCD_LSPEC4DIRECT:
+		return "bwwww";
+
+	case DLevelScript::PCD_LSPEC5DIRECT:
+		return "bwwwww";
+
+	case DLevelScript::PCD_CALLFUNC:
+		return "bs";
+
+	case DLevelScript::PCD_GOTO:
+	case DLevelScript::PCD_IFGOTO:
+	case DLevelScript::PCD_IFNOTGOTO:
+		return "j";
+
+	case DLevelScript::PCD_CASEGOTO:
+		return "wj";
+
+	default:
+		return "";
+	}
+}
+
+//============================================================================
+//
+// PCodeFallsThrough
+//
+// False for p-codes after which execution never continues with the next
+// instruction.
+//
+//============================================================================
+
+static bool PCodeFallsThrough (int pcd)
+{
+	switch (pcd)
+	{
+	case DLevelScript::PCD_TERMINATE:
+	case DLevelScript::PCD_RESTART:
+	case DLevelScript::PCD_GOTO:
+	case DLevelScript::PCD_GOTOSTACK:
+	case DLevelScript::PCD_RETURNVOID:
+	case DLevelScript::PCD_RETURNVAL:
+		return false;
+
+	default:
+		return pcd < DLevelScript::PCODE_COMMAND_COUNT;
+	}
+}
+
+//============================================================================
+//
+// FCodeDecoder
+//
+// Reads one instruction of a compressed object and, if an output buffer is
+// given, writes it back out in the uncompressed format: every p-code, byte
+// and short operand becomes a full word. Jump targets are written as the
+// original offsets and recorded so they can be resolved once everything
+// has been placed.
+//
+//============================================================================
+
+struct FCodeDecoder
+{
+	const BYTE *Data;
+	DWORD DataSize;
+	TArray<BYTE> Out;
+	TArray<DWORD> Fixups;		// offsets in Out holding a jump target
+
+	void PutWord (DWORD val)
+	{
+		BYTE *p = &Out[Out.Reserve(4)];
+		p[0] = BYTE(val);
+		p[1] = BYTE(val >> 8);
+		p[2] = BYTE(val >> 16);
+		p[3] = BYTE(val >> 24);
+	}
+
+	void PutTarget (DWORD target)
+	{
+		Fixups.Push(Out.Size());
+		PutWord(target);
+	}
+
+	DWORD GetWord (DWORD ofs) const
+	{
+		return Data[ofs] | (Data[ofs+1] << 8) | (Data[ofs+2] << 16) | (Data[ofs+3] << 24);
+	}
+
+	// Returns the size of the instruction at ofs, or 0 if it runs past the
+	// end of the object. Jump targets are added to targets.
+	DWORD Decode (DWORD ofs, bool emit, int &pcd, TArray<DWORD> *targets)
+	{
+		DWORD pos = ofs;
+
+		if (pos >= DataSize) return 0;
+		pcd = Data[pos++];
+		if (pcd >= 256-16)
+		{
+			if (pos >= DataSize) return 0;
+			pcd = (256-16) + ((pcd - (256-16)) << 8) + Data[pos++];
+		}
+		if (emit) PutWord(pcd);
+
+		if (pcd == DLevelScript::PCD_PUSHBYTES)
+		{
+			if (pos >= DataSize || pos + 1 + Data[pos] > DataSize) return 0;
+			int count = Data[pos] + 1;
+			if (emit) memcpy(&Out[Out.Reserve(count)], Data + pos, count);
+			return pos + count - ofs;
+		}
+		if (pcd == DLevelScript::PCD_CASEGOTOSORTED)
+		{
+			// The table is 4-byte aligned in both the object and the output.
+			pos = (pos + 3) & ~3;
+			if (pos + 4 > DataSize) return 0;
+			DWORD numcases = GetWord(pos);
+			pos += 4;
+			if (numcases > (DataSize - pos) / 8) return 0;
+			if (emit)
+			{
+				while (Out.Size() & 3) Out.Push(0);
+				PutWord(numcases);
+			}
+			for (DWORD i = 0; i < numcases; ++i, pos += 8)
+			{
+				if (targets != NULL) targets->Push(GetWord(pos + 4));
+				if (emit)
+				{
+					memcpy(&Out[Out.Reserve(4)], Data + pos, 4);
+					PutTarget(GetWord(pos + 4));
+				}
+			}
+			return pos - ofs;
+		}
+
+		for (const char *op = GetPCodeOperands(pcd); *op != 0; ++op)
+		{
+			DWORD size = *op == 'w' || *op == 'j' ? 4 : *op == 's' ? 2 : 1;
+			if (pos + size > DataSize) return 0;
+
+			switch (*op)
+			{
+			case 'w':
+				if (emit) memcpy(&Out[Out.Reserve(4)], Data + pos, 4);
+				break;
+			case 'j':
+				if (targets != NULL) targets->Push(GetWord(pos));
+				if (emit) PutTarget(GetWord(pos));
+				break;
+			case 's':
+				if (emit) PutWord(SWORD(Data[pos] | (Data[pos+1] << 8)));
+				break;
+			case 'b':
+				if (emit) PutWord(Data[pos]);
+				break;
+			case 'r':
+				if (emit) Out.Push(Data[pos]);
+				break;
+			}
+			pos += size;
+		}
+		return pos - ofs;
+	}
+};
+
+//============================================================================
+//
+// FBehavior :: DecodeCode
+//
+// Compressed objects store p-codes and most operands as bytes, which used
+// to be expanded again every time an instruction ran. This expands them
+// once when the module is loaded, so the interpreter only ever sees whole
+// words. Only code that can be reached from a script, function or jump
+// point is decoded, in its original order. Jump targets are rewritten to
+// point into the decoded code; everything else that stores an offset, like
+// savegames, keeps using offsets into the original object.
+//
+//============================================================================
+
+void FBehavior::DecodeCode ()
+{
+	Code = Data;
+	CodeSize = DataSize;
+
+	if (Format != ACS_LittleEnhanced)
+	{
+		return;
+	}
+
+	FCodeDecoder decoder;
+	TArray<DWORD> work;
+	BYTE *starts = new BYTE[DataSize];
+	DWORD ofs, size;
+	int pcd, i;
+
+	decoder.Data = Data;
+	decoder.DataSize = DataSize;
+	memset (starts, 0, DataSize);
+
+	// Find every instruction that can be executed.
+	for (i = 0; i < NumScripts; ++i)
+	{
+		work.Push(Scripts[i].Address);
+	}
+	for (i = 0; i < NumFunctions; ++i)
+	{
+		ScriptFunction *func = (ScriptFunction *)Functions + i;
+		if (func->ImportNum == 0)
+		{
+			work.Push(func->Address);
+		}
+	}
+	for (i = 0; i < (int)JumpPoints.Size(); ++i)
+	{
+		work.Push(JumpPoints[i]);
+	}
+	while (work.Pop(ofs))
+	{
+		while (ofs >= 8 && ofs < (DWORD)DataSize && !starts[ofs])
+		{
+			size = decoder.Decode(ofs, false, pcd, &work);
+			if (size == 0)
+			{
+				break;
+			}
+			starts[ofs] = 1;
+			if (!PCodeFallsThrough(pcd))
+			{
+				break;
+			}
+			ofs += size;
+		}
+	}
+
+	// Offset 0 of the decoded code is a PCD_TERMINATE that anything
+	// pointing outside the decoded code is sent to.
+	TArray<DWORD> instrpos, instrofs;
+	CodeMap = new int[DataSize];
+	for (i = 0; i < DataSize; ++i)
+	{
+		CodeMap[i] = -1;
+	}
+	instrpos.Push(0);
+	instrofs.Push(0);
+	decoder.PutWord(DLevelScript::PCD_TERMINATE);
+
+	DWORD next = ~0u;
+	for (ofs = 0; ofs < (DWORD)DataSize; ++ofs)
+	{
+		if (!starts[ofs])
+		{
+			continue;
+		}
+		if (next != ~0u && next != ofs)
+		{
+			// Overlapping code: carry on with the instruction that follows.
+			instrpos.Push(decoder.Out.Size());
+			instrofs.Push(next);
+			decoder.PutWord(DLevelScript::PCD_GOTO);
+			decoder.PutTarget(next);
+		}
+		CodeMap[ofs] = decoder.Out.Size();
+		instrpos.Push(decoder.Out.Size());
+		instrofs.Push(ofs);
+		size = decoder.Decode(ofs, true, pcd, NULL);
+		next = PCodeFallsThrough(pcd) ? ofs + size : ~0u;
+	}
+	if (next != ~0u)
+	{
+		instrpos.Push(decoder.Out.Size());
+		instrofs.Push(next);
+		decoder.PutWord(DLevelScript::PCD_GOTO);
+		decoder.PutTarget(next);
+	}
+	delete[] starts;
+
+	for (i = 0; i < (int)decoder.Fixups.Size(); ++i)
+	{
+		BYTE *p = &decoder.Out[decoder.Fixups[i]];
+		DWORD target = p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24);
+		DWORD to = target < (DWORD)DataSize && CodeMap[target] >= 0 ? CodeMap[target] : 0;
+		p[0] = BYTE(to);
+		p[1] = BYTE(to >> 8);
+		p[2] = BYTE(to >> 16);
+		p[3] = BYTE(to >> 24);
+	}
+
+	CodeSize = decoder.Out.Size();
+	Code = new BYTE[CodeSize];
+	memcpy (Code, &decoder.Out[0], CodeSize);
+	CodeOfs = new DWORD[CodeSize];
+	memset (CodeOfs, 0, CodeSize * sizeof(DWORD));
+	for (i = 0; i < (int)instrpos.Size(); ++i)
+	{
+		CodeOfs[instrpos[i]] = instrofs[i];
+	}
+	DPrintf ("Decoded %d bytes of p-code into %d\n", DataSize, CodeSize);
+}
+
 //============================================================================
 //
 // FBehavior :: IsGood
@@ -5213,28 +5733,16 @@ enum
 };
 
 
+// Compressed objects are expanded when they are loaded, so every p-code and
+// every byte or short operand takes up a whole word here.
 #define NEXTWORD	(LittleLong(*pc++))
-#define NEXTBYTE	(fmt==ACS_LittleEnhanced?getbyte(pc):NEXTWORD)
-#define NEXTSHORT	(fmt==ACS_LittleEnhanced?getshort(pc):NEXTWORD)
+#define NEXTBYTE	NEXTWORD
+#define NEXTSHORT	NEXTWORD
 #define STACK(a)	(Stack[sp - (a)])
 #define PushToStack(a)	(Stack[sp++] = (a))
 // Direct instructions that take strings need to have the tag applied.
 #define TAGSTR(a)	(a|activeBehavior->GetLibraryID())
 
-inline int getbyte (int *&pc)
-{
-	int res = *(BYTE *)pc;
-	pc = (int *)((BYTE *)pc+1);
-	return res;
-}
-
-inline int getshort (int *&pc)
-{
-	int res = LittleShort( *(SWORD *)pc);
-	pc = (int *)((BYTE *)pc+2);
-	return res;
-}
-
 int DLevelScript::RunScript ()
 {
 	DACSThinker *controller = DACSThinker::ActiveThinker;
@@ -5246,6 +5754,9 @@ int DLevelScript::RunScript ()
 	// Hexen truncates all special arguments to bytes (only when using an old MAPINFO and old ACS format
 	const int specialargmask = ((level.flags2 & LEVEL2_HEXENHACK) && activeBehavior->GetFormat() == ACS_Old) ? 255 : ~0;
 
+	// Scripts can change lines and sectors directly.
+	P_InvalidateSightChecks ();
+
 	switch (state)
 	{
 	case SCRIPT_Delayed:
@@ -5307,6 +5818,14 @@ int DLevelScript::RunScript ()
 	const char *lookup;
 	int optstart = -1;
 	int temp;
+	bool timed = acs_profiletime;
+	cycle_t runtime;
+
+	if (timed)
+	{
+		runtime.Reset();
+		runtime.Clock();
+	}
 
 	while (state == SCRIPT_Running)
 	{
@@ -5317,18 +5836,7 @@ int DLevelScript::RunScript ()
 			break;
 		}
 
-		if (fmt == ACS_LittleEnhanced)
-		{
-			pcd = getbyte(pc);
-			if (pcd >= 256-16)
-			{
-				pcd = (256-16) + ((pcd - (256-16)) << 8) + getbyte(pc);
-			}
-		}
-		else
-		{
-			pcd = NEXTWORD;
-		}
+		pcd = NEXTWORD;
 
 		switch (pcd)
 		{
@@ -6406,7 +6914,7 @@ int DLevelScript::RunScript ()
 			break;
 
 		case PCD_GOTO:
-			pc = activeBehavior->Ofs2PC (LittleLong(*pc));
+			pc = activeBehavior->Branch2PC (LittleLong(*pc));
 			break;
 
 		case PCD_GOTOSTACK:
@@ -6416,7 +6924,7 @@ int DLevelScript::RunScript ()
 
 		case PCD_IFGOTO:
 			if (STACK(1))
-				pc = activeBehavior->Ofs2PC (LittleLong(*pc));
+				pc = activeBehavior->Branch2PC (LittleLong(*pc));
 			else
 				pc++;
 			sp--;
@@ -6600,7 +7108,7 @@ int DLevelScript::RunScript ()
 
 		case PCD_IFNOTGOTO:
 			if (!STACK(1))
-				pc = activeBehavior->Ofs2PC (LittleLong(*pc));
+				pc = activeBehavior->Branch2PC (LittleLong(*pc));
 			else
 				pc++;
 			sp--;
@@ -6642,7 +7150,7 @@ scriptwait:
 		case PCD_CASEGOTO:
 			if (STACK(1) == uallong(pc[0]))
 			{
-				pc = activeBehavior->Ofs2PC (uallong(pc[1]));
+				pc = activeBehavior->Branch2PC (uallong(pc[1]));
 				sp--;
 			}
 			else
@@ -6663,7 +7171,7 @@ scriptwait:
 					SDWORD caseval = pc[mid*2];
 					if (caseval == STACK(1))
 					{
-						pc = activeBehavior->Ofs2PC (LittleLong(pc[mid*2+1]));
+						pc = activeBehavior->Branch2PC (LittleLong(pc[mid*2+1]));
 						sp--;
 						break;
 					}
@@ -7254,6 +7762,7 @@ scriptwait:
 						break;
 					}
 				}
+				P_InvalidateSightChecks ();
 
 				sp -= 2;
 			}
@@ -7300,6 +7809,7 @@ scriptwait:
 					DPrintf("Set special on line %d (id %d) to %d(%d,%d,%d,%d,%d)\n",
 						linenum, STACK(7), specnum, arg0, STACK(4), STACK(3), STACK(2), STACK(1));
 				}
+				P_InvalidateSightChecks ();
 				sp -= 7;
 			}
 			break;
@@ -8542,7 +9052,13 @@ scriptwait:
 
 	if (runaway != 0 && InModuleScriptNumber >= 0)
 	{
-		activeBehavior->GetScriptPtr(InModuleScriptNumber)->ProfileData.AddRun(runaway);
+		ScriptPtr *scriptp = activeBehavior->GetScriptPtr(InModuleScriptNumber);
+		scriptp->ProfileData.AddRun(runaway);
+		if (timed)
+		{
+			runtime.Unclock();
+			scriptp->ProfileData.AddTime(runtime.TimeMS());
+		}
 	}
 
 	if (state == SCRIPT_DivideBy0)
@@ -8570,6 +9086,8 @@ scriptwait:
 		this->pc = pc;
 		assert (sp == 0);
 	}
+	// Anything traced while the script ran may be out of date now.
+	P_InvalidateSightChecks ();
 	return resultValue;
 }
 
@@ -8889,6 +9407,8 @@ void ACSProfileInfo::Reset()
 	NumRuns = 0;
 	MinInstrPerRun = UINT_MAX;
 	MaxInstrPerRun = 0;
+	TotalMS = 0;
+	MaxMS = 0;
 }
 
 void ACSProfileInfo::AddRun(unsigned int num_instr)
@@ -8905,6 +9425,15 @@ void ACSProfileInfo::AddRun(unsigned int num_instr)
 	}
 }
 
+void ACSProfileInfo::AddTime(double ms)
+{
+	TotalMS += ms;
+	if (ms > MaxMS)
+	{
+		MaxMS = ms;
+	}
+}
+
 void ArrangeScriptProfiles(TArray<ProfileCollector> &profiles)
 {
 	for (unsigned int mod_num = 0; mod_num < FBehavior::StaticModules.Size(); ++mod_num)
@@ -8993,6 +9522,43 @@ static int STACK_ARGS sort_by_runs(const void *a_, const void *b_)
 	return b->ProfileData->NumRuns - a->ProfileData->NumRuns;
 }
 
+static int STACK_ARGS sort_by_time(const void *a_, const void *b_)
+{
+	const ProfileCollector *a = (const ProfileCollector *)a_;
+	const ProfileCollector *b = (const ProfileCollector *)b_;
+
+	double diff = b->ProfileData->TotalMS - a->ProfileData->TotalMS;
+	return diff > 0 ? 1 : diff < 0 ? -1 : 0;
+}
+
+//==========================================================================
+//
+// GetProfileName
+//
+//==========================================================================
+
+static void GetProfileName(const ProfileCollector *prof, bool functions, char *name, size_t size)
+{
+	if (functions)
+	{
+		DWORD *fnames = (DWORD *)prof->Module->FindChunk(MAKE_ID('F','N','A','M'));
+		if (fnames != NULL && prof->Index >= 0 && prof->Index < (int)LittleLong(fnames[2]))
+		{
+			mysnprintf(name, size, "%s",
+				(char *)(fnames + 2) + LittleLong(fnames[3+prof->Index]));
+		}
+		else
+		{
+			mysnprintf(name, size, "Function %d", prof->Index);
+		}
+	}
+	else
+	{
+		mysnprintf(name, size, "%s",
+			ScriptPresentation(prof->Module->GetScriptPtr(prof->Index)->Number).GetChars() + 7);
+	}
+}
+
 static void ShowProfileData(TArray<ProfileCollector> &profiles, long ilimit,
 	int (STACK_ARGS *sorter)(const void *, const void *), bool functions)
 {
@@ -9020,8 +9586,8 @@ static void ShowProfileData(TArray<ProfileCollector> &profiles, long ilimit,
 		limit = UINT_MAX;
 	}
 
-	Printf(TEXTCOLOR_YELLOW "Module       %-20s      Total    Runs     Avg     Min     Max\n", typelabels[functions]);
-	Printf(TEXTCOLOR_YELLOW "------------ -------------------- ---------- ------- ------- ------- -------\n");
+	Printf(TEXTCOLOR_YELLOW "Module       %-20s      Total    Runs     Avg     Min     Max   Time ms\n", typelabels[functions]);
+	Printf(TEXTCOLOR_YELLOW "------------ -------------------- ---------- ------- ------- ------- ------- ---------\n");
 	for (unsigned int i = 0; i < limit && i < profiles.Size(); ++i)
 	{
 		ProfileCollector *prof = &profiles[i];
@@ -9034,35 +9600,86 @@ static void ShowProfileData(TArray<ProfileCollector> &profiles, long ilimit,
 		mysnprintf(modname, sizeof(modname), "%s", prof->Module->GetModuleName());
 
 		// Script/function name
-		if (functions)
-		{
-			DWORD *fnames = (DWORD *)prof->Module->FindChunk(MAKE_ID('F','N','A','M'));
-			if (prof->Index >= 0 && prof->Index < (int)LittleLong(fnames[2]))
-			{
-				mysnprintf(scriptname, sizeof(scriptname), "%s",
-					(char *)(fnames + 2) + LittleLong(fnames[3+prof->Index]));
-			}
-			else
-			{
-				mysnprintf(scriptname, sizeof(scriptname), "Function %d", prof->Index);
-			}
-		}
-		else
-		{
-			mysnprintf(scriptname, sizeof(scriptname), "%s",
-				ScriptPresentation(prof->Module->GetScriptPtr(prof->Index)->Number).GetChars() + 7);
-		}
-		Printf("%-12s %-20s%11llu%8u%8u%8u%8u\n",
+		GetProfileName(prof, functions, scriptname, sizeof(scriptname));
+
+		Printf("%-12s %-20s%11llu%8u%8u%8u%8u%10.2f\n",
 			modname, scriptname,
 			prof->ProfileData->TotalInstr,
 			prof->ProfileData->NumRuns,
 			unsigned(prof->ProfileData->TotalInstr / prof->ProfileData->NumRuns),
 			prof->ProfileData->MinInstrPerRun,
-			prof->ProfileData->MaxInstrPerRun
+			prof->ProfileData->MaxInstrPerRun,
+			prof->ProfileData->TotalMS
 			);
 	}
 }
 
+//==========================================================================
+//
+// WriteProfileData
+//
+// Appends every script and function that has run to a CSV file, so that
+// hot scripts can be compared across maps and sessions.
+//
+//==========================================================================
+
+static void WriteProfileRows(FILE *f, TArray<ProfileCollector> &profiles, bool functions)
+{
+	char name[64];
+
+	for (unsigned int i = 0; i < profiles.Size(); ++i)
+	{
+		ProfileCollector *prof = &profiles[i];
+		if (prof->ProfileData->NumRuns == 0)
+		{
+			continue;
+		}
+		GetProfileName(prof, functions, name, sizeof(name));
+		fprintf(f, "%s,%s,%s,\"%s\",%u,%llu,%u,%u,%.3f,%.3f\n",
+			ProfileMapName.GetChars(),
+			prof->Module->GetModuleName(),
+			functions ? "function" : "script",
+			name,
+			prof->ProfileData->NumRuns,
+			prof->ProfileData->TotalInstr,
+			prof->ProfileData->MinInstrPerRun,
+			prof->ProfileData->MaxInstrPerRun,
+			prof->ProfileData->TotalMS,
+			prof->ProfileData->MaxMS);
+	}
+}
+
+static bool WriteProfileData(const char *filename)
+{
+	TArray<ProfileCollector> ScriptProfiles, FuncProfiles;
+	FILE *f = fopen(filename, "a");
+
+	if (f == NULL)
+	{
+		Printf("Could not open %s for writing\n", filename);
+		return false;
+	}
+	fseek(f, 0, SEEK_END);
+	if (ftell(f) == 0)
+	{
+		fprintf(f, "map,module,type,name,runs,total_instr,min_instr,max_instr,total_ms,max_ms\n");
+	}
+	ArrangeScriptProfiles(ScriptProfiles);
+	ArrangeFunctionProfiles(FuncProfiles);
+	if (ScriptProfiles.Size() > 0)
+	{
+		qsort(&ScriptProfiles[0], ScriptProfiles.Size(), sizeof(ProfileCollector), sort_by_total_instr);
+	}
+	if (FuncProfiles.Size() > 0)
+	{
+		qsort(&FuncProfiles[0], FuncProfiles.Size(), sizeof(ProfileCollector), sort_by_total_instr);
+	}
+	WriteProfileRows(f, ScriptProfiles, false);
+	WriteProfileRows(f, FuncProfiles, true);
+	fclose(f);
+	return true;
+}
+
 CCMD(acsprofile)
 {
 	static int (STACK_ARGS *sort_funcs[])(const void*, const void *) =
@@ -9071,10 +9688,11 @@ CCMD(acsprofile)
 		sort_by_min,
 		sort_by_max,
 		sort_by_avg,
-		sort_by_runs
+		sort_by_runs,
+		sort_by_time
 	};
-	static const char *sort_names[] = { "total", "min", "max", "avg", "runs" };
-	static const BYTE sort_match_len[] = {   1,     2,     2,     1,      1 };
+	static const char *sort_names[] = { "total", "min", "max", "avg", "runs", "time" };
+	static const BYTE sort_match_len[] = {   1,     2,     2,     1,      1,      2 };
 
 	TArray<ProfileCollector> ScriptProfiles, FuncProfiles;
 	long limit = 10;
@@ -9094,6 +9712,19 @@ CCMD(acsprofile)
 			ClearProfiles(FuncProfiles);
 			return;
 		}
+		// `acsprofile dump <file>` appends everything collected so far to a CSV file.
+		if (stricmp(argv[1], "dump") == 0)
+		{
+			if (argv.argc() < 3)
+			{
+				Printf("acsprofile dump <file> : Append profiling information to a CSV file\n");
+			}
+			else if (WriteProfileData(argv[2]))
+			{
+				Printf("Profile data written to %s\n", argv[2]);
+			}
+			return;
+		}
 		for (int i = 1; i < argv.argc(); ++i)
 		{
 			// If it's a number, set the display limit.
@@ -9124,7 +9755,8 @@ CCMD(acsprofile)
 			{
 				Printf("Unknown option '%s'\n", argv[i]);
 				Printf("acsprofile clear : Reset profiling information\n");
-				Printf("acsprofile [total|min|max|avg|runs] [<limit>]\n");
+				Printf("acsprofile dump <file> : Append profiling information to a CSV file\n");
+				Printf("acsprofile [total|min|max|avg|runs|time] [<limit>]\n");
 				return;
 			}
 		}
@@ -9133,3 +9765,275 @@ CCMD(acsprofile)
 	ShowProfileData(ScriptProfiles, limit, sorter, false);
 	ShowProfileData(FuncProfiles, limit, sorter, true);
 }
+
+//==========================================================================
+//
+// FACSAssembler
+//
+// Writes a compressed (ACSe) object for the interpreter benchmark.
+//
+//==========================================================================
+
+struct FACSAssembler
+{
+	TArray<BYTE> Data;
+	TArray<FString> Strings;
+
+	FACSAssembler()
+	{
+		Word(MAKE_ID('A','C','S','e'));
+		Word(0);	// offset of the chunks, filled in by Finish()
+	}
+
+	int Here() const { return Data.Size(); }
+
+	void Byte(int val)
+	{
+		Data.Push(BYTE(val));
+	}
+
+	void Word(int val)
+	{
+		Byte(val); Byte(val >> 8); Byte(val >> 16); Byte(val >> 24);
+	}
+
+	void PatchWord(int at, int val)
+	{
+		Data[at] = BYTE(val);
+		Data[at+1] = BYTE(val >> 8);
+		Data[at+2] = BYTE(val >> 16);
+		Data[at+3] = BYTE(val >> 24);
+	}
+
+	void Op(int pcd)
+	{
+		if (pcd < 256-16)
+		{
+			Byte(pcd);
+		}
+		else
+		{
+			Byte((256-16) + ((pcd - (256-16)) >> 8));
+			Byte(pcd - (256-16));
+		}
+	}
+
+	void Op(int pcd, int byteop)
+	{
+		Op(pcd);
+		Byte(byteop);
+	}
+
+	void PushNumber(int val)
+	{
+		Op(DLevelScript::PCD_PUSHNUMBER);
+		Word(val);
+	}
+
+	// Returns where the target goes so it can be patched later.
+	int Jump(int pcd, int target = 0)
+	{
+		Op(pcd);
+		Word(target);
+		return Here() - 4;
+	}
+
+	// Returns the string's number in this module's string table.
+	int String(const char *str)
+	{
+		return Strings.Push(str);
+	}
+
+	// Adds the chunks for the given scripts, the strings and one
+	// 256-element map array.
+	void Finish(const TArray<int> &scripts)
+	{
+		PatchWord(4, Here());
+		Word(MAKE_ID('S','P','T','R'));
+		Word(scripts.Size() * 12);
+		for (unsigned int i = 0; i < scripts.Size(); ++i)
+		{
+			Byte(i + 1); Byte(0);		// number
+			Byte(0); Byte(0);			// type (closed)
+			Word(scripts[i]);			// address
+			Word(0);					// argument count
+		}
+		if (Strings.Size() > 0)
+		{
+			unsigned int i, size = 12 + Strings.Size() * 4, ofs = size;
+			for (i = 0; i < Strings.Size(); ++i)
+			{
+				size += Strings[i].Len() + 1;
+			}
+			size = (size + 3) & ~3;
+			Word(MAKE_ID('S','T','R','L'));
+			Word(size);
+			Word(0);
+			Word(Strings.Size());
+			Word(0);
+			for (i = 0; i < Strings.Size(); ++i)
+			{
+				Word(ofs);
+				ofs += Strings[i].Len() + 1;
+			}
+			for (i = 0; i < Strings.Size(); ++i)
+			{
+				for (const char *c = Strings[i]; *c != 0; ++c)
+				{
+					Byte(*c);
+				}
+				Byte(0);
+			}
+			while (Here() & 3)
+			{
+				Byte(0);
+			}
+		}
+		Word(MAKE_ID('A','R','A','Y'));
+		Word(8);
+		Word(0);
+		Word(256);
+	}
+};
+
+//==========================================================================
+//
+// FBehavior :: StaticRunBenchmark
+//
+// Runs a few small scripts that stress the interpreter itself: a counting
+// loop, map array access, building strings with StrParam and reading a
+// cvar the way many mods poll their settings. The module only exists for
+// the duration of the benchmark.
+//
+//==========================================================================
+
+void FBehavior::StaticRunBenchmark (int runs)
+{
+	enum { LOOPS = 100000, STRINGLOOPS = 20000 };
+	static const char *const names[] = { "loop", "array", "string", "getcvar" };
+
+	FACSAssembler as;
+	TArray<int> scripts;
+	int top, exit;
+
+	// for (i = 0; i < LOOPS; i++) ;
+	scripts.Push(as.Here());
+	as.PushNumber(0);
+	as.Op(DLevelScript::PCD_ASSIGNSCRIPTVAR, 0);
+	top = as.Here();
+	as.Op(DLevelScript::PCD_PUSHSCRIPTVAR, 0);
+	as.PushNumber(LOOPS);
+	as.Op(DLevelScript::PCD_LT);
+	exit = as.Jump(DLevelScript::PCD_IFNOTGOTO);
+	as.Op(DLevelScript::PCD_INCSCRIPTVAR, 0);
+	as.Jump(DLevelScript::PCD_GOTO, top);
+	as.PatchWord(exit, as.Here());
+	as.Op(DLevelScript::PCD_TERMINATE);
+
+	// for (i = 0; i < LOOPS; i++) array[i & 255] += i;
+	scripts.Push(as.Here());
+	as.PushNumber(0);
+	as.Op(DLevelScript::PCD_ASSIGNSCRIPTVAR, 0);
+	top = as.Here();
+	as.Op(DLevelScript::PCD_PUSHSCRIPTVAR, 0);
+	as.PushNumber(LOOPS);
+	as.Op(DLevelScript::PCD_LT);
+	exit = as.Jump(DLevelScript::PCD_IFNOTGOTO);
+	as.Op(DLevelScript::PCD_PUSHSCRIPTVAR, 0);
+	as.Op(DLevelScript::PCD_PUSHBYTE, 255);
+	as.Op(DLevelScript::PCD_ANDBITWISE);
+	as.Op(DLevelScript::PCD_PUSHSCRIPTVAR, 0);
+	as.Op(DLevelScript::PCD_ADDMAPARRAY, 0);
+	as.Op(DLevelScript::PCD_INCSCRIPTVAR, 0);
+	as.Jump(DLevelScript::PCD_GOTO, top);
+	as.PatchWord(exit, as.Here());
+	as.Op(DLevelScript::PCD_TERMINATE);
+
+	// for (i = 0; i < STRINGLOOPS; i++) len += StrLen(StrParam(d:i & 63));
+	scripts.Push(as.Here());
+	as.PushNumber(0);
+	as.Op(DLevelScript::PCD_ASSIGNSCRIPTVAR, 0);
+	top = as.Here();
+	as.Op(DLevelScript::PCD_PUSHSCRIPTVAR, 0);
+	as.PushNumber(STRINGLOOPS);
+	as.Op(DLevelScript::PCD_LT);
+	exit = as.Jump(DLevelScript::PCD_IFNOTGOTO);
+	as.Op(DLevelScript::PCD_BEGINPRINT);
+	as.Op(DLevelScript::PCD_PUSHSCRIPTVAR, 0);
+	as.Op(DLevelScript::PCD_PUSHBYTE, 63);
+	as.Op(DLevelScript::PCD_ANDBITWISE);
+	as.Op(DLevelScript::PCD_PRINTNUMBER);
+	as.Op(DLevelScript::PCD_SAVESTRING);
+	as.Op(DLevelScript::PCD_STRLEN);
+	as.Op(DLevelScript::PCD_ADDSCRIPTVAR, 1);
+	as.Op(DLevelScript::PCD_INCSCRIPTVAR, 0);
+	as.Jump(DLevelScript::PCD_GOTO, top);
+	as.PatchWord(exit, as.Here());
+	as.Op(DLevelScript::PCD_TERMINATE);
+
+	// for (i = 0; i < LOOPS; i++) sum += GetCVar("sv_gravity");
+	scripts.Push(as.Here());
+	as.PushNumber(as.String("sv_gravity"));
+	as.Op(DLevelScript::PCD_TAGSTRING);
+	as.Op(DLevelScript::PCD_ASSIGNSCRIPTVAR, 2);
+	as.PushNumber(0);
+	as.Op(DLevelScript::PCD_ASSIGNSCRIPTVAR, 0);
+	top = as.Here();
+	as.Op(DLevelScript::PCD_PUSHSCRIPTVAR, 0);
+	as.PushNumber(LOOPS);
+	as.Op(DLevelScript::PCD_LT);
+	exit = as.Jump(DLevelScript::PCD_IFNOTGOTO);
+	as.Op(DLevelScript::PCD_PUSHSCRIPTVAR, 2);
+	as.Op(DLevelScript::PCD_GETCVAR);
+	as.Op(DLevelScript::PCD_ADDSCRIPTVAR, 1);
+	as.Op(DLevelScript::PCD_INCSCRIPTVAR, 0);
+	as.Jump(DLevelScript::PCD_GOTO, top);
+	as.PatchWord(exit, as.Here());
+	as.Op(DLevelScript::PCD_TERMINATE);
+
+	as.Finish(scripts);
+
+	MemoryReader reader((const char *)&as.Data[0], as.Data.Size());
+	FBehavior *module = new FBehavior(-1, &reader, as.Data.Size());
+
+	for (int i = 0; i < module->NumScripts; ++i)
+	{
+		const ScriptPtr *code = &module->Scripts[i];
+		int iterations = code->Number == 3 ? STRINGLOOPS : LOOPS;
+		cycle_t clock;
+
+		clock.Reset();
+		for (int run = 0; run < runs; ++run)
+		{
+			DLevelScript *script = new DLevelScript(NULL, NULL, code->Number, code, module, NULL, 0, ACS_ALWAYS);
+			clock.Clock();
+			script->RunScript();
+			clock.Unclock();
+			script->Destroy();
+		}
+		Printf ("%-8s %8.3f ms per run, %6.1f ns per iteration\n", names[code->Number - 1],
+			clock.TimeMS() / runs, clock.TimeMS() * 1000000 / runs / iterations);
+	}
+
+	assert(StaticModules.Last() == module);
+	StaticModules.Pop();
+	delete module;
+}
+
+//==========================================================================
+//
+// CCMD acsbench
+//
+//==========================================================================
+
+CCMD (acsbench)
+{
+	int runs = argv.argc() > 1 ? atoi(argv[1]) : 10;
+
+	if (gamestate != GS_LEVEL)
+	{
+		Printf ("You must be in a level to use this command.\n");
+		return;
+	}
+	FBehavior::StaticRunBenchmark (MAX(runs, 1));
+}
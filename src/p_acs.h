@@ -130,9 +130,12 @@ struct ACSProfileInfo
 	unsigned int NumRuns;
 	unsigned int MinInstrPerRun;
 	unsigned int MaxInstrPerRun;
+	double TotalMS;				// only collected while acs_profiletime is on
+	double MaxMS;
 
 	ACSProfileInfo();
 	void AddRun(unsigned int num_instr);
+	void AddTime(double ms);
 	void Reset();
 };
 
@@ -234,9 +237,10 @@ public:
 	BYTE *NextChunk (BYTE *chunk) const;
 	const ScriptPtr *FindScript (int number) const;
 	void StartTypedScripts (WORD type, AActor *activator, bool always, int arg1, bool runNow);
-	DWORD PC2Ofs (int *pc) const { return (DWORD)((BYTE *)pc - Data); }
-	int *Ofs2PC (DWORD ofs) const {	return (int *)(Data + ofs); }
+	DWORD PC2Ofs (int *pc) const { return Code == Data ? (DWORD)((BYTE *)pc - Data) : CodeOfs[(BYTE *)pc - Code]; }
+	int *Ofs2PC (DWORD ofs) const {	return Code == Data ? (int *)(Data + ofs) : (int *)(Code + (ofs < (DWORD)DataSize && CodeMap[ofs] >= 0 ? CodeMap[ofs] : 0)); }
 	int *Jump2PC (DWORD jumpPoint) const { return Ofs2PC(JumpPoints[jumpPoint]); }
+	int *Branch2PC (DWORD target) const { return (int *)(Code + target); }
 	ACSFormat GetFormat() const { return Format; }
 	ScriptFunction *GetFunction (int funcnum, FBehavior *&module) const;
 	int GetArrayVal (int arraynum, int index) const;
@@ -247,7 +251,7 @@ public:
 	int FindMapVarName (const char *varname) const;
 	int FindMapArray (const char *arrayname) const;
 	int GetLibraryID () const { return LibraryID; }
-	int *GetScriptAddress (const ScriptPtr *ptr) const { return (int *)(ptr->Address + Data); }
+	int *GetScriptAddress (const ScriptPtr *ptr) const { return Ofs2PC(ptr->Address); }
 	int GetScriptIndex (const ScriptPtr *ptr) const { ptrdiff_t index = ptr - Scripts; return index >= NumScripts ? -1 : (int)index; }
 	ScriptPtr *GetScriptPtr(int index) const { return index >= 0 && index < NumScripts ? &Scripts[index] : NULL; }
 	int GetLumpNum() const { return LumpNum; }
@@ -272,6 +276,7 @@ public:
 	static const char *StaticLookupString (DWORD index);
 	static void StaticStartTypedScripts (WORD type, AActor *activator, bool always, int arg1=0, bool runNow=false);
 	static void StaticStopMyScripts (AActor *actor);
+	static void StaticRunBenchmark (int runs);
 
 private:
 	struct ArrayInfo;
@@ -281,6 +286,10 @@ private:
 	int LumpNum;
 	BYTE *Data;
 	int DataSize;
+	BYTE *Code;			// what scripts run; Data unless the pcode had to be decoded
+	int CodeSize;
+	int *CodeMap;		// offset in Data -> offset in Code, or -1
+	DWORD *CodeOfs;		// offset in Code -> offset in Data
 	BYTE *Chunks;
 	ScriptPtr *Scripts;
 	int NumScripts;
@@ -301,6 +310,7 @@ private:
 	static TArray<FBehavior *> StaticModules;
 
 	void LoadScriptsDirectory ();
+	void DecodeCode ();
 
 	static int STACK_ARGS SortScripts (const void *a, const void *b);
 	void UnencryptStrings ();
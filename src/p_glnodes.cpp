@@ -1048,7 +1048,7 @@ bool P_CheckNodes(MapData * map, bool rebuilt, int buildtime)
 
 typedef TArray<BYTE> MemFile;
 
-static FString GetCachePath()
+FString GetCachePath()
 {
 	FString path;
 
@@ -282,6 +282,35 @@ public:
 	void Reset() { StartBlock(minx, miny); }
 };
 
+// With p_actorcells, each block keeps its actors in an array instead of a
+// list of FBlockNodes. Actors are appended when linked and walked from the
+// end, which gives the same order as the lists.
+struct FActorCellEntry
+{
+	AActor *Actor;			// NULL if unlinked while the block was being walked
+	bool MultiBlock;		// also linked into other blocks
+};
+
+extern TArray<FActorCellEntry> *ActorCells;
+
+// Walks the actors in a single block, most recently linked first.
+class FBlockLinkIterator
+{
+	FBlockNode *node;
+	int cell;
+	int pos;
+
+public:
+	FBlockLinkIterator(int index = -1);
+	~FBlockLinkIterator();
+	void Start(int index);
+	AActor *Next(bool &multiblock);
+	AActor *Next() { bool multiblock; return Next(multiblock); }
+};
+
+void P_DetachActorCells (AActor *actor, TArray<int> &slots);
+void P_ReattachActorCells (AActor *actor, const TArray<int> &slots);
+
 class FBlockThingsIterator
 {
 	int minx, maxx;
@@ -289,7 +318,7 @@ class FBlockThingsIterator
 
 	int curx, cury;
 
-	FBlockNode *block;
+	FBlockLinkIterator links;
 
 	int Buckets[32];
 
@@ -428,6 +457,12 @@ enum ESightFlags
 };
 
 void	P_ResetSightCounters (bool full);
+void	P_PrepareSightChecks ();
+void	P_InvalidateSightChecks ();
+void	P_StartSightCheck ();
+bool	P_FinishSightCheck ();
+void	P_FreePVS ();
+extern bool SightChecksCached;
 bool	P_TalkFacing (AActor *player);
 void	P_UseLines (player_t* player);
 bool	P_UsePuzzleItem (AActor *actor, int itemType);
@@ -525,6 +560,7 @@ inline sector_t *P_PointInSector(fixed_t x, fixed_t y)
 // P_SETUP
 //
 extern BYTE*			rejectmatrix;	// for fast sight rejection
+extern BYTE*			pvsmatrix;		// built from the nodes when REJECT is not enough
 extern int*				blockmaplump;	// offsets in blockmap are from here
 
 extern int*				blockmap;
@@ -52,6 +52,7 @@
 #include "p_conversation.h"
 #include "r_data/r_translate.h"
 #include "g_level.h"
+#include "stats.h"
 
 #define WATER_SINK_FACTOR		3
 #define WATER_SINK_SMALL_FACTOR	4
@@ -4429,6 +4430,7 @@ bool P_UsePuzzleItem (AActor *PuzzleItemUser, int PuzzleItemType)
 			int args[3] = { in->d.line->args[2], in->d.line->args[3], in->d.line->args[4] };
 			P_StartScript (PuzzleItemUser, in->d.line, in->d.line->args[1], NULL, args, 3, ACS_ALWAYS);
 			in->d.line->special = 0;
+			P_InvalidateSightChecks ();
 			return true;
 		}
 		// Check thing
@@ -5175,6 +5177,8 @@ bool P_ChangeSector (sector_t *sector, int crunch, int amt, int floorOrCeil, boo
 	void (*iterator2)(AActor *, FChangePosition *) = NULL;
 	msecnode_t *n;
 
+	P_InvalidateSightChecks ();
+
 	cpos.nofit = false;
 	cpos.crushchange = crunch;
 	cpos.moveamt = abs (amt);
@@ -5715,3 +5719,76 @@ bool P_ActivateThingSpecial(AActor * thing, AActor * trigger, bool death)
 	// Returns the result
 	return res;
 }
+
+//==========================================================================
+//
+// CCMD blockthingsbench
+//
+// Runs the actor search of P_CheckPosition, without any of its side
+// effects, for every solid or shootable actor on the level and reports how
+// long a pass takes. Useful for comparing changes to actor layout and the
+// blockmap on maps with lots of monsters.
+//
+//==========================================================================
+
+CCMD (blockthingsbench)
+{
+	int runs = argv.argc() > 1 ? atoi(argv[1]) : 10;
+
+	if (gamestate != GS_LEVEL)
+	{
+		Printf ("You must be in a level to use this command.\n");
+		return;
+	}
+	if (runs < 1)
+	{
+		runs = 1;
+	}
+
+	TArray<AActor *> movers;
+	TThinkerIterator<AActor> it;
+	AActor *mo;
+
+	while ((mo = it.Next()) != NULL)
+	{
+		if (!(mo->flags & MF_NOBLOCKMAP) && (mo->flags & (MF_SOLID|MF_SHOOTABLE)))
+		{
+			movers.Push (mo);
+		}
+	}
+
+	cycle_t clock;
+	int candidates = 0, contacts = 0;
+
+	clock.Reset();
+	clock.Clock();
+	for (int run = 0; run < runs; ++run)
+	{
+		for (unsigned int i = 0; i < movers.Size(); ++i)
+		{
+			mo = movers[i];
+			FBlockThingsIterator bit(FBoundingBox(mo->x, mo->y, mo->radius));
+			AActor *thing;
+
+			while ((thing = bit.Next()) != NULL)
+			{
+				candidates++;
+				if (!((thing->flags & (MF_SOLID|MF_SPECIAL|MF_SHOOTABLE)) || thing->flags6 & MF6_TOUCHY))
+					continue;
+
+				fixed_t blockdist = thing->radius + mo->radius;
+				if (abs(thing->x - mo->x) >= blockdist || abs(thing->y - mo->y) >= blockdist)
+					continue;
+
+				if (thing != mo)
+				{
+					contacts++;
+				}
+			}
+		}
+	}
+	clock.Unclock();
+
+	Printf ("%u actors: %.3f ms per pass, %d candidates and %d contacts per pass\n",
+		movers.Size(), clock.TimeMS() / runs, candidates / runs, contacts / runs);
+}
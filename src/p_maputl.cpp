@@ -42,6 +42,8 @@
 #include "po_man.h"
 
 static AActor *RoughBlockCheck (AActor *mo, int index, void *);
+static void P_LinkActorCells (AActor *actor, int x1, int y1, int x2, int y2);
+static void P_UnlinkActorCells (AActor *actor);
 
 
 //==========================================================================
@@ -289,6 +291,11 @@ void AActor::UnlinkFromWorld ()
 		
 	if (!(flags & MF_NOBLOCKMAP))
 	{
+		if (BlockW != 0)
+		{
+			P_UnlinkActorCells (this);
+		}
+
 		// [RH] Unlink from all blocks this actor uses
 		FBlockNode *block = this->BlockNode;
 
@@ -386,6 +393,10 @@ void AActor::LinkToWorld (sector_t *sec)
 		{ // thing is off the map
 			BlockNode = NULL;
 		}
+		else if (ActorCells != NULL)
+		{
+			P_LinkActorCells (this, MAX (0, x1), MAX (0, y1), MIN (bmapwidth - 1, x2), MIN (bmapheight - 1, y2));
+		}
 		else
         { // [RH] Link into every block this actor touches, not just the center one
 			FBlockNode **alink = &this->BlockNode;
@@ -623,6 +634,210 @@ void FBlockNode::Release ()
 	FreeBlocks = this;
 }
 
+//==========================================================================
+//
+// Actor cells
+//
+// While any block is being walked, unlinked actors are only cleared from
+// their cells, so that the positions of the walkers stay valid. The cells
+// are compacted once the last walker is done.
+//
+//==========================================================================
+
+static int ActorCellWalkers;
+static TArray<int> DirtyActorCells;
+
+static void P_LinkActorCells (AActor *actor, int x1, int y1, int x2, int y2)
+{
+	FActorCellEntry entry;
+
+	entry.Actor = actor;
+	entry.MultiBlock = (x1 != x2 || y1 != y2);
+	for (int y = y1; y <= y2; ++y)
+	{
+		for (int x = x1; x <= x2; ++x)
+		{
+			ActorCells[y*bmapwidth + x].Push (entry);
+		}
+	}
+	actor->BlockX = x1;
+	actor->BlockY = y1;
+	actor->BlockW = x2 - x1 + 1;
+	actor->BlockH = y2 - y1 + 1;
+}
+
+static void P_UnlinkActorCells (AActor *actor)
+{
+	for (int y = actor->BlockY; y < actor->BlockY + actor->BlockH; ++y)
+	{
+		for (int x = actor->BlockX; x < actor->BlockX + actor->BlockW; ++x)
+		{
+			int index = y*bmapwidth + x;
+			TArray<FActorCellEntry> &cell = ActorCells[index];
+
+			for (unsigned int i = cell.Size(); i-- > 0; )
+			{
+				if (cell[i].Actor == actor)
+				{
+					if (ActorCellWalkers == 0)
+					{
+						cell.Delete (i);
+					}
+					else
+					{
+						cell[i].Actor = NULL;
+						DirtyActorCells.Push (index);
+					}
+					break;
+				}
+			}
+		}
+	}
+	actor->BlockW = actor->BlockH = 0;
+}
+
+static void P_CompactActorCells ()
+{
+	for (unsigned int i = 0; i < DirtyActorCells.Size(); ++i)
+	{
+		TArray<FActorCellEntry> &cell = ActorCells[DirtyActorCells[i]];
+		unsigned int j, k;
+
+		for (j = k = 0; j < cell.Size(); ++j)
+		{
+			if (cell[j].Actor != NULL)
+			{
+				cell[k++] = cell[j];
+			}
+		}
+		cell.Resize (k);
+	}
+	DirtyActorCells.Clear();
+}
+
+//==========================================================================
+//
+// P_DetachActorCells
+//
+// Takes an actor out of its cells for player prediction and remembers
+// where it was, so P_ReattachActorCells can put it back in the same order.
+//
+//==========================================================================
+
+void P_DetachActorCells (AActor *actor, TArray<int> &slots)
+{
+	slots.Clear();
+	for (int y = actor->BlockY; y < actor->BlockY + actor->BlockH; ++y)
+	{
+		for (int x = actor->BlockX; x < actor->BlockX + actor->BlockW; ++x)
+		{
+			TArray<FActorCellEntry> &cell = ActorCells[y*bmapwidth + x];
+			unsigned int i;
+
+			for (i = cell.Size(); i-- > 0; )
+			{
+				if (cell[i].Actor == actor)
+				{
+					cell.Delete (i);
+					break;
+				}
+			}
+			slots.Push (int(i));
+		}
+	}
+	actor->BlockW = actor->BlockH = 0;
+}
+
+//==========================================================================
+//
+// P_ReattachActorCells
+//
+// The actor's block range must already be restored to what it was when
+// P_DetachActorCells was called.
+//
+//==========================================================================
+
+void P_ReattachActorCells (AActor *actor, const TArray<int> &slots)
+{
+	FActorCellEntry entry;
+	unsigned int k = 0;
+
+	entry.Actor = actor;
+	entry.MultiBlock = (actor->BlockW > 1 || actor->BlockH > 1);
+	for (int y = actor->BlockY; y < actor->BlockY + actor->BlockH; ++y)
+	{
+		for (int x = actor->BlockX; x < actor->BlockX + actor->BlockW; ++x)
+		{
+			TArray<FActorCellEntry> &cell = ActorCells[y*bmapwidth + x];
+			int slot = k < slots.Size() ? slots[k++] : -1;
+
+			if (slot >= 0)
+			{
+				cell.Insert (MIN<unsigned int> (slot, cell.Size()), entry);
+			}
+		}
+	}
+}
+
+//===========================================================================
+//
+// FBlockLinkIterator
+//
+//===========================================================================
+
+FBlockLinkIterator::FBlockLinkIterator(int index)
+{
+	ActorCellWalkers++;
+	Start(index);
+}
+
+FBlockLinkIterator::~FBlockLinkIterator()
+{
+	if (--ActorCellWalkers == 0 && DirtyActorCells.Size() != 0)
+	{
+		P_CompactActorCells();
+	}
+}
+
+void FBlockLinkIterator::Start(int index)
+{
+	node = NULL;
+	cell = index;
+	pos = 0;
+	if (index >= 0)
+	{
+		if (ActorCells != NULL)
+		{
+			pos = ActorCells[index].Size();
+		}
+		else
+		{
+			node = blocklinks[index];
+		}
+	}
+}
+
+AActor *FBlockLinkIterator::Next(bool &multiblock)
+{
+	if (node != NULL)
+	{
+		AActor *me = node->Me;
+		multiblock = node->NextBlock != NULL || node->PrevBlock != &me->BlockNode;
+		node = node->NextActor;
+		return me;
+	}
+	while (pos > 0)
+	{
+		FActorCellEntry *entry = &ActorCells[cell][--pos];
+		if (entry->Actor != NULL)
+		{
+			multiblock = entry->MultiBlock;
+			return entry->Actor;
+		}
+	}
+	return NULL;
+}
+
 //
 // BLOCK MAP ITERATORS
 // For each line/thing in the given mapblock,
@@ -770,7 +985,6 @@ FBlockThingsIterator::FBlockThingsIterator()
 	minx = maxx = 0;
 	miny = maxy = 0;
 	ClearHash();
-	block = NULL;
 }
 
 FBlockThingsIterator::FBlockThingsIterator(int _minx, int _miny, int _maxx, int _maxy)
@@ -820,12 +1034,12 @@ void FBlockThingsIterator::StartBlock(int x, int y)
 	cury = y; 
 	if (x >= 0 && y >= 0 && x < bmapwidth && y <bmapheight)
 	{
-		block = blocklinks[y*bmapwidth + x];
+		links.Start(y*bmapwidth + x);
 	}
 	else
 	{
 		// invalid block
-		block = NULL;
+		links.Start(-1);
 	}
 }
 
@@ -852,16 +1066,16 @@ AActor *FBlockThingsIterator::Next(bool centeronly)
 {
 	for (;;)
 	{
-		while (block != NULL)
+		AActor *me;
+		bool multiblock;
+
+		while ((me = links.Next(multiblock)) != NULL)
 		{
-			AActor *me = block->Me;
-			FBlockNode *mynode = block;
 			HashEntry *entry;
 			int i;
 
-			block = block->NextActor;
 			// Don't recheck things that were already checked
-			if (mynode->NextBlock == NULL && mynode->PrevBlock == &me->BlockNode)
+			if (!multiblock)
 			{ // This actor doesn't span blocks, so we know it can only ever be checked once.
 				return me;
 			}
@@ -1504,19 +1718,20 @@ AActor *P_BlockmapSearch (AActor *mo, int distance, AActor *(*check)(AActor*, in
 static AActor *RoughBlockCheck (AActor *mo, int index, void *param)
 {
 	bool onlyseekable = param != NULL;
-	FBlockNode *link;
+	FBlockLinkIterator it(index);
+	AActor *link;
 
-	for (link = blocklinks[index]; link != NULL; link = link->NextActor)
+	while ((link = it.Next()) != NULL)
 	{
-		if (link->Me != mo)
+		if (link != mo)
 		{
-			if (onlyseekable && !mo->CanSeek(link->Me))
+			if (onlyseekable && !mo->CanSeek(link))
 			{
 				continue;
 			}
-			if (mo->IsOkayToAttack (link->Me))
+			if (mo->IsOkayToAttack (link))
 			{
-				return link->Me;
+				return link;
 			}
 		}
 	}
@@ -0,0 +1,837 @@
+/*
+** p_pvs.cpp
+** Sector to sector visibility computed from the GL nodes
+**
+**---------------------------------------------------------------------------
+** Copyright 2012 The ZDoom Team
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+** Most maps come with an empty REJECT lump, so P_CheckSight has to trace
+** every check. With p_pvs on, a conservative visibility matrix is built
+** from the GL subsectors instead: two sectors are only marked as unable to
+** see each other if no straight line can get from one to the other without
+** crossing a one-sided wall. Every two-sided line counts as open no matter
+** where its floors and ceilings are, so closed doors never hide anything.
+**
+** The matrix is built completely while the map loads, so the same checks
+** are rejected from the first tic on no matter how fast the machine is,
+** and is then saved in the node cache under the map's checksum. p_pvs is
+** a serverinfo cvar, since it changes which sight checks can succeed.
+*/
+
+#include <math.h>
+#include <zlib.h>
+
+#include "templates.h"
+#include "doomdef.h"
+#include "doomstat.h"
+#include "p_local.h"
+#include "p_setup.h"
+#include "r_state.h"
+#include "i_system.h"
+#include "c_cvars.h"
+#include "c_dispatch.h"
+#include "cmdlib.h"
+#include "m_swap.h"
+#include "stats.h"
+#include "threadpool.h"
+
+CVAR (Bool, p_pvs, false, CVAR_SERVERINFO)
+
+// Same layout as rejectmatrix: a set bit means the two sectors cannot see
+// each other. NULL until the matrix is complete.
+BYTE *pvsmatrix;
+
+// Room left for rounding in the sight code. Portals are made this much
+// longer at both ends, and clipping keeps anything this close to the
+// inside of a separating line.
+#define PVS_EPSILON		1.0
+
+enum
+{
+	PVS_MAX_STEPS = 8192,	// per subsector, before falling back to a flood fill
+	PVS_VERSION = 2
+};
+
+struct FPVSWinding
+{
+	double x1, y1, x2, y2;
+};
+
+// A two-sided seg or miniseg, seen from the subsector it belongs to. That
+// subsector is on its right, and Leaf is on its left.
+struct FPVSPortal
+{
+	FPVSWinding Winding;
+	int Leaf;
+};
+
+struct FPVSLeaf
+{
+	int FirstPortal;
+	int NumPortals;
+};
+
+struct FPVSFrame
+{
+	int Leaf;
+	int Portal;
+	bool First;
+	FPVSWinding Source;
+	FPVSWinding Pass;
+};
+
+struct FPVSScratch
+{
+	TArray<BYTE> LeafVisible;
+	TArray<BYTE> OnStack;
+	TArray<int> Touched;
+	TArray<FPVSFrame> Stack;
+	int Steps;
+	int Overruns;
+};
+
+static TArray<FPVSPortal> PVSPortals;
+static TArray<FPVSLeaf> PVSLeaves;
+static TArray<int> PVSLeafSectors;
+static TArray<int> PVSSectorLeaves;		// leaves sorted by sector
+static TArray<int> PVSSectorFirst;		// numsectors + 1 entries into PVSSectorLeaves
+static TArray<bool> PVSSectorUnsure;
+static FPVSScratch PVSScratch[FThreadPool::MAX_THREADS];
+
+static BYTE *PVSRows;					// one byte-aligned row per source sector
+static int PVSRowBytes;
+static FString PVSCacheName;
+static BYTE PVSChecksum[16];
+static int PVSCounts[2];				// sectors built, subsectors that overran
+static cycle_t PVSCycles;
+
+//==========================================================================
+//
+// P_ClipWinding
+//
+// Keeps the part of w that lies on the given side of the line through
+// (ax,ay)-(bx,by), where side 1 is left. Returns false if nothing is left.
+//
+//==========================================================================
+
+static bool P_ClipWinding (FPVSWinding &w, double ax, double ay, double bx, double by, double side)
+{
+	double dx = bx - ax, dy = by - ay;
+	double len = sqrt (dx*dx + dy*dy);
+
+	if (len < 1/65536.)
+	{
+		return true;
+	}
+	side /= len;
+
+	double d1 = side * (dx * (w.y1 - ay) - dy * (w.x1 - ax)) + PVS_EPSILON;
+	double d2 = side * (dx * (w.y2 - ay) - dy * (w.x2 - ax)) + PVS_EPSILON;
+
+	if (d1 >= 0 && d2 >= 0)
+	{
+		return true;
+	}
+	if (d1 < 0 && d2 < 0)
+	{
+		return false;
+	}
+
+	double frac = d1 / (d1 - d2);
+	double mx = w.x1 + (w.x2 - w.x1) * frac;
+	double my = w.y1 + (w.y2 - w.y1) * frac;
+
+	if (d1 < 0)
+	{
+		w.x1 = mx;
+		w.y1 = my;
+	}
+	else
+	{
+		w.x2 = mx;
+		w.y2 = my;
+	}
+	return true;
+}
+
+//==========================================================================
+//
+// P_ClipToSeparators
+//
+// Any straight line that crosses first and then second can only reach the
+// area between the two lines that separate them. Clips target, which lies
+// beyond second, to that area.
+//
+//==========================================================================
+
+static bool P_ClipToSeparators (const FPVSWinding &first, const FPVSWinding &second, FPVSWinding &target)
+{
+	const double fx[2] = { first.x1, first.x2 }, fy[2] = { first.y1, first.y2 };
+	const double sx[2] = { second.x1, second.x2 }, sy[2] = { second.y1, second.y2 };
+
+	for (int i = 0; i < 2; ++i)
+	{
+		for (int j = 0; j < 2; ++j)
+		{
+			double dx = sx[j] - fx[i], dy = sy[j] - fy[i];
+
+			if (dx*dx + dy*dy < PVS_EPSILON*PVS_EPSILON)
+			{
+				continue;
+			}
+			// The line through these two points separates the windings if
+			// their other ends are on opposite sides of it.
+			double df = dx * (fy[i^1] - fy[i]) - dy * (fx[i^1] - fx[i]);
+			double ds = dx * (sy[j^1] - fy[i]) - dy * (sx[j^1] - fx[i]);
+
+			if ((df < 0 && ds > 0) || (df > 0 && ds < 0))
+			{
+				if (!P_ClipWinding (target, fx[i], fy[i], sx[j], sy[j], ds > 0 ? 1 : -1))
+				{
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+//==========================================================================
+//
+// P_MarkLeafVisible
+//
+//==========================================================================
+
+static inline void P_MarkLeafVisible (FPVSScratch *scratch, int leaf)
+{
+	if (!scratch->LeafVisible[leaf])
+	{
+		scratch->LeafVisible[leaf] = true;
+		scratch->Touched.Push (leaf);
+	}
+}
+
+//==========================================================================
+//
+// P_FloodLeaf
+//
+// Marks every subsector that can be reached through portals at all. Used
+// when the real flow would take too long.
+//
+//==========================================================================
+
+static void P_FloodLeaf (FPVSScratch *scratch, int start)
+{
+	P_MarkLeafVisible (scratch, start);
+	for (unsigned int i = 0; i < scratch->Touched.Size(); ++i)
+	{
+		const FPVSLeaf *leaf = &PVSLeaves[scratch->Touched[i]];
+
+		for (int j = 0; j < leaf->NumPortals; ++j)
+		{
+			P_MarkLeafVisible (scratch, PVSPortals[leaf->FirstPortal + j].Leaf);
+		}
+	}
+}
+
+//==========================================================================
+//
+// P_FlowLeaf
+//
+// Finds every subsector that can be seen from start by walking the portal
+// graph and narrowing the view at each step. The first portal is kept as
+// the source, and the portal last passed through is clipped by the lines
+// that separate it from the source, and the source by the lines that
+// separate it from that portal.
+//
+//==========================================================================
+
+static void P_FlowLeaf (FPVSScratch *scratch, int start)
+{
+	const FPVSLeaf *startleaf = &PVSLeaves[start];
+	TArray<FPVSFrame> &stack = scratch->Stack;
+
+	scratch->Steps = 0;
+	scratch->OnStack[start] = true;
+	P_MarkLeafVisible (scratch, start);
+
+	for (int i = 0; i < startleaf->NumPortals; ++i)
+	{
+		const FPVSPortal *first = &PVSPortals[startleaf->FirstPortal + i];
+		FPVSFrame frame;
+
+		if (scratch->OnStack[first->Leaf])
+		{
+			continue;
+		}
+		P_MarkLeafVisible (scratch, first->Leaf);
+		frame.Leaf = first->Leaf;
+		frame.Portal = 0;
+		frame.First = true;
+		frame.Source = frame.Pass = first->Winding;
+		scratch->OnStack[first->Leaf] = true;
+		stack.Clear();
+		stack.Push (frame);
+
+		while (stack.Size() != 0)
+		{
+			FPVSFrame *f = &stack[stack.Size() - 1];
+			const FPVSLeaf *leaf = &PVSLeaves[f->Leaf];
+
+			if (f->Portal == leaf->NumPortals)
+			{
+				scratch->OnStack[f->Leaf] = false;
+				stack.Pop ();
+				continue;
+			}
+
+			const FPVSPortal *portal = &PVSPortals[leaf->FirstPortal + f->Portal++];
+			if (scratch->OnStack[portal->Leaf])
+			{
+				continue;
+			}
+			if (++scratch->Steps > PVS_MAX_STEPS)
+			{
+				for (unsigned int j = 0; j < stack.Size(); ++j)
+				{
+					scratch->OnStack[stack[j].Leaf] = false;
+				}
+				scratch->OnStack[start] = false;
+				scratch->Overruns++;
+				P_FloodLeaf (scratch, start);
+				return;
+			}
+
+			FPVSWinding target = portal->Winding;
+			FPVSWinding source = f->Source;
+			const FPVSWinding &pass = f->Pass;
+
+			if (!P_ClipWinding (target, pass.x1, pass.y1, pass.x2, pass.y2, 1))
+			{
+				continue;
+			}
+			if (!f->First)
+			{
+				if (!P_ClipToSeparators (source, pass, target) ||
+					!P_ClipToSeparators (target, pass, source))
+				{
+					continue;
+				}
+			}
+			P_MarkLeafVisible (scratch, portal->Leaf);
+
+			FPVSFrame next;
+			next.Leaf = portal->Leaf;
+			next.Portal = 0;
+			next.First = false;
+			next.Source = source;
+			next.Pass = target;
+			scratch->OnStack[portal->Leaf] = true;
+			stack.Push (next);
+		}
+	}
+	scratch->OnStack[start] = false;
+}
+
+//==========================================================================
+//
+// P_BuildPVSSector
+//
+// Thread pool job: fills in the row for one source sector.
+//
+//==========================================================================
+
+static void P_BuildPVSSector (void *, int slice, int thread)
+{
+	FPVSScratch *scratch = &PVSScratch[thread];
+	int sector = slice;
+	BYTE *row = PVSRows + sector * PVSRowBytes;
+
+	if (PVSSectorUnsure[sector])
+	{
+		memset (row, 0xFF, PVSRowBytes);
+		return;
+	}
+	for (int i = PVSSectorFirst[sector]; i < PVSSectorFirst[sector + 1]; ++i)
+	{
+		P_FlowLeaf (scratch, PVSSectorLeaves[i]);
+		for (unsigned int j = 0; j < scratch->Touched.Size(); ++j)
+		{
+			int leaf = scratch->Touched[j];
+			int seen = PVSLeafSectors[leaf];
+			row[seen >> 3] |= 1 << (seen & 7);
+			scratch->LeafVisible[leaf] = false;
+		}
+		scratch->Touched.Clear();
+	}
+}
+
+//==========================================================================
+//
+// P_MarkNodeMismatch
+//
+// Pushes the polygon of a GL subsector down the game's own BSP tree. Any
+// part of it that ends up in a game subsector of another sector is a
+// place where an actor's sector differs from the one the PVS sees there,
+// so both sectors are marked as unsure.
+//
+//==========================================================================
+
+static void P_MarkNodeMismatch (const TArray<double> &poly, void *node, int sector)
+{
+	unsigned int count = poly.Size() / 2;
+	unsigned int i;
+
+	if (count < 3)
+	{
+		return;
+	}
+	if ((size_t)node & 1)
+	{
+		subsector_t *sub = (subsector_t *)((BYTE *)node - 1);
+		int other = int(sub->sector - sectors);
+
+		if (other != sector)
+		{
+			// Points on a partition line end up on both sides with no
+			// area at all, so only count parts that have some.
+			double area = 0;
+			for (i = 0; i < count; ++i)
+			{
+				unsigned int j = (i + 1) % count;
+				area += poly[i*2] * poly[j*2+1] - poly[j*2] * poly[i*2+1];
+			}
+			if (fabs (area) > 1/512.)
+			{
+				PVSSectorUnsure[sector] = true;
+				PVSSectorUnsure[other] = true;
+			}
+		}
+		return;
+	}
+
+	// Same test as R_PointOnSide: side 1 if the value is positive.
+	node_t *bsp = (node_t *)node;
+	double nx = FIXED2DBL(bsp->x), ny = FIXED2DBL(bsp->y);
+	double ndx = FIXED2DBL(bsp->dx), ndy = FIXED2DBL(bsp->dy);
+	TArray<double> sides[2];
+
+	for (i = 0; i < count; ++i)
+	{
+		unsigned int j = (i + 1) % count;
+		double x1 = poly[i*2], y1 = poly[i*2+1];
+		double x2 = poly[j*2], y2 = poly[j*2+1];
+		double v1 = (y1 - ny) * ndx + (nx - x1) * ndy;
+		double v2 = (y2 - ny) * ndx + (nx - x2) * ndy;
+
+		sides[v1 > 0].Push (x1);
+		sides[v1 > 0].Push (y1);
+		if ((v1 > 0) != (v2 > 0) && v1 != v2)
+		{
+			double frac = v1 / (v1 - v2);
+			double ix = x1 + (x2 - x1) * frac, iy = y1 + (y2 - y1) * frac;
+			sides[0].Push (ix); sides[0].Push (iy);
+			sides[1].Push (ix); sides[1].Push (iy);
+		}
+	}
+	P_MarkNodeMismatch (sides[0], bsp->children[0], sector);
+	P_MarkNodeMismatch (sides[1], bsp->children[1], sector);
+}
+
+//==========================================================================
+//
+// P_SetupPVSBuild
+//
+// Collects the portals between subsectors. Returns false if the nodes do
+// not have what is needed.
+//
+//==========================================================================
+
+static bool P_SetupPVSBuild ()
+{
+	int i;
+
+	if (!hasglnodes || glsegextras == NULL || numsubsectors == 0)
+	{
+		return false;
+	}
+
+	PVSLeaves.Resize (numsubsectors);
+	PVSLeafSectors.Resize (numsubsectors);
+	PVSPortals.Clear();
+	for (i = 0; i < numsubsectors; ++i)
+	{
+		subsector_t *sub = &subsectors[i];
+
+		PVSLeaves[i].FirstPortal = PVSPortals.Size();
+		PVSLeafSectors[i] = int(sub->sector - sectors);
+		for (DWORD j = 0; j < sub->numlines; ++j)
+		{
+			seg_t *seg = sub->firstline + j;
+			DWORD partner = glsegextras[seg - segs].PartnerSeg;
+
+			if (partner >= (DWORD)numsegs || (seg->linedef != NULL && seg->backsector == NULL))
+			{ // One-sided walls block everything.
+				continue;
+			}
+			subsector_t *other = glsegextras[partner].Subsector;
+			if (other == NULL || other == sub)
+			{
+				continue;
+			}
+
+			double x1 = FIXED2DBL(seg->v1->x), y1 = FIXED2DBL(seg->v1->y);
+			double x2 = FIXED2DBL(seg->v2->x), y2 = FIXED2DBL(seg->v2->y);
+			double dx = x2 - x1, dy = y2 - y1;
+			double len = sqrt (dx*dx + dy*dy);
+
+			if (len < 1/65536.)
+			{
+				continue;
+			}
+			dx *= PVS_EPSILON / len;
+			dy *= PVS_EPSILON / len;
+
+			FPVSPortal portal;
+			portal.Winding.x1 = x1 - dx;
+			portal.Winding.y1 = y1 - dy;
+			portal.Winding.x2 = x2 + dx;
+			portal.Winding.y2 = y2 + dy;
+			portal.Leaf = int(other - subsectors);
+			PVSPortals.Push (portal);
+		}
+		PVSLeaves[i].NumPortals = PVSPortals.Size() - PVSLeaves[i].FirstPortal;
+	}
+
+	// Group the subsectors by sector.
+	PVSSectorFirst.Resize (numsectors + 1);
+	memset (&PVSSectorFirst[0], 0, (numsectors + 1) * sizeof(int));
+	for (i = 0; i < numsubsectors; ++i)
+	{
+		PVSSectorFirst[PVSLeafSectors[i] + 1]++;
+	}
+	for (i = 0; i < numsectors; ++i)
+	{
+		PVSSectorFirst[i + 1] += PVSSectorFirst[i];
+	}
+	PVSSectorLeaves.Resize (numsubsectors);
+	{
+		TArray<int> fill;
+		fill.Resize (numsectors);
+		memcpy (&fill[0], &PVSSectorFirst[0], numsectors * sizeof(int));
+		for (i = 0; i < numsubsectors; ++i)
+		{
+			PVSSectorLeaves[fill[PVSLeafSectors[i]]++] = i;
+		}
+	}
+
+	// Actors are put in sectors with the game's own nodes, which may not
+	// agree with the GL nodes where sectors are not properly closed. Such
+	// sectors, and any without a subsector, can see and be seen by anything.
+	PVSSectorUnsure.Resize (numsectors);
+	for (i = 0; i < numsectors; ++i)
+	{
+		PVSSectorUnsure[i] = PVSSectorFirst[i] == PVSSectorFirst[i + 1];
+	}
+	for (i = 0; i < numlines; ++i)
+	{
+		if (lines[i].frontsector == lines[i].backsector)
+		{
+			PVSSectorUnsure[lines[i].frontsector - sectors] = true;
+		}
+	}
+	if (gamenodes != NULL && gamenodes != nodes && numgamenodes > 0)
+	{
+		TArray<double> poly;
+
+		for (i = 0; i < numsubsectors; ++i)
+		{
+			subsector_t *sub = &subsectors[i];
+
+			poly.Clear();
+			for (DWORD j = 0; j < sub->numlines; ++j)
+			{
+				poly.Push (FIXED2DBL(sub->firstline[j].v1->x));
+				poly.Push (FIXED2DBL(sub->firstline[j].v1->y));
+			}
+			P_MarkNodeMismatch (poly, gamenodes + numgamenodes - 1, PVSLeafSectors[i]);
+		}
+	}
+	else if (gamenodes != NULL && gamenodes != nodes)
+	{
+		// The game has a single subsector, so all actors are in its sector.
+		for (i = 0; i < numsectors; ++i)
+		{
+			PVSSectorUnsure[i] = true;
+		}
+	}
+
+	PVSRowBytes = (numsectors + 7) >> 3;
+	PVSRows = new BYTE[numsectors * PVSRowBytes];
+	memset (PVSRows, 0, numsectors * PVSRowBytes);
+
+	ThreadPool.Reserve (FThreadPool::GetProcessorCount());
+	return true;
+}
+
+//==========================================================================
+//
+// P_LoadCachedPVS
+//
+//==========================================================================
+
+static bool P_LoadCachedPVS ()
+{
+	const int neededsize = (numsectors * numsectors + 7) >> 3;
+	BYTE header[28];
+	DWORD complen;
+	long remaining;
+	BYTE *compressed = NULL;
+	bool ok = false;
+
+	FILE *f = fopen (PVSCacheName, "rb");
+	if (f == NULL)
+	{
+		return false;
+	}
+	if (fread (header, 1, 28, f) == 28 &&
+		memcmp (header, "PVS ", 4) == 0 &&
+		LittleLong (*(DWORD *)&header[4]) == PVS_VERSION &&
+		LittleLong (*(DWORD *)&header[8]) == (DWORD)numsectors &&
+		memcmp (header + 12, PVSChecksum, 16) == 0 &&
+		fread (&complen, 4, 1, f) == 1)
+	{
+		complen = LittleLong (complen);
+
+		// Don't trust the stored length further than the file goes.
+		remaining = ftell (f);
+		fseek (f, 0, SEEK_END);
+		remaining = ftell (f) - remaining;
+		fseek (f, 32, SEEK_SET);
+		if (complen == 0 || remaining < 0 || complen > (DWORD)remaining)
+		{
+			fclose (f);
+			return false;
+		}
+		compressed = new BYTE[complen];
+		if (fread (compressed, 1, complen, f) == complen)
+		{
+			uLongf outlen = neededsize;
+			pvsmatrix = new BYTE[neededsize];
+			ok = uncompress (pvsmatrix, &outlen, compressed, complen) == Z_OK && outlen == (uLongf)neededsize;
+			if (!ok)
+			{
+				delete[] pvsmatrix;
+				pvsmatrix = NULL;
+			}
+		}
+		delete[] compressed;
+	}
+	fclose (f);
+	return ok;
+}
+
+//==========================================================================
+//
+// P_SavePVS
+//
+//==========================================================================
+
+static void P_SavePVS ()
+{
+	const int neededsize = (numsectors * numsectors + 7) >> 3;
+	uLongf complen = compressBound (neededsize);
+	BYTE *compressed = new BYTE[complen];
+
+	if (compress (compressed, &complen, pvsmatrix, neededsize) == Z_OK)
+	{
+		FString path = PVSCacheName;
+		CreatePath (path.Left (path.LastIndexOf ('/')));
+
+		FILE *f = fopen (path, "wb");
+		if (f != NULL)
+		{
+			DWORD head[3] = { 0, LittleLong ((DWORD)PVS_VERSION), LittleLong ((DWORD)numsectors) };
+			DWORD len = LittleLong ((DWORD)complen);
+			memcpy (head, "PVS ", 4);
+			fwrite (head, 4, 3, f);
+			fwrite (PVSChecksum, 1, 16, f);
+			fwrite (&len, 4, 1, f);
+			fwrite (compressed, 1, complen, f);
+			fclose (f);
+		}
+	}
+	delete[] compressed;
+}
+
+//==========================================================================
+//
+// P_FinishPVS
+//
+// Turns the rows into the final matrix. A sector pair is visible if
+// either one saw the other.
+//
+//==========================================================================
+
+static void P_FinishPVS ()
+{
+	const int neededsize = (numsectors * numsectors + 7) >> 3;
+	int i, j;
+
+	pvsmatrix = new BYTE[neededsize];
+	memset (pvsmatrix, 0, neededsize);
+	for (i = 0; i < numsectors; ++i)
+	{
+		const BYTE *row = PVSRows + i * PVSRowBytes;
+		for (j = 0; j < numsectors; ++j)
+		{
+			const BYTE *other = PVSRows + j * PVSRowBytes;
+			if (!(row[j >> 3] & (1 << (j & 7))) && !(other[i >> 3] & (1 << (i & 7))))
+			{
+				int pnum = i * numsectors + j;
+				pvsmatrix[pnum >> 3] |= 1 << (pnum & 7);
+			}
+		}
+	}
+	delete[] PVSRows;
+	PVSRows = NULL;
+
+	DPrintf ("PVS built in %.1f ms (%d subsectors overran)\n", PVSCycles.TimeMS(), PVSCounts[1]);
+	P_SavePVS ();
+}
+
+//==========================================================================
+//
+// P_BuildPVS
+//
+// Builds every row on the thread pool. A matrix that only covered part of
+// the level would make sight checks depend on when it was finished.
+//
+//==========================================================================
+
+static void P_BuildPVS ()
+{
+	int i;
+
+	PVSCycles.Clock();
+
+	for (i = 0; i < ThreadPool.GetThreadCount(); ++i)
+	{
+		FPVSScratch *scratch = &PVSScratch[i];
+		if ((int)scratch->LeafVisible.Size() != numsubsectors)
+		{
+			scratch->LeafVisible.Resize (numsubsectors);
+			scratch->OnStack.Resize (numsubsectors);
+			memset (&scratch->LeafVisible[0], 0, numsubsectors);
+			memset (&scratch->OnStack[0], 0, numsubsectors);
+		}
+	}
+	ThreadPool.Run (P_BuildPVSSector, NULL, numsectors);
+	PVSCounts[0] = numsectors;
+	for (i = 0; i < ThreadPool.GetThreadCount(); ++i)
+	{
+		PVSCounts[1] += PVSScratch[i].Overruns;
+		PVSScratch[i].Overruns = 0;
+	}
+	PVSCycles.Unclock();
+
+	P_FinishPVS ();
+}
+
+//==========================================================================
+//
+// P_InitPVS
+//
+// Called while a level is loaded.
+//
+//==========================================================================
+
+void P_InitPVS (MapData *map)
+{
+	P_FreePVS ();
+	if (!p_pvs || numsectors == 0)
+	{
+		return;
+	}
+
+	map->GetChecksum (PVSChecksum);
+	PVSCacheName = GetCachePath();
+	PVSCacheName += "/pvs/";
+	for (int i = 0; i < 16; ++i)
+	{
+		PVSCacheName.AppendFormat ("%02x", PVSChecksum[i]);
+	}
+	PVSCacheName += ".pvs";
+
+	if (!P_LoadCachedPVS () && P_SetupPVSBuild ())
+	{
+		P_BuildPVS ();
+	}
+}
+
+//==========================================================================
+//
+// P_FreePVS
+//
+//==========================================================================
+
+void P_FreePVS ()
+{
+	if (pvsmatrix != NULL)
+	{
+		delete[] pvsmatrix;
+		pvsmatrix = NULL;
+	}
+	if (PVSRows != NULL)
+	{
+		delete[] PVSRows;
+		PVSRows = NULL;
+	}
+	PVSCounts[0] = PVSCounts[1] = 0;
+	PVSCycles.Reset();
+}
+
+ADD_STAT (pvs)
+{
+	FString out;
+
+	if (pvsmatrix != NULL && PVSCounts[0] == 0)
+	{
+		out = "ready, loaded from cache";
+	}
+	else if (pvsmatrix != NULL)
+	{
+		out.Format ("ready, %d sectors built in %04.1f ms, %d subsectors overran",
+			PVSCounts[0], PVSCycles.TimeMS(), PVSCounts[1]);
+	}
+	else
+	{
+		out = "not in use";
+	}
+	return out;
+}
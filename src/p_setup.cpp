@@ -51,6 +51,7 @@
 #include "announcer.h"
 #include "wi_stuff.h"
 #include "stats.h"
+#include "threadpool.h"
 #include "doomerrors.h"
 #include "gi.h"
 #include "p_conversation.h"
@@ -90,11 +91,13 @@ extern int numinterpolations;
 extern unsigned int R_OldBlend;
 
 EXTERN_CVAR(Bool, am_textured)
+EXTERN_CVAR(Bool, p_pvs)
 
 CVAR (Bool, genblockmap, false, CVAR_SERVERINFO|CVAR_GLOBALCONFIG);
 CVAR (Bool, gennodes, false, CVAR_SERVERINFO|CVAR_GLOBALCONFIG);
 CVAR (Bool, genglnodes, false, CVAR_SERVERINFO);
 CVAR (Bool, showloadtimes, false, 0);
+CVAR (Bool, p_actorcells, false, CVAR_ARCHIVE|CVAR_GLOBALCONFIG);	// takes effect on the next map
 
 static void P_InitTagLists ();
 static void P_Shutdown ();
@@ -170,6 +173,7 @@ int				bmapnegx;		// min negs of block map before wrapping
 int				bmapnegy;
 
 FBlockNode**	blocklinks;		// for thing chains
+TArray<FActorCellEntry> *ActorCells;	// used instead of blocklinks with p_actorcells
 
 
 // REJECT
@@ -3018,6 +3022,10 @@ void P_LoadBlockMap (MapData * map)
 	count = bmapwidth*bmapheight;
 	blocklinks = new FBlockNode *[count];
 	memset (blocklinks, 0, count*sizeof(*blocklinks));
+	if (p_actorcells)
+	{
+		ActorCells = new TArray<FActorCellEntry>[count];
+	}
 	blockmap = blockmaplump+4;
 }
 
@@ -3443,6 +3451,11 @@ void P_FreeLevelData ()
 		delete[] blocklinks;
 		blocklinks = NULL;
 	}
+	if (ActorCells != NULL)
+	{
+		delete[] ActorCells;
+		ActorCells = NULL;
+	}
 	if (PolyBlockMap != NULL)
 	{
 		for (int i = bmapwidth*bmapheight-1; i >= 0; --i)
@@ -3463,6 +3476,7 @@ void P_FreeLevelData ()
 		delete[] rejectmatrix;
 		rejectmatrix = NULL;
 	}
+	P_FreePVS ();
 	if (linebuffer != NULL)
 	{
 		delete[] linebuffer;
@@ -3918,9 +3932,10 @@ void P_SetupLevel (char *lumpname, int position)
 		gamenodes=NULL;
 	}
 
-	if (RequireGLNodes)
+	if (RequireGLNodes || p_pvs)
 	{
 		// Build GL nodes if we want a textured automap or GL nodes are forced to be built.
+		// The PVS needs them too, since it works with closed subsectors.
 		// If the original nodes being loaded are not GL nodes they will be kept around for
 		// use in P_PointInSubsector to avoid problems with maps that depend on the specific
 		// nodes they were built with (P:AR E1M3 is a good example for a map where this is the case.)
@@ -3953,6 +3968,11 @@ void P_SetupLevel (char *lumpname, int position)
 		P_SetRenderSector();
 	}
 
+	if (!buildmap)
+	{
+		P_InitPVS (map);
+	}
+
 	bodyqueslot = 0;
 // phares 8/10/98: Clear body queue so the corpses from previous games are
 // not assumed to be from this one.
@@ -4071,6 +4091,7 @@ void P_SetupLevel (char *lumpname, int position)
 	// [RH] Remove all particles
 	P_ClearParticles ();
 
+	Wads.ResetPrefetchStats ();
 	times[17].Clock();
 	// preload graphics and sounds
 	if (precache)
@@ -4116,6 +4137,12 @@ void P_SetupLevel (char *lumpname, int position)
 			};
 			Printf ("Time%3d:%9.4f ms (%s)\n", i, times[i].TimeMS(), timenames[i]);
 		}
+
+		int prefetchlumps, prefetchbytes;
+		double prefetchms;
+		Wads.GetPrefetchStats (prefetchlumps, prefetchbytes, prefetchms);
+		Printf ("Precache prefetched %d lumps (%d KB) in %.4f ms on %d threads\n",
+			prefetchlumps, prefetchbytes >> 10, prefetchms, ThreadPool.GetThreadCount());
 	}
 	MapThingsConverted.Clear();
 	MapThingsUserDataIndex.Clear();
@@ -125,6 +125,8 @@ bool P_LoadGLNodes(MapData * map);
 bool P_CheckNodes(MapData * map, bool rebuilt, int buildtime);
 bool P_CheckForGLNodes();
 void P_SetRenderSector();
+FString GetCachePath();
+void P_InitPVS (MapData *map);
 
 
 struct sidei_t	// [RH] Only keep BOOM sidedef init stuff around for init
@@ -24,6 +24,12 @@
 #include "r_state.h"
 
 #include "stats.h"
+#include "c_cvars.h"
+#include "c_dispatch.h"
+#include "doomstat.h"
+#include "d_player.h"
+#include "statnums.h"
+#include "threadpool.h"
 
 static FRandom pr_botchecksight ("BotCheckSight");
 static FRandom pr_checksight ("CheckSight");
@@ -45,6 +51,19 @@ static cycle_t MaxSightCycles;
 
 static TArray<intercept_t> intercepts (128);
 
+// Private state for sight checks that run off the main thread. These
+// cannot use validcount, since other threads are marking the same lines.
+struct FSightScratch
+{
+	TArray<intercept_t> Intercepts;
+	TArray<int> LineMarks;
+	TArray<int> PolyMarks;
+	int Mark;
+	int Counts[6];
+
+	FSightScratch() : Mark(0) {}
+};
+
 class SightCheck
 {
 	fixed_t sightzstart;				// eye z of looker
@@ -57,6 +76,9 @@ class SightCheck
 	int Flags;
 	divline_t trace;
 	int myseethrough;
+	TArray<intercept_t> *Intercepts;
+	int *Counts;
+	FSightScratch *Scratch;
 
 	bool PTR_SightTraverse (intercept_t *in);
 	bool P_SightCheckLine (line_t *ld);
@@ -66,7 +88,7 @@ class SightCheck
 public:
 	bool P_SightPathTraverse (fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2);
 
-	SightCheck(const AActor * t1, const AActor * t2, int flags)
+	SightCheck(const AActor * t1, const AActor * t2, int flags, FSightScratch *scratch = NULL)
 	{
 		lastztop = lastzbottom = sightzstart = t1->z + t1->height - (t1->height>>2);
 		lastsector = t1->Sector;
@@ -77,6 +99,18 @@ public:
 		Flags = flags;
 
 		myseethrough = FF_SEETHROUGH;
+
+		Scratch = scratch;
+		if (scratch == NULL)
+		{
+			Intercepts = &intercepts;
+			Counts = sightcounts;
+		}
+		else
+		{
+			Intercepts = &scratch->Intercepts;
+			Counts = scratch->Counts;
+		}
 	}
 };
 
@@ -238,11 +272,23 @@ bool SightCheck::P_SightCheckLine (line_t *ld)
 {
 	divline_t dl;
 
-	if (ld->validcount == validcount)
+	if (Scratch == NULL)
 	{
-		return true;
+		if (ld->validcount == validcount)
+		{
+			return true;
+		}
+		ld->validcount = validcount;
+	}
+	else
+	{
+		int *mark = &Scratch->LineMarks[int(ld - lines)];
+		if (*mark == Scratch->Mark)
+		{
+			return true;
+		}
+		*mark = Scratch->Mark;
 	}
-	ld->validcount = validcount;
 	if (P_PointOnDivlineSide (ld->v1->x, ld->v1->y, &trace) ==
 		P_PointOnDivlineSide (ld->v2->x, ld->v2->y, &trace))
 	{
@@ -287,12 +333,12 @@ bool SightCheck::P_SightCheckLine (line_t *ld)
 		}
 	}
 
-	sightcounts[3]++;
+	Counts[3]++;
 	// store the line for later intersection testing
 	intercept_t newintercept;
 	newintercept.isaline = true;
 	newintercept.d.line = ld;
-	intercepts.Push (newintercept);
+	Intercepts->Push (newintercept);
 
 	return true;
 }
@@ -321,9 +367,21 @@ bool SightCheck::P_SightBlockLinesIterator (int x, int y)
 	{
 		if (polyLink->polyobj)
 		{ // only check non-empty links
-			if (polyLink->polyobj->validcount != validcount)
+			bool unchecked;
+
+			if (Scratch == NULL)
 			{
+				unchecked = polyLink->polyobj->validcount != validcount;
 				polyLink->polyobj->validcount = validcount;
+			}
+			else
+			{
+				int *mark = &Scratch->PolyMarks[int(polyLink->polyobj - polyobjs)];
+				unchecked = *mark != Scratch->Mark;
+				*mark = Scratch->Mark;
+			}
+			if (unchecked)
+			{
 				for (i = 0; i < polyLink->polyobj->Linedefs.Size(); i++)
 				{
 					if (!P_SightCheckLine (polyLink->polyobj->Linedefs[i]))
@@ -362,6 +420,8 @@ bool SightCheck::P_SightTraverseIntercepts ()
 	unsigned scanpos;
 	divline_t dl;
 
+	TArray<intercept_t> &intercepts = *Intercepts;
+
 	count = intercepts.Size ();
 //
 // calculate intercept distance
@@ -450,8 +510,15 @@ bool SightCheck::P_SightPathTraverse (fixed_t x1, fixed_t y1, fixed_t x2, fixed_
 	int mapx, mapy, mapxstep, mapystep;
 	int count;
 
-	validcount++;
-	intercepts.Clear ();
+	if (Scratch == NULL)
+	{
+		validcount++;
+	}
+	else
+	{
+		Scratch->Mark++;
+	}
+	Intercepts->Clear ();
 
 #ifdef _3DFLOORS
 	// for FF_SEETHROUGH the following rule applies:
@@ -575,7 +642,7 @@ bool SightCheck::P_SightPathTraverse (fixed_t x1, fixed_t y1, fixed_t x2, fixed_
 	{
 		if (!P_SightBlockLinesIterator (mapx, mapy))
 		{
-sightcounts[1]++;
+Counts[1]++;
 			return false;	// early out
 		}
 
@@ -585,7 +652,7 @@ sightcounts[1]++;
 		switch ((((yintercept >> FRACBITS) == mapy) << 1) | ((xintercept >> FRACBITS) == mapx))
 		{
 		case 0:		// neither xintercept nor yintercept match!
-sightcounts[5]++;
+Counts[5]++;
 			// Continuing won't make things any better, so we might as well stop right here
 			count = 100;
 			break;
@@ -605,7 +672,7 @@ sightcounts[5]++;
 			break;
 
 		case 3:		// xintercept and yintercept both match
-			sightcounts[4]++;
+			Counts[4]++;
 			// The trace is exiting a block through its corner. Not only does the block
 			// being entered need to be checked (which will happen when this loop
 			// continues), but the other two blocks adjacent to the corner also need to
@@ -613,7 +680,7 @@ sightcounts[5]++;
 			if (!P_SightBlockLinesIterator (mapx + mapxstep, mapy) ||
 				!P_SightBlockLinesIterator (mapx, mapy + mapystep))
 			{
-sightcounts[1]++;
+Counts[1]++;
 				return false;
 			}
 			xintercept += xstep;
@@ -632,11 +699,288 @@ sightcounts[1]++;
 //
 // couldn't early out, so go through the sorted list
 //
-sightcounts[2]++;
+Counts[2]++;
 
 	return P_SightTraverseIntercepts ( );
 }
 
+//==========================================================================
+//
+// Sight prepass
+//
+// With p_sightthreads at 2 or more, the sight checks that monsters are
+// about to make are traced on worker threads just before the actors in
+// STAT_DEFAULT tick. The list is built in thinker order on the main thread
+// and only covers monsters whose state advances this tic: those with a
+// target will check it for a missile attack, and those without one will
+// look for players.
+//
+// P_CheckSight uses a traced result only while it is certain to be the
+// same as tracing again: both actors must still be where they were, and
+// nothing that can change the map (line specials, ACS, sector movement,
+// non-actor thinkers) may have run in the meantime. Random numbers are
+// still drawn in P_CheckSight in the normal order, so demos and netgames
+// play the same with the prepass on or off. p_sightverify traces every
+// check anyway and reports any result that does not match.
+//
+// Not every piece of code that changes lines or sectors directly has been
+// checked for calling P_InvalidateSightChecks yet, and a stale result in
+// a netgame or demo would desync. Until then the prepass only runs in
+// single player games that are not being recorded, or when checking a
+// demo with -sightcheck.
+//
+//==========================================================================
+
+CUSTOM_CVAR (Int, p_sightthreads, 0, CVAR_SERVERINFO)
+{
+	if (self < 0)
+	{
+		self = 0;
+	}
+	else if (self > FThreadPool::MAX_THREADS)
+	{
+		self = FThreadPool::MAX_THREADS;
+	}
+}
+
+CVAR (Bool, p_sightverify, false, 0)
+
+// -sightcheck: while a demo plays back, the prepass runs no matter what
+// p_sightthreads says and every result it traced is compared with tracing
+// again. The game always uses the traced result, so the demo plays as it
+// would with the prepass off.
+static bool SightCheckDemo;
+static int SightCheckTotals[2];		// compared, mismatched
+
+struct FSightPrepass
+{
+	const AActor *Looker, *Target;
+	int Flags;
+	fixed_t LookerX, LookerY, LookerZ, LookerHeight;
+	fixed_t TargetX, TargetY, TargetZ, TargetHeight;
+	sector_t *LookerSector, *TargetSector;
+	bool Result;
+
+	// Only the current actors are read here. The ones the entry was made
+	// for may have been destroyed since.
+	bool IsCurrent (const AActor *t1, const AActor *t2) const
+	{
+		return t1->x == LookerX && t1->y == LookerY && t1->z == LookerZ &&
+			t1->height == LookerHeight && t1->Sector == LookerSector &&
+			t2->x == TargetX && t2->y == TargetY && t2->z == TargetZ &&
+			t2->height == TargetHeight && t2->Sector == TargetSector;
+	}
+};
+
+static bool SightPrepassActive;
+bool SightChecksCached;		// anything P_InvalidateSightChecks must drop
+static TArray<FSightPrepass> SightPrepass;
+static TArray<int> SightPrepassHash;
+static FSightScratch SightScratch[FThreadPool::MAX_THREADS];
+static int SightPrepassSlices;
+static int PrepassCounts[4];		// traced, used, stale, mismatched
+static cycle_t PrepassCycles;
+
+static unsigned int SightPrepassHashKey (const AActor *t1, const AActor *t2, int flags)
+{
+	size_t a = (size_t)t1 >> 3, b = (size_t)t2 >> 3;
+	return (unsigned int)(a * 0x9E3779B1u) ^ (unsigned int)(b * 0x85EBCA77u) ^ flags;
+}
+
+static FSightPrepass *P_FindSightPrepass (const AActor *t1, const AActor *t2, int flags)
+{
+	unsigned int mask = SightPrepassHash.Size() - 1;
+
+	for (unsigned int i = SightPrepassHashKey (t1, t2, flags) & mask; ; i = (i + 1) & mask)
+	{
+		int index = SightPrepassHash[i];
+		if (index < 0)
+		{
+			return NULL;
+		}
+		FSightPrepass *pre = &SightPrepass[index];
+		if (pre->Looker == t1 && pre->Target == t2 && pre->Flags == flags)
+		{
+			return pre;
+		}
+	}
+}
+
+static void P_AddSightPrepass (AActor *t1, AActor *t2, int flags)
+{
+	FSightPrepass pre;
+
+	pre.Looker = t1;
+	pre.Target = t2;
+	pre.Flags = flags;
+	pre.LookerX = t1->x;
+	pre.LookerY = t1->y;
+	pre.LookerZ = t1->z;
+	pre.LookerHeight = t1->height;
+	pre.LookerSector = t1->Sector;
+	pre.TargetX = t2->x;
+	pre.TargetY = t2->y;
+	pre.TargetZ = t2->z;
+	pre.TargetHeight = t2->height;
+	pre.TargetSector = t2->Sector;
+	pre.Result = false;
+	SightPrepass.Push (pre);
+}
+
+static void P_TraceSightPrepass (void *, int slice, int thread)
+{
+	FSightScratch *scratch = &SightScratch[thread];
+	unsigned int count = SightPrepass.Size();
+	unsigned int first = count * slice / SightPrepassSlices;
+	unsigned int last = count * (slice + 1) / SightPrepassSlices;
+
+	for (unsigned int i = first; i < last; ++i)
+	{
+		FSightPrepass *pre = &SightPrepass[i];
+		SightCheck s(pre->Looker, pre->Target, pre->Flags, scratch);
+		pre->Result = s.P_SightPathTraverse (pre->LookerX, pre->LookerY, pre->TargetX, pre->TargetY);
+	}
+}
+
+//==========================================================================
+//
+// P_PrepareSightChecks
+//
+// Called right before the STAT_DEFAULT thinkers tick.
+//
+//==========================================================================
+
+void P_PrepareSightChecks ()
+{
+	int threads = p_sightthreads;
+	unsigned int i;
+
+	if (SightCheckDemo && demoplayback)
+	{
+		threads = MAX (2, FThreadPool::GetProcessorCount());
+	}
+	else if (netgame || demorecording || demoplayback)
+	{
+		threads = 0;
+	}
+
+	SightPrepassActive = false;
+	SightPrepass.Clear();
+	memset (PrepassCounts, 0, sizeof(PrepassCounts));
+	PrepassCycles.Reset();
+
+	if (threads < 2 || numlines == 0)
+	{
+		return;
+	}
+
+	PrepassCycles.Clock();
+
+	TThinkerIterator<AActor> it(STAT_DEFAULT);
+	AActor *actor;
+
+	while ((actor = it.Next()) != NULL)
+	{
+		if (actor->tics != 1 || actor->health <= 0 ||
+			!(actor->flags3 & MF3_ISMONSTER) || (actor->flags2 & MF2_DORMANT) ||
+			(actor->ObjectFlags & OF_EuthanizeMe))
+		{
+			continue;
+		}
+		AActor *target = actor->target;
+		if (target != NULL)
+		{
+			if (target != actor)
+			{
+				P_AddSightPrepass (actor, target, SF_SEEPASTBLOCKEVERYTHING);
+			}
+		}
+		else
+		{
+			for (int j = 0; j < MAXPLAYERS; ++j)
+			{
+				if (playeringame[j] && players[j].mo != NULL && players[j].mo != actor)
+				{
+					P_AddSightPrepass (actor, players[j].mo, SF_SEEPASTSHOOTABLELINES);
+				}
+			}
+		}
+	}
+
+	if (SightPrepass.Size() != 0)
+	{
+		unsigned int hashsize = 16;
+		while (hashsize < SightPrepass.Size() * 2)
+		{
+			hashsize <<= 1;
+		}
+		SightPrepassHash.Resize (hashsize);
+		memset (&SightPrepassHash[0], -1, hashsize * sizeof(int));
+		for (i = 0; i < SightPrepass.Size(); ++i)
+		{
+			FSightPrepass *pre = &SightPrepass[i];
+			unsigned int slot = SightPrepassHashKey (pre->Looker, pre->Target, pre->Flags) & (hashsize - 1);
+			while (SightPrepassHash[slot] >= 0)
+			{
+				slot = (slot + 1) & (hashsize - 1);
+			}
+			SightPrepassHash[slot] = i;
+		}
+
+		ThreadPool.Reserve (threads);
+		for (int j = 0; j < ThreadPool.GetThreadCount(); ++j)
+		{
+			FSightScratch *scratch = &SightScratch[j];
+			if ((int)scratch->LineMarks.Size() != numlines)
+			{
+				scratch->LineMarks.Resize (numlines);
+				memset (&scratch->LineMarks[0], 0, numlines * sizeof(int));
+			}
+			if ((int)scratch->PolyMarks.Size() < po_NumPolyobjs)
+			{
+				scratch->PolyMarks.Resize (po_NumPolyobjs);
+				memset (&scratch->PolyMarks[0], 0, po_NumPolyobjs * sizeof(int));
+			}
+		}
+		SightPrepassSlices = MIN<int> (SightPrepass.Size(), threads * 4);
+		ThreadPool.Run (P_TraceSightPrepass, NULL, SightPrepassSlices);
+		PrepassCounts[0] = SightPrepass.Size();
+		SightPrepassActive = true;
+		SightChecksCached = true;
+	}
+
+	PrepassCycles.Unclock();
+}
+
+static int PVSRejects;
+
+//==========================================================================
+//
+// P_InvalidateSightChecks
+//
+// Anything that may change what can be seen through must call this.
+// It throws away the prepass results.
+//
+//==========================================================================
+
+void P_InvalidateSightChecks ()
+{
+	if (!SightChecksCached)
+	{
+		return;
+	}
+	SightChecksCached = false;
+	SightPrepassActive = false;
+}
+
+ADD_STAT (sightprepass)
+{
+	FString out;
+	out.Format ("%d traced in %04.1f ms, %d used, %d stale, %d mismatched",
+		PrepassCounts[0], PrepassCycles.TimeMS(), PrepassCounts[1], PrepassCounts[2], PrepassCounts[3]);
+	return out;
+}
+
 /*
 =====================
 =
@@ -655,6 +999,7 @@ bool P_CheckSight (const AActor *t1, const AActor *t2, int flags)
 	SightCycles.Clock();
 
 	bool res;
+	FSightPrepass *verify = NULL;
 
 	assert (t1 != NULL);
 	assert (t2 != NULL);
@@ -713,26 +1058,110 @@ sightcounts[0]++;
 		}
 	}
 
+	// The PVS is checked after the random number above, so that demos
+	// play the same whether it is in use or not.
+	if (pvsmatrix != NULL && (pvsmatrix[pnum>>3] & (1 << (pnum & 7))))
+	{
+		PVSRejects++;
+		if (!p_sightverify)
+		{
+			res = false;
+			goto done;
+		}
+		validcount++;
+		SightCheck s(t1, t2, flags);
+		if (s.P_SightPathTraverse (t1->x, t1->y, t2->x, t2->y))
+		{
+			Printf ("PVS mismatch: %s at (%d,%d) can see %s at (%d,%d)\n",
+				t1->GetClass()->TypeName.GetChars(), t1->x >> FRACBITS, t1->y >> FRACBITS,
+				t2->GetClass()->TypeName.GetChars(), t2->x >> FRACBITS, t2->y >> FRACBITS);
+		}
+	}
+
 	// An unobstructed LOS is possible.
 	// Now look from eyes of t1 to any part of t2.
 
+	if (SightPrepassActive)
+	{
+		FSightPrepass *pre = P_FindSightPrepass (t1, t2, flags);
+		if (pre != NULL)
+		{
+			if (!pre->IsCurrent (t1, t2))
+			{
+				PrepassCounts[2]++;
+			}
+			else if (!p_sightverify && !SightCheckDemo)
+			{
+				PrepassCounts[1]++;
+				res = pre->Result;
+				goto done;
+			}
+			else
+			{
+				verify = pre;
+			}
+		}
+	}
+
 	validcount++;
 	{
 		SightCheck s(t1, t2, flags);
 		res = s.P_SightPathTraverse (t1->x, t1->y, t2->x, t2->y);
 	}
 
+	if (verify != NULL)
+	{
+		PrepassCounts[1]++;
+		SightCheckTotals[0]++;
+		if (res != verify->Result)
+		{
+			PrepassCounts[3]++;
+			SightCheckTotals[1]++;
+			Printf ("Sight prepass mismatch: %s at (%d,%d) to %s at (%d,%d)\n",
+				t1->GetClass()->TypeName.GetChars(), t1->x >> FRACBITS, t1->y >> FRACBITS,
+				t2->GetClass()->TypeName.GetChars(), t2->x >> FRACBITS, t2->y >> FRACBITS);
+		}
+	}
+
 done:
 	SightCycles.Unclock();
 	return res;
 }
 
+//==========================================================================
+//
+// P_StartSightCheck / P_FinishSightCheck
+//
+// Turn on -sightcheck and report its results when the demo is over.
+// Returns false if any prepass result did not match.
+//
+//==========================================================================
+
+void P_StartSightCheck ()
+{
+	SightCheckDemo = true;
+	SightCheckTotals[0] = SightCheckTotals[1] = 0;
+}
+
+bool P_FinishSightCheck ()
+{
+	if (!SightCheckDemo)
+	{
+		return true;
+	}
+	SightCheckDemo = false;
+	Printf ("Sight check: %d prepass results compared, %d mismatched\n",
+		SightCheckTotals[0], SightCheckTotals[1]);
+	return SightCheckTotals[1] == 0;
+}
+
 ADD_STAT (sight)
 {
 	FString out;
-	out.Format ("%04.1f ms (%04.1f max), %5d %2d%4d%4d%4d%4d\n",
+	out.Format ("%04.1f ms (%04.1f max), %5d %2d%4d%4d%4d%4d, pvs %d\n",
 		SightCycles.TimeMS(), MaxSightCycles.TimeMS(),
-		sightcounts[3], sightcounts[0], sightcounts[1], sightcounts[2], sightcounts[4], sightcounts[5]);
+		sightcounts[3], sightcounts[0], sightcounts[1], sightcounts[2], sightcounts[4], sightcounts[5],
+		PVSRejects);
 	return out;
 }
 
@@ -748,6 +1177,11 @@ void P_ResetSightCounters (bool full)
 	}
 	SightCycles.Reset();
 	memset (sightcounts, 0, sizeof(sightcounts));
+	PVSRejects = 0;
+
+	// Prepass results only last for one tic. This is also called when a
+	// level is loaded, before the old sector pointers could be reused.
+	P_InvalidateSightChecks ();
 }
 
 
@@ -250,6 +250,7 @@ bool P_ActivateLine (line_t *line, AActor *mo, int side, int activationType)
 	if (!repeat && buttonSuccess)
 	{ // clear the special on non-retriggerable lines
 		line->special = 0;
+		P_InvalidateSightChecks ();
 	}
 
 	if (buttonSuccess)
@@ -271,6 +272,7 @@ bool P_ActivateLine (line_t *line, AActor *mo, int side, int activationType)
 	{
 		P_ChangeSwitchTexture (line->sidedef[0], repeat, special);
 		line->special = 0;
+		P_InvalidateSightChecks ();
 	}
 // end of changed code
 	if (developer && buttonSuccess)
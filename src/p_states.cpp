@@ -39,6 +39,8 @@
 #include "cmdlib.h"
 #include "i_system.h"
 #include "c_dispatch.h"
+#include "doomstat.h"
+#include "stats.h"
 #include "thingdef/thingdef.h"
 
 // Each state is owned by an actor. Actors can own any number of
@@ -53,6 +55,21 @@
 
 #define NULL_STATE_INDEX	127
 
+// Every actor's states are one contiguous block, so the owner of a state
+// can be found by binary searching the blocks sorted by address. The index
+// is rebuilt lazily whenever a block is added or the class list changes.
+
+struct FStateOwnerRange
+{
+	const FState *First;
+	const FState *End;
+	const PClass *Owner;
+};
+
+static TArray<FStateOwnerRange> StateOwnerIndex;
+static unsigned int StateOwnerIndexActors;
+static bool StateOwnerIndexValid;
+
 //==========================================================================
 //
 //
@@ -121,7 +138,69 @@ FArchive &operator<< (FArchive &arc, FState *&state)
 //
 //==========================================================================
 
+static int STACK_ARGS SortStateOwners (const void *a, const void *b)
+{
+	const FState *sa = ((const FStateOwnerRange *)a)->First;
+	const FState *sb = ((const FStateOwnerRange *)b)->First;
+	return sa < sb ? -1 : sa > sb ? 1 : 0;
+}
+
+void FState::StaticBuildOwnerIndex ()
+{
+	StateOwnerIndex.Clear();
+	for (unsigned int i = 0; i < PClass::m_RuntimeActors.Size(); ++i)
+	{
+		FActorInfo *info = PClass::m_RuntimeActors[i]->ActorInfo;
+		if (info->OwnedStates != NULL && info->NumOwnedStates > 0)
+		{
+			FStateOwnerRange range = { info->OwnedStates, info->OwnedStates + info->NumOwnedStates, info->Class };
+			StateOwnerIndex.Push(range);
+		}
+	}
+	if (StateOwnerIndex.Size() > 1)
+	{
+		qsort(&StateOwnerIndex[0], StateOwnerIndex.Size(), sizeof(FStateOwnerRange), SortStateOwners);
+	}
+	StateOwnerIndex.ShrinkToFit();
+	StateOwnerIndexActors = PClass::m_RuntimeActors.Size();
+	StateOwnerIndexValid = true;
+}
+
 const PClass *FState::StaticFindStateOwner (const FState *state)
+{
+	if (!StateOwnerIndexValid || StateOwnerIndexActors != PClass::m_RuntimeActors.Size())
+	{
+		StaticBuildOwnerIndex();
+	}
+
+	// Find the last block that starts at or before the state.
+	unsigned int lo = 0, hi = StateOwnerIndex.Size();
+	while (lo < hi)
+	{
+		unsigned int mid = (lo + hi) / 2;
+		if (StateOwnerIndex[mid].First <= state)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+	if (lo > 0 && state < StateOwnerIndex[lo - 1].End)
+	{
+		return StateOwnerIndex[lo - 1].Owner;
+	}
+	return NULL;
+}
+
+//==========================================================================
+//
+// The original linear search, kept for stateownerbench.
+//
+//==========================================================================
+
+static const PClass *FindStateOwnerLinear (const FState *state)
 {
 	for (unsigned int i = 0; i < PClass::m_RuntimeActors.Size(); ++i)
 	{
@@ -908,6 +987,7 @@ int FStateDefinitions::FinishStates (FActorInfo *actor, AActor *defaults)
 		memcpy(realstates, &StateArray[0], count*sizeof(FState));
 		actor->OwnedStates = realstates;
 		actor->NumOwnedStates = count;
+		StateOwnerIndexValid = false;
 
 		// adjust the state pointers
 		// In the case new states are added these must be adjusted, too!
@@ -993,3 +1073,80 @@ CCMD(dumpstates)
 		Printf(PRINT_LOG, "----------------------------\n");
 	}
 }
+
+//==========================================================================
+//
+// CCMD stateownerbench
+//
+// Times owner lookups for every state of every actor class, which is what
+// archiving a level of a large mod boils down to, with both the sorted
+// index and the old linear search.
+//
+//==========================================================================
+
+CCMD(stateownerbench)
+{
+	int runs = argv.argc() > 1 ? atoi(argv[1]) : 10;
+	TArray<const FState *> states;
+	cycle_t indexed, linear;
+	unsigned int i, found = 0, mismatches = 0;
+	int run;
+
+	if (runs < 1) runs = 1;
+
+	for (i = 0; i < PClass::m_RuntimeActors.Size(); ++i)
+	{
+		FActorInfo *info = PClass::m_RuntimeActors[i]->ActorInfo;
+		for (int j = 0; j < info->NumOwnedStates; ++j)
+		{
+			states.Push(info->OwnedStates + j);
+		}
+	}
+	if (gamestate == GS_LEVEL)
+	{
+		TThinkerIterator<AActor> it;
+		AActor *mo;
+		while ((mo = it.Next()) != NULL)
+		{
+			states.Push(mo->state);
+		}
+	}
+
+	indexed.Reset();
+	indexed.Clock();
+	for (run = 0; run < runs; ++run)
+	{
+		for (i = 0; i < states.Size(); ++i)
+		{
+			if (FState::StaticFindStateOwner(states[i]) != NULL) found++;
+		}
+	}
+	indexed.Unclock();
+
+	linear.Reset();
+	linear.Clock();
+	for (run = 0; run < runs; ++run)
+	{
+		for (i = 0; i < states.Size(); ++i)
+		{
+			if (FindStateOwnerLinear(states[i]) != NULL) found--;
+		}
+	}
+	linear.Unclock();
+
+	for (i = 0; i < states.Size(); ++i)
+	{
+		if (FState::StaticFindStateOwner(states[i]) != FindStateOwnerLinear(states[i]))
+		{
+			mismatches++;
+		}
+	}
+
+	Printf("%u classes, %u blocks, %u lookups x %d runs\n",
+		PClass::m_RuntimeActors.Size(), StateOwnerIndex.Size(), states.Size(), runs);
+	Printf("indexed: %.3f ms, linear: %.3f ms\n", indexed.TimeMS(), linear.TimeMS());
+	if (mismatches != 0 || found != 0)
+	{
+		Printf("%u lookups disagree\n", mismatches);
+	}
+}
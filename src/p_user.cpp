@@ -65,6 +65,7 @@ CVAR (Bool, cl_noprediction, false, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
 static player_t PredictionPlayerBackup;
 static BYTE PredictionActorBackup[sizeof(AActor)];
 static TArray<sector_t *> PredictionTouchingSectorsBackup;
+static TArray<int> PredictionActorCellsBackup;
 
 // [GRB] Custom player classes
 TArray<FPlayerClass> PlayerClasses;
@@ -2552,6 +2553,10 @@ void P_PredictPlayer (player_t *player)
 
 	// Blockmap ordering also needs to stay the same, so unlink the block nodes
 	// without releasing them. (They will be used again in P_UnpredictPlayer).
+	if (act->BlockW != 0)
+	{
+		P_DetachActorCells (act, PredictionActorCellsBackup);
+	}
 	FBlockNode *block = act->BlockNode;
 
 	while (block != NULL)
@@ -2608,6 +2613,11 @@ void P_UnPredictPlayer ()
 		act->LinkToWorld ();
 		act->flags &= ~MF_NOBLOCKMAP;
 
+		if (act->BlockW != 0)
+		{
+			P_ReattachActorCells (act, PredictionActorCellsBackup);
+		}
+
 		// Now fix the pointers in the blocknode chain
 		FBlockNode *block = act->BlockNode;
 
@@ -0,0 +1,326 @@
+/*
+** r_benchmark.cpp
+**
+**---------------------------------------------------------------------------
+** Copyright 2012 The ZDoom Team
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+
+// Renders a list of fixed viewpoints into an offscreen canvas and reports
+// how long each one took, broken down by the renderer's cycle counters.
+//
+// A viewpoint file contains one viewpoint per line:
+//
+//		<map> <x> <y> <z> <angle>
+//
+// Coordinates are in map units and the angle is in degrees. Lines starting
+// with // are comments. Viewpoints for the same map should be kept together
+// so each map is only loaded once.
+//
+// Use the benchviews console command, or start with
+// -benchviews <file> [-benchout <file.json>] to run the benchmark right away
+// and quit once it is done. Combine that with -nodraw and -nosound for
+// unattended runs.
+
+// HEADER FILES ------------------------------------------------------------
+
+#include <stdio.h>
+
+#include "doomtype.h"
+#include "doomdef.h"
+#include "doomstat.h"
+#include "d_event.h"
+#include "g_level.h"
+#include "p_setup.h"
+#include "r_local.h"
+#include "r_utility.h"
+#include "v_video.h"
+#include "c_cvars.h"
+#include "c_dispatch.h"
+#include "sc_man.h"
+#include "stats.h"
+#include "m_argv.h"
+#include "i_system.h"
+#include "cmdlib.h"
+
+// TYPES -------------------------------------------------------------------
+
+struct FBenchView
+{
+	FString Map;
+	double X, Y, Z;
+	double Angle;
+
+	double FrameMS, WallMS, PlaneMS, MaskedMS, WallScanMS;
+};
+
+// EXTERNAL DATA DECLARATIONS ----------------------------------------------
+
+extern cycle_t WallCycles, PlaneCycles, MaskedCycles, WallScanCycles;
+
+// PUBLIC DATA DEFINITIONS -------------------------------------------------
+
+CVAR (Int, r_benchwidth, 640, 0)
+CVAR (Int, r_benchheight, 480, 0)
+CVAR (Int, r_benchframes, 20, 0)
+
+// PRIVATE DATA DEFINITIONS ------------------------------------------------
+
+static TArray<FBenchView> BenchViews;
+static FString BenchOutput;
+static unsigned int BenchCurrent;
+static bool BenchRunning;
+static bool BenchWaitingForMap;
+static bool BenchQuit;
+
+// CODE --------------------------------------------------------------------
+
+//==========================================================================
+//
+// R_StartBenchViews
+//
+// Reads the viewpoint file and starts the benchmark. The viewpoints are
+// rendered by R_BenchViewsTicker once their maps are loaded.
+//
+//==========================================================================
+
+bool R_StartBenchViews (const char *viewfile, const char *outfile, bool quit)
+{
+	FScanner sc;
+
+	if (BenchRunning)
+	{
+		Printf ("A view benchmark is already running.\n");
+		return false;
+	}
+
+	if (!FileExists (viewfile))
+	{
+		Printf ("Could not find %s\n", viewfile);
+		return false;
+	}
+	BenchViews.Clear();
+	sc.OpenFile (viewfile);
+	while (sc.GetString())
+	{
+		FBenchView view;
+
+		view.Map = sc.String;
+		sc.MustGetFloat(); view.X = sc.Float;
+		sc.MustGetFloat(); view.Y = sc.Float;
+		sc.MustGetFloat(); view.Z = sc.Float;
+		sc.MustGetFloat(); view.Angle = sc.Float;
+		if (!P_CheckMapData (view.Map))
+		{
+			sc.ScriptMessage ("Map %s does not exist\n", view.Map.GetChars());
+			continue;
+		}
+		view.FrameMS = view.WallMS = view.PlaneMS = view.MaskedMS = view.WallScanMS = 0;
+		BenchViews.Push (view);
+	}
+	if (BenchViews.Size() == 0)
+	{
+		Printf ("%s does not contain any viewpoints.\n", viewfile);
+		return false;
+	}
+
+	BenchOutput = outfile != NULL ? outfile : "";
+	BenchCurrent = 0;
+	BenchRunning = true;
+	BenchWaitingForMap = false;
+	BenchQuit = quit;
+	Printf ("Benchmarking %u viewpoints at %dx%d, %d frames each\n",
+		BenchViews.Size(), *r_benchwidth, *r_benchheight, *r_benchframes);
+	return true;
+}
+
+//==========================================================================
+//
+// RenderBenchView
+//
+// Renders one viewpoint repeatedly and averages the cycle counters. The
+// first frame is not counted, because it is the one that loads the
+// textures.
+//
+//==========================================================================
+
+static void RenderBenchView (FBenchView &view, DCanvas *canvas)
+{
+	int frames = MAX<int> (1, r_benchframes);
+	bool savednointerpolate = r_NoInterpolate;
+	AActor *camera;
+	cycle_t frame;
+
+	camera = Spawn (NAME_MapSpot, FLOAT2FIXED(view.X), FLOAT2FIXED(view.Y), FLOAT2FIXED(view.Z), NO_REPLACE);
+	camera->angle = angle_t(view.Angle * ANGLE_90 / 90);
+	camera->pitch = 0;
+	r_NoInterpolate = true;
+
+	for (int i = -1; i < frames; ++i)
+	{
+		frame.Reset();
+		frame.Clock();
+		R_RenderViewToCanvas (camera, canvas, 0, 0, canvas->GetWidth(), canvas->GetHeight());
+		frame.Unclock();
+		if (i >= 0)
+		{
+			view.FrameMS += frame.TimeMS();
+			view.WallMS += WallCycles.TimeMS();
+			view.PlaneMS += PlaneCycles.TimeMS();
+			view.MaskedMS += MaskedCycles.TimeMS();
+			view.WallScanMS += WallScanCycles.TimeMS();
+		}
+	}
+	view.FrameMS /= frames;
+	view.WallMS /= frames;
+	view.PlaneMS /= frames;
+	view.MaskedMS /= frames;
+	view.WallScanMS /= frames;
+
+	r_NoInterpolate = savednointerpolate;
+	camera->Destroy();
+
+	Printf ("%-8s %8.0f %8.0f %6.0f %4.0f: frame=%.2f ms walls=%.2f ms planes=%.2f ms masked=%.2f ms\n",
+		view.Map.GetChars(), view.X, view.Y, view.Z, view.Angle,
+		view.FrameMS, view.WallMS, view.PlaneMS, view.MaskedMS);
+}
+
+//==========================================================================
+//
+// WriteBenchResults
+//
+//==========================================================================
+
+static void WriteBenchResults ()
+{
+	FString json;
+
+	json.Format ("{\n\t\"width\": %d,\n\t\"height\": %d,\n\t\"frames\": %d,\n\t\"views\": [\n",
+		*r_benchwidth, *r_benchheight, MAX<int> (1, r_benchframes));
+	for (unsigned int i = 0; i < BenchViews.Size(); ++i)
+	{
+		const FBenchView &view = BenchViews[i];
+		json.AppendFormat ("\t\t{ \"map\": \"%s\", \"x\": %g, \"y\": %g, \"z\": %g, \"angle\": %g, "
+			"\"frame_ms\": %.4f, \"wall_ms\": %.4f, \"plane_ms\": %.4f, \"masked_ms\": %.4f, \"wallscan_ms\": %.4f }%s\n",
+			view.Map.GetChars(), view.X, view.Y, view.Z, view.Angle,
+			view.FrameMS, view.WallMS, view.PlaneMS, view.MaskedMS, view.WallScanMS,
+			i + 1 < BenchViews.Size() ? "," : "");
+	}
+	json += "\t]\n}\n";
+
+	if (BenchOutput.IsEmpty())
+	{
+		Printf ("%s", json.GetChars());
+		return;
+	}
+
+	FILE *f = fopen (BenchOutput, "w");
+	if (f == NULL)
+	{
+		Printf ("Could not write %s\n", BenchOutput.GetChars());
+		return;
+	}
+	fputs (json, f);
+	fclose (f);
+	Printf ("Wrote %s\n", BenchOutput.GetChars());
+}
+
+//==========================================================================
+//
+// R_BenchViewsTicker
+//
+// Called once per frame from the main loop. Loads the map for the next
+// viewpoint if necessary, then renders every viewpoint that is on the
+// current map.
+//
+//==========================================================================
+
+void R_BenchViewsTicker ()
+{
+	if (!BenchRunning || gameaction != ga_nothing)
+	{
+		return;
+	}
+
+	FBenchView &view = BenchViews[BenchCurrent];
+
+	if (gamestate != GS_LEVEL || view.Map.CompareNoCase (level.mapname) != 0)
+	{
+		if (!BenchWaitingForMap)
+		{
+			BenchWaitingForMap = true;
+			G_DeferedInitNew (view.Map);
+		}
+		else if (gamestate == GS_LEVEL)
+		{ // The map was loaded but something else got in the way.
+			Printf ("Could not enter %s\n", view.Map.GetChars());
+			BenchRunning = false;
+		}
+		return;
+	}
+	BenchWaitingForMap = false;
+
+	DSimpleCanvas *canvas = new DSimpleCanvas (clamp<int> (r_benchwidth, 320, MAXWIDTH), clamp<int> (r_benchheight, 200, MAXHEIGHT));
+	canvas->ObjectFlags |= OF_Fixed;
+	canvas->Lock();
+	for (; BenchCurrent < BenchViews.Size() && BenchViews[BenchCurrent].Map.CompareNoCase (level.mapname) == 0; ++BenchCurrent)
+	{
+		RenderBenchView (BenchViews[BenchCurrent], canvas);
+	}
+	canvas->Unlock();
+	canvas->Destroy();
+	canvas->ObjectFlags |= OF_YesReallyDelete;
+	delete canvas;
+
+	if (BenchCurrent >= BenchViews.Size())
+	{
+		BenchRunning = false;
+		WriteBenchResults ();
+		if (BenchQuit)
+		{
+			exit (0);
+		}
+	}
+}
+
+//==========================================================================
+//
+// CCMD benchviews
+//
+//==========================================================================
+
+CCMD (benchviews)
+{
+	if (argv.argc() < 2)
+	{
+		Printf ("Usage: benchviews <viewpoint file> [output file]\n");
+		return;
+	}
+	R_StartBenchViews (argv[1], argv.argc() > 2 ? argv[2] : NULL, false);
+}
@@ -58,11 +58,11 @@
 
 int WallMost (short *mostbuf, const secplane_t &plane);
 
-seg_t*			curline;
+COLUMN_TLS seg_t*	curline;
 side_t* 		sidedef;
 line_t* 		linedef;
-sector_t*		frontsector;
-sector_t*		backsector;
+COLUMN_TLS sector_t*	frontsector;
+COLUMN_TLS sector_t*	backsector;
 
 // killough 4/7/98: indicates doors closed wrt automap bugfix:
 int				doorclosed;
@@ -70,13 +70,14 @@ int				doorclosed;
 bool			r_fakingunderwater;
 
 extern bool		rw_prepped;
+extern bool		rw_markmirror;
 extern bool		rw_havehigh, rw_havelow;
 extern int		rw_floorstat, rw_ceilstat;
 extern bool		rw_mustmarkfloor, rw_mustmarkceiling;
 extern short	walltop[MAXWIDTH];	// [RH] record max extents of wall
 extern short	wallbottom[MAXWIDTH];
-extern short	wallupper[MAXWIDTH];
-extern short	walllower[MAXWIDTH];
+extern COLUMN_TLS short	wallupper[MAXWIDTH];
+extern COLUMN_TLS short	walllower[MAXWIDTH];
 
 fixed_t			rw_backcz1, rw_backcz2;
 fixed_t			rw_backfz1, rw_backfz2;
@@ -98,14 +99,14 @@ fixed_t			WallTY1, WallTY2;	// y coords at left, right of wall in view space
 fixed_t			WallCX1, WallCX2;	// x coords at left, right of wall in camera space
 fixed_t			WallCY1, WallCY2;	// y coords at left, right of wall in camera space
 
-int				WallSX1, WallSX2;	// x coords at left, right of wall in screen space
-fixed_t			WallSZ1, WallSZ2;	// depth at left, right of wall in screen space
+COLUMN_TLS int		WallSX1, WallSX2;	// x coords at left, right of wall in screen space
+COLUMN_TLS fixed_t	WallSZ1, WallSZ2;	// depth at left, right of wall in screen space
 
 float			WallDepthOrg, WallDepthScale;
 float			WallUoverZorg, WallUoverZstep;
 float			WallInvZorg, WallInvZstep;
 
-static BYTE		FakeSide;
+static COLUMN_TLS BYTE	FakeSide;
 
 int WindowLeft, WindowRight;
 WORD MirrorFlags;
@@ -156,6 +157,30 @@ struct cliprange_t
 static cliprange_t     *newend;
 static cliprange_t		solidsegs[MAXWIDTH/2+2];
 
+// Farthest depth of the solid wall that closed each column, and the range
+// of columns the clip list was started with. Only columns covered by
+// solidsegs inside that range hold valid depths.
+static fixed_t			OccluderDepth[MAXWIDTH];
+static int				ClipLeft, ClipRight;
+
+//==========================================================================
+//
+// R_MarkOccluder
+//
+// Records the depth of the current wall for columns it has just closed.
+// Mirrors are drawn later as portals, so they never hide anything here.
+//
+//==========================================================================
+
+static void R_MarkOccluder (int first, int last)
+{
+	fixed_t depth = rw_markmirror ? FIXED_MAX : MAX (WallSZ1, WallSZ2);
+
+	for (int x = first; x < last; ++x)
+	{
+		OccluderDepth[x] = depth;
+	}
+}
 
 
 //==========================================================================
@@ -174,6 +199,7 @@ bool R_ClipWallSegment (int first, int last, bool solid)
 	cliprange_t *next, *start;
 	int i, j;
 	bool res = false;
+	bool occlude = solid && !(fake3D & FAKE3D_FAKEMASK);
 
 	// Find the first range that touches the range
 	// (adjacent pixels are touching).
@@ -196,6 +222,7 @@ bool R_ClipWallSegment (int first, int last, bool solid)
 			// Insert a new clippost for solid walls.
 			if (solid)
 			{
+				R_MarkOccluder (first, last);
 				if (last == start->first)
 				{
 					start->first = first;
@@ -220,8 +247,9 @@ bool R_ClipWallSegment (int first, int last, bool solid)
 		R_StoreWallRange (first, start->first);
 
 		// Adjust the clip size for solid walls
-		if (solid && !(fake3D & FAKE3D_FAKEMASK))
+		if (occlude)
 		{
+			R_MarkOccluder (first, start->first);
 			start->first = first;
 		}
 	}
@@ -235,6 +263,10 @@ bool R_ClipWallSegment (int first, int last, bool solid)
 	{
 		// There is a fragment between two posts.
 		R_StoreWallRange (next->last, (next+1)->first);
+		if (occlude)
+		{
+			R_MarkOccluder (next->last, (next+1)->first);
+		}
 		next++;
 		
 		if (last <= next->last)
@@ -247,6 +279,10 @@ bool R_ClipWallSegment (int first, int last, bool solid)
 
 	// There is a fragment after *next.
 	R_StoreWallRange (next->last, last);
+	if (occlude)
+	{
+		R_MarkOccluder (next->last, last);
+	}
 
 crunch:
 	if (fake3D & FAKE3D_FAKEMASK)
@@ -296,6 +332,44 @@ bool R_CheckClipWallSegment (int first, int last)
 	return false;
 }
 
+//==========================================================================
+//
+// R_CheckSpriteOccluded
+//
+// Returns true if columns x1 through x2 are all closed by solid walls that
+// lie entirely in front of the given depth. R_DrawSprite would clip such a
+// sprite away completely, so it need not be projected at all.
+//
+//==========================================================================
+
+bool R_CheckSpriteOccluded (int x1, int x2, fixed_t depth)
+{
+	cliprange_t *start;
+
+	if (x1 < ClipLeft || x2 >= ClipRight)
+	{
+		return false;
+	}
+
+	start = solidsegs;
+	while (start->last <= x1)
+		start++;
+
+	if (start->first > x1 || start->last <= x2)
+	{
+		return false;
+	}
+
+	for (int x = x1; x <= x2; ++x)
+	{
+		if (OccluderDepth[x] >= depth)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
 
 
 //
@@ -303,6 +377,8 @@ bool R_CheckClipWallSegment (int first, int last)
 //
 void R_ClearClipSegs (short left, short right)
 {
+	ClipLeft = left;
+	ClipRight = right;
 	solidsegs[0].first = -0x7fff;	// new short limit --  killough
 	solidsegs[0].last = left;
 	solidsegs[1].first = right;
@@ -62,11 +62,11 @@ struct drawseg_t
 };
 
 
-extern seg_t*		curline;
+extern COLUMN_TLS seg_t*	curline;
 extern side_t*		sidedef;
 extern line_t*		linedef;
-extern sector_t*	frontsector;
-extern sector_t*	backsector;
+extern COLUMN_TLS sector_t*	frontsector;
+extern COLUMN_TLS sector_t*	backsector;
 
 extern drawseg_t	*drawsegs;
 extern drawseg_t	*firstdrawseg;
@@ -87,6 +87,7 @@ EXTERN_CVAR (Bool, r_drawflat)		// [RH] Don't texture segs?
 
 // BSP?
 void R_ClearClipSegs (short left, short right);
+bool R_CheckSpriteOccluded (int x1, int x2, fixed_t depth);
 void R_ClearDrawSegs ();
 void R_RenderBSPNode (void *node);
 
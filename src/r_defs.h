@@ -26,6 +26,7 @@
 #include "doomdef.h"
 #include "templates.h"
 #include "memarena.h"
+#include "threadpool.h"
 
 // Some more or less basic data types
 // we depend on.
@@ -41,6 +42,28 @@
 #define MAXWIDTH 5760
 #define MAXHEIGHT 3600
 
+// Drawer state that every render thread needs its own copy of. The ia32
+// assembly drawers address these variables directly, so they must stay
+// ordinary globals when that code is in use, and rendering stays on a
+// single thread.
+#ifdef X86_ASM
+#define RENDER_TLS
+#else
+#define RENDER_TLS THREAD_LOCAL
+#define RENDER_THREADS
+#endif
+
+// The column drawer state gets one copy per thread wherever the ia32
+// drawers are not used; the amd64 wall drawer is handed its own copy by
+// vlinetallasm4c. Drawing sprites and masked mid textures on several
+// threads depends on it.
+#if defined(RENDER_THREADS)
+#define COLUMN_TLS THREAD_LOCAL
+#define COLUMN_THREADS
+#else
+#define COLUMN_TLS
+#endif
+
 const WORD NO_INDEX = 0xffffu;
 const DWORD NO_SIDE = 0xffffffffu;
 
@@ -82,6 +82,10 @@ void (*R_DrawSpanMaskedTranslucent)(void);
 void (*R_DrawSpanAddClamp)(void);
 void (*R_DrawSpanMaskedAddClamp)(void);
 void (STACK_ARGS *rt_map4cols)(int,int,int);
+#ifndef X86_ASM
+void (STACK_ARGS *rt_add4cols)(int,int,int);
+void (STACK_ARGS *rt_addclamp4cols)(int,int,int);
+#endif
 
 //
 // R_DrawColumn
@@ -90,35 +94,35 @@ void (STACK_ARGS *rt_map4cols)(int,int,int);
 extern "C" {
 int				dc_pitch=0xABadCafe;	// [RH] Distance between rows
 
-lighttable_t*	dc_colormap; 
-int 			dc_x; 
-int 			dc_yl; 
-int 			dc_yh; 
-fixed_t 		dc_iscale; 
-fixed_t 		dc_texturemid;
-fixed_t			dc_texturefrac;
-int				dc_color;				// [RH] Color for column filler
-DWORD			dc_srccolor;
-DWORD			*dc_srcblend;			// [RH] Source and destination
-DWORD			*dc_destblend;			// blending lookups
+COLUMN_TLS lighttable_t*	dc_colormap; 
+COLUMN_TLS int 			dc_x; 
+COLUMN_TLS int 			dc_yl; 
+COLUMN_TLS int 			dc_yh; 
+COLUMN_TLS fixed_t 		dc_iscale; 
+COLUMN_TLS fixed_t 		dc_texturemid;
+COLUMN_TLS fixed_t		dc_texturefrac;
+COLUMN_TLS int			dc_color;				// [RH] Color for column filler
+COLUMN_TLS DWORD		dc_srccolor;
+COLUMN_TLS DWORD		*dc_srcblend;			// [RH] Source and destination
+COLUMN_TLS DWORD		*dc_destblend;			// blending lookups
 
 // first pixel in a column (possibly virtual) 
-const BYTE*		dc_source;				
+COLUMN_TLS const BYTE*	dc_source;				
 
-BYTE*			dc_dest;
-int				dc_count;
+COLUMN_TLS BYTE*		dc_dest;
+COLUMN_TLS int			dc_count;
 
-DWORD			vplce[4];
-DWORD			vince[4];
-BYTE*			palookupoffse[4];
-const BYTE*		bufplce[4];
+COLUMN_TLS DWORD		vplce[4];
+COLUMN_TLS DWORD		vince[4];
+COLUMN_TLS BYTE*		palookupoffse[4];
+COLUMN_TLS const BYTE*	bufplce[4];
 
 // just for profiling 
-int 			dccount;
+COLUMN_TLS int 			dccount;
 }
 
 int dc_fillcolor;
-BYTE *dc_translation;
+COLUMN_TLS BYTE *dc_translation;
 BYTE shadetables[NUMCOLORMAPS*16*256];
 FDynamicColormap ShadeFakeColormap[16];
 BYTE identitymap[256];
@@ -381,7 +385,7 @@ void R_FillRevSubClampColumn (void)
 extern "C"
 {
 int 	fuzzoffset[FUZZTABLE+1];	// [RH] +1 for the assembly routine
-int 	fuzzpos = 0; 
+COLUMN_TLS int 	fuzzpos = 0; 
 int		fuzzviewheight;
 }
 /*
@@ -962,23 +966,23 @@ void R_DrawRevSubClampTranslatedColumnP_C ()
 // swapped.
 //
 extern "C" {
-int						ds_color;				// [RH] color for non-textured spans
+RENDER_TLS int			ds_color;				// [RH] color for non-textured spans
 
-int 					ds_y;
-int 					ds_x1;
-int 					ds_x2;
+RENDER_TLS int			ds_y;
+RENDER_TLS int			ds_x1;
+RENDER_TLS int			ds_x2;
 
-lighttable_t*			ds_colormap;
+RENDER_TLS lighttable_t*	ds_colormap;
 
-dsfixed_t 				ds_xfrac;
-dsfixed_t 				ds_yfrac;
-dsfixed_t 				ds_xstep;
-dsfixed_t 				ds_ystep;
-int						ds_xbits;
-int						ds_ybits;
+RENDER_TLS dsfixed_t	ds_xfrac;
+RENDER_TLS dsfixed_t	ds_yfrac;
+RENDER_TLS dsfixed_t	ds_xstep;
+RENDER_TLS dsfixed_t	ds_ystep;
+RENDER_TLS int			ds_xbits;
+RENDER_TLS int			ds_ybits;
 
 // start of a floor/ceiling tile image 
-const BYTE*				ds_source;
+RENDER_TLS const BYTE*				ds_source;
 
 // just for profiling
 int 					dscount;
@@ -1192,6 +1196,48 @@ void R_DrawSpanMaskedP_C (void)
 }
 #endif
 
+// Draws a span from a flat stored by FTexture::GetPixelsTiled(). The flat
+// is split into 8x8 tiles of 64 bytes each, so a span that crosses the
+// texture at an angle touches far fewer cache lines than it would with
+// the plain column-major layout.
+void R_DrawSpanTiledP_C (void)
+{
+	dsfixed_t			xfrac;
+	dsfixed_t			yfrac;
+	dsfixed_t			xstep;
+	dsfixed_t			ystep;
+	BYTE*				dest;
+	const BYTE*			source = ds_source;
+	const BYTE*			colormap = ds_colormap;
+	int 				count;
+	int 				spot;
+	DWORD				x, y;
+
+	xfrac = ds_xfrac;
+	yfrac = ds_yfrac;
+
+	dest = ylookup[ds_y] + ds_x1 + dc_destorg;
+
+	count = ds_x2 - ds_x1 + 1;
+
+	xstep = ds_xstep;
+	ystep = ds_ystep;
+
+	BYTE xshift = 32 - ds_xbits;
+	BYTE yshift = 32 - ds_ybits;
+	BYTE colshift = ds_ybits + 3;
+
+	do
+	{
+		x = xfrac >> xshift;
+		y = yfrac >> yshift;
+		spot = ((x >> 3) << colshift) | ((y >> 3) << 6) | ((x & 7) << 3) | (y & 7);
+		*dest++ = colormap[source[spot]];
+		xfrac += xstep;
+		yfrac += ystep;
+	} while (--count);
+}
+
 void R_DrawSpanTranslucentP_C (void)
 {
 	dsfixed_t			xfrac;
@@ -1576,15 +1622,44 @@ extern "C" void STACK_ARGS R_DrawSlabC(int dx, fixed_t v, int dy, fixed_t vi, co
 
 #ifndef X86_ASM
 static DWORD STACK_ARGS vlinec1 ();
-static int vlinebits;
+static COLUMN_TLS int vlinebits;
 
 DWORD (STACK_ARGS *dovline1)() = vlinec1;
 DWORD (STACK_ARGS *doprevline1)() = vlinec1;
 
 #ifdef X64_ASM
-extern "C" void vlinetallasm4();
-#define dovline4 vlinetallasm4
-extern "C" void setupvlinetallasm (int);
+// The amd64 wall drawer reads plain globals and patches its own code, so
+// it cannot see the per-thread column state and must only be called from
+// the main thread. Walls are never drawn anywhere else.
+extern "C"
+{
+void vlinetallasm4();
+void setupvlinetallasm (int);
+DWORD asm_vplce[4];
+DWORD asm_vince[4];
+BYTE *asm_palookupoffse[4];
+const BYTE *asm_bufplce[4];
+int asm_dc_count;
+BYTE *asm_dc_dest;
+}
+
+void vlinetallasm4c ()
+{
+	for (int i = 0; i < 4; ++i)
+	{
+		asm_vplce[i] = vplce[i];
+		asm_vince[i] = vince[i];
+		asm_palookupoffse[i] = palookupoffse[i];
+		asm_bufplce[i] = bufplce[i];
+	}
+	asm_dc_count = dc_count;
+	asm_dc_dest = dc_dest;
+	vlinetallasm4 ();
+	for (int i = 0; i < 4; ++i)
+	{
+		vplce[i] = asm_vplce[i];
+	}
+}
 #else
 static void STACK_ARGS vlinec4 ();
 void (STACK_ARGS *dovline4)() = vlinec4;
@@ -1592,7 +1667,7 @@ void (STACK_ARGS *dovline4)() = vlinec4;
 
 static DWORD STACK_ARGS mvlinec1();
 static void STACK_ARGS mvlinec4();
-static int mvlinebits;
+static COLUMN_TLS int mvlinebits;
 
 DWORD (STACK_ARGS *domvline1)() = mvlinec1;
 void (STACK_ARGS *domvline4)() = mvlinec4;
@@ -1757,10 +1832,10 @@ void STACK_ARGS mvlinec4 ()
 }
 #endif
 
-extern "C" short spanend[MAXHEIGHT];
-extern fixed_t rw_light;
-extern fixed_t rw_lightstep;
-extern int wallshade;
+extern "C" COLUMN_TLS short spanend[MAXHEIGHT];
+extern COLUMN_TLS fixed_t rw_light;
+extern COLUMN_TLS fixed_t rw_lightstep;
+extern COLUMN_TLS int wallshade;
 
 static void R_DrawFogBoundarySection (int y, int y2, int x1)
 {
@@ -1879,7 +1954,7 @@ void R_DrawFogBoundary (int x1, int x2, short *uclip, short *dclip)
 	}
 }
 
-int tmvlinebits;
+COLUMN_TLS int tmvlinebits;
 
 void setuptmvline (int bits)
 {
@@ -2193,11 +2268,23 @@ void R_InitColumnDrawers ()
 	R_DrawSpan					= R_DrawSpanP_C;
 	R_DrawSpanMasked			= R_DrawSpanMaskedP_C;
 	rt_map4cols					= rt_map4cols_c;
+	rt_add4cols					= rt_add4cols_c;
+	rt_addclamp4cols			= rt_addclamp4cols_c;
 #endif
 	R_DrawSpanTranslucent		= R_DrawSpanTranslucentP_C;
 	R_DrawSpanMaskedTranslucent = R_DrawSpanMaskedTranslucentP_C;
 	R_DrawSpanAddClamp			= R_DrawSpanAddClampP_C;
 	R_DrawSpanMaskedAddClamp	= R_DrawSpanMaskedAddClampP_C;
+#ifdef SSE2_DRAWERS
+	if (CPU.bSSE2)
+	{
+		R_DrawSpan				= R_DrawSpanP_SSE2;
+		R_DrawSpanTranslucent	= R_DrawSpanTranslucentP_SSE2;
+		R_DrawSpanAddClamp		= R_DrawSpanAddClampP_SSE2;
+		rt_add4cols				= rt_add4cols_sse2;
+		rt_addclamp4cols		= rt_addclamp4cols_sse2;
+	}
+#endif
 }
 
 // [RH] Choose column drawers in a single place
@@ -2205,7 +2292,7 @@ EXTERN_CVAR (Int, r_drawfuzz)
 EXTERN_CVAR (Bool, r_drawtrans)
 EXTERN_CVAR (Float, transsouls)
 
-static FDynamicColormap *basecolormapsave;
+static COLUMN_TLS FDynamicColormap *basecolormapsave;
 
 static bool R_SetBlendFunc (int op, fixed_t fglevel, fixed_t bglevel, int flags)
 {
@@ -29,33 +29,34 @@ extern "C" int			ylookup[MAXHEIGHT];
 
 extern "C" int			dc_pitch;		// [RH] Distance between rows
 
-extern "C" lighttable_t*dc_colormap;
-extern "C" int			dc_x;
-extern "C" int			dc_yl;
-extern "C" int			dc_yh;
-extern "C" fixed_t		dc_iscale;
-extern "C" fixed_t		dc_texturemid;
-extern "C" fixed_t		dc_texturefrac;
-extern "C" int			dc_color;		// [RH] For flat colors (no texturing)
-extern "C" DWORD		dc_srccolor;
-extern "C" DWORD		*dc_srcblend;
-extern "C" DWORD		*dc_destblend;
+extern "C" COLUMN_TLS lighttable_t*dc_colormap;
+extern "C" COLUMN_TLS int			dc_x;
+extern "C" COLUMN_TLS int			dc_yl;
+extern "C" COLUMN_TLS int			dc_yh;
+extern "C" COLUMN_TLS fixed_t		dc_iscale;
+extern "C" COLUMN_TLS fixed_t		dc_texturemid;
+extern "C" COLUMN_TLS fixed_t		dc_texturefrac;
+extern "C" COLUMN_TLS int			dc_color;		// [RH] For flat colors (no texturing)
+extern "C" COLUMN_TLS DWORD		dc_srccolor;
+extern "C" COLUMN_TLS DWORD		*dc_srcblend;
+extern "C" COLUMN_TLS DWORD		*dc_destblend;
 
 // first pixel in a column
-extern "C" const BYTE*	dc_source;
+extern "C" COLUMN_TLS const BYTE*	dc_source;
 
-extern "C" BYTE			*dc_dest, *dc_destorg;
-extern "C" int			dc_count;
+extern "C" COLUMN_TLS BYTE		*dc_dest;
+extern "C" BYTE			*dc_destorg;
+extern "C" COLUMN_TLS int			dc_count;
 
-extern "C" DWORD		vplce[4];
-extern "C" DWORD		vince[4];
-extern "C" BYTE*		palookupoffse[4];
-extern "C" const BYTE*	bufplce[4];
+extern "C" COLUMN_TLS DWORD		vplce[4];
+extern "C" COLUMN_TLS DWORD		vince[4];
+extern "C" COLUMN_TLS BYTE*		palookupoffse[4];
+extern "C" COLUMN_TLS const BYTE*	bufplce[4];
 
 // [RH] Temporary buffer for column drawing
-extern "C" BYTE			*dc_temp;
-extern "C" unsigned int	dc_tspans[4][MAXHEIGHT];
-extern "C" unsigned int	*dc_ctspan[4];
+extern "C" COLUMN_TLS BYTE			*dc_temp;
+extern "C" COLUMN_TLS unsigned int	dc_tspans[4][MAXHEIGHT];
+extern "C" COLUMN_TLS unsigned int	*dc_ctspan[4];
 extern "C" unsigned int	horizspans[4];
 
 
@@ -68,8 +69,8 @@ extern void (*R_DrawColumn)(void);
 extern DWORD (STACK_ARGS *dovline1) ();
 extern DWORD (STACK_ARGS *doprevline1) ();
 #ifdef X64_ASM
-#define dovline4 vlinetallasm4
-extern "C" void vlinetallasm4();
+#define dovline4 vlinetallasm4c
+extern void vlinetallasm4c();
 #else
 extern void (STACK_ARGS *dovline4) ();
 #endif
@@ -177,8 +178,21 @@ extern void (STACK_ARGS *rt_map4cols)(int sx, int yl, int yh);
 #define rt_copy4cols		rt_copy4cols_c
 #define rt_map1col			rt_map1col_c
 #define rt_shaded4cols		rt_shaded4cols_c
-#define rt_add4cols			rt_add4cols_c
-#define rt_addclamp4cols	rt_addclamp4cols_c
+extern void (STACK_ARGS *rt_add4cols)(int sx, int yl, int yh);
+extern void (STACK_ARGS *rt_addclamp4cols)(int sx, int yl, int yh);
+#endif
+
+// SSE2 versions of some of the C drawers, picked by R_InitColumnDrawers
+// when the CPU supports them. SSE2 is always available to x86-64 compilers.
+#if !defined(X86_ASM) && (defined(__SSE2__) || defined(_M_X64))
+#define SSE2_DRAWERS
+
+void	R_DrawSpanP_SSE2 (void);
+void	R_DrawSpanTranslucentP_SSE2 (void);
+void	R_DrawSpanAddClampP_SSE2 (void);
+
+void STACK_ARGS rt_add4cols_sse2 (int sx, int yl, int yh);
+void STACK_ARGS rt_addclamp4cols_sse2 (int sx, int yl, int yh);
 #endif
 
 void rt_draw4cols (int sx);
@@ -214,6 +228,9 @@ void	R_DrawSpanMaskedP_C (void);
 
 void	R_DrawSpanTranslucentP_C (void);
 void	R_DrawSpanMaskedTranslucentP_C (void);
+void	R_DrawSpanAddClampP_C (void);
+void	R_DrawSpanMaskedAddClampP_C (void);
+void	R_DrawSpanTiledP_C (void);
 
 void	R_DrawTlatedLucentColumnP_C (void);
 #define R_DrawTlatedLucentColumn R_DrawTlatedLucentColumnP_C
@@ -233,29 +250,29 @@ void	R_FillSpan (void);
 extern "C" void			   R_SetupDrawSlab(const BYTE *colormap);
 extern "C" void STACK_ARGS R_DrawSlab(int dx, fixed_t v, int dy, fixed_t vi, const BYTE *vptr, BYTE *p);
 
-extern "C" int				ds_y;
-extern "C" int				ds_x1;
-extern "C" int				ds_x2;
+extern "C" RENDER_TLS int	ds_y;
+extern "C" RENDER_TLS int	ds_x1;
+extern "C" RENDER_TLS int	ds_x2;
 
-extern "C" lighttable_t*	ds_colormap;
+extern "C" RENDER_TLS lighttable_t*	ds_colormap;
 
-extern "C" dsfixed_t		ds_xfrac;
-extern "C" dsfixed_t		ds_yfrac;
-extern "C" dsfixed_t		ds_xstep;
-extern "C" dsfixed_t		ds_ystep;
-extern "C" int				ds_xbits;
-extern "C" int				ds_ybits;
-extern "C" fixed_t			ds_alpha;
+extern "C" RENDER_TLS dsfixed_t	ds_xfrac;
+extern "C" RENDER_TLS dsfixed_t	ds_yfrac;
+extern "C" RENDER_TLS dsfixed_t	ds_xstep;
+extern "C" RENDER_TLS dsfixed_t	ds_ystep;
+extern "C" RENDER_TLS int	ds_xbits;
+extern "C" RENDER_TLS int	ds_ybits;
+extern "C" RENDER_TLS fixed_t	ds_alpha;
 
 // start of a 64*64 tile image
-extern "C" const BYTE*		ds_source;
+extern "C" RENDER_TLS const BYTE*		ds_source;
 
-extern "C" int				ds_color;		// [RH] For flat color (no texturing)
+extern "C" RENDER_TLS int	ds_color;		// [RH] For flat color (no texturing)
 
 extern BYTE shadetables[/*NUMCOLORMAPS*16*256*/];
 extern FDynamicColormap ShadeFakeColormap[16];
 extern BYTE identitymap[256];
-extern BYTE *dc_translation;
+extern COLUMN_TLS BYTE *dc_translation;
 
 // [RH] Added for muliresolution support
 void R_InitShadeMaps();
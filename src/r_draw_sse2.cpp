@@ -0,0 +1,453 @@
+/*
+** r_draw_sse2.cpp
+**
+**---------------------------------------------------------------------------
+** Copyright 2012 The ZDoom Team
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+
+// SSE2 versions of the span drawers and the translucent 4-column drawers.
+// The palette lookups cannot be vectorized, but the texture coordinate
+// stepping and the RGB blending math can be done four pixels at a time.
+// Every function here must produce exactly the same output as its C
+// counterpart; use r_drawertest to check that.
+
+#include "doomtype.h"
+#include "doomdef.h"
+#include "r_local.h"
+#include "v_video.h"
+#include "v_text.h"
+#include "c_dispatch.h"
+#include "m_random.h"
+#include "x86.h"
+
+#ifdef SSE2_DRAWERS
+
+#include <emmintrin.h>
+
+union FSSE2Ints
+{
+	__m128i v;
+	DWORD i[4];
+};
+
+//==========================================================================
+//
+// Helpers
+//
+//==========================================================================
+
+// Computes the flat texture index for four consecutive pixels.
+static inline __m128i SpanSpots (__m128i xfrac, __m128i yfrac, __m128i xshift, __m128i yshift, __m128i xmask)
+{
+	return _mm_add_epi32 (_mm_and_si128 (_mm_srl_epi32 (xfrac, xshift), xmask), _mm_srl_epi32 (yfrac, yshift));
+}
+
+// fg + bg without clamping, as in R_DrawAddColumnP_C.
+static inline __m128i BlendAdd (__m128i fg, __m128i bg)
+{
+	__m128i a = _mm_or_si128 (_mm_add_epi32 (fg, bg), _mm_set1_epi32 (0x1f07c1f));
+	return _mm_and_si128 (a, _mm_srli_epi32 (a, 15));
+}
+
+// fg + bg with clamping, as in R_DrawAddClampColumnP_C.
+static inline __m128i BlendAddClamp (__m128i fg, __m128i bg)
+{
+	__m128i a = _mm_add_epi32 (fg, bg);
+	__m128i b = _mm_and_si128 (a, _mm_set1_epi32 (0x40100400));
+	a = _mm_and_si128 (_mm_or_si128 (a, _mm_set1_epi32 (0x01f07c1f)), _mm_set1_epi32 (0x3fffffff));
+	b = _mm_sub_epi32 (b, _mm_srli_epi32 (b, 5));
+	a = _mm_or_si128 (a, b);
+	return _mm_and_si128 (a, _mm_srli_epi32 (a, 15));
+}
+
+//==========================================================================
+//
+// Span setup shared by all the span drawers
+//
+//==========================================================================
+
+struct FSSE2Span
+{
+	__m128i xfrac, yfrac;
+	__m128i xstep, ystep;
+	__m128i xshift, yshift, xmask;
+	BYTE *dest;
+	int count;
+
+	FSSE2Span ()
+	{
+		int yshiftbits = 32 - ds_ybits;
+		int xshiftbits = yshiftbits - ds_xbits;
+
+		xfrac = _mm_setr_epi32 (ds_xfrac, ds_xfrac + ds_xstep, ds_xfrac + ds_xstep*2, ds_xfrac + ds_xstep*3);
+		yfrac = _mm_setr_epi32 (ds_yfrac, ds_yfrac + ds_ystep, ds_yfrac + ds_ystep*2, ds_yfrac + ds_ystep*3);
+		xstep = _mm_set1_epi32 (ds_xstep * 4);
+		ystep = _mm_set1_epi32 (ds_ystep * 4);
+		xshift = _mm_cvtsi32_si128 (xshiftbits);
+		yshift = _mm_cvtsi32_si128 (yshiftbits);
+		xmask = _mm_set1_epi32 (((1 << ds_xbits) - 1) << ds_ybits);
+		dest = ylookup[ds_y] + ds_x1 + dc_destorg;
+		count = ds_x2 - ds_x1 + 1;
+	}
+
+	// Returns the indices for the next four pixels and steps past them.
+	__m128i Next ()
+	{
+		__m128i spots = SpanSpots (xfrac, yfrac, xshift, yshift, xmask);
+		xfrac = _mm_add_epi32 (xfrac, xstep);
+		yfrac = _mm_add_epi32 (yfrac, ystep);
+		return spots;
+	}
+
+	// Returns the index for the next single pixel and steps past it.
+	DWORD NextOne ()
+	{
+		DWORD x = _mm_cvtsi128_si32 (xfrac);
+		DWORD y = _mm_cvtsi128_si32 (yfrac);
+		xfrac = _mm_srli_si128 (xfrac, 4);
+		yfrac = _mm_srli_si128 (yfrac, 4);
+		return ((x >> _mm_cvtsi128_si32 (xshift)) & _mm_cvtsi128_si32 (xmask)) + (y >> _mm_cvtsi128_si32 (yshift));
+	}
+};
+
+//==========================================================================
+//
+// R_DrawSpanP_SSE2
+//
+//==========================================================================
+
+void R_DrawSpanP_SSE2 (void)
+{
+	const BYTE *source = ds_source;
+	const BYTE *colormap = ds_colormap;
+	FSSE2Span span;
+	BYTE *dest = span.dest;
+	int count = span.count;
+	FSSE2Ints spot;
+
+	for (; count >= 4; count -= 4, dest += 4)
+	{
+		spot.v = span.Next ();
+		dest[0] = colormap[source[spot.i[0]]];
+		dest[1] = colormap[source[spot.i[1]]];
+		dest[2] = colormap[source[spot.i[2]]];
+		dest[3] = colormap[source[spot.i[3]]];
+	}
+	// There are at most three pixels left, which are all still
+	// represented in the stepping vectors.
+	for (; count > 0; --count)
+	{
+		*dest++ = colormap[source[span.NextOne ()]];
+	}
+}
+
+//==========================================================================
+//
+// R_DrawSpanTranslucentP_SSE2
+//
+//==========================================================================
+
+void R_DrawSpanTranslucentP_SSE2 (void)
+{
+	const BYTE *source = ds_source;
+	const BYTE *colormap = ds_colormap;
+	DWORD *fg2rgb = dc_srcblend;
+	DWORD *bg2rgb = dc_destblend;
+	FSSE2Span span;
+	BYTE *dest = span.dest;
+	int count = span.count;
+	FSSE2Ints spot, color;
+
+	for (; count >= 4; count -= 4, dest += 4)
+	{
+		spot.v = span.Next ();
+		color.v = BlendAdd (
+			_mm_setr_epi32 (fg2rgb[colormap[source[spot.i[0]]]], fg2rgb[colormap[source[spot.i[1]]]],
+							fg2rgb[colormap[source[spot.i[2]]]], fg2rgb[colormap[source[spot.i[3]]]]),
+			_mm_setr_epi32 (bg2rgb[dest[0]], bg2rgb[dest[1]], bg2rgb[dest[2]], bg2rgb[dest[3]]));
+		dest[0] = RGB32k[0][0][color.i[0]];
+		dest[1] = RGB32k[0][0][color.i[1]];
+		dest[2] = RGB32k[0][0][color.i[2]];
+		dest[3] = RGB32k[0][0][color.i[3]];
+	}
+	for (; count > 0; --count, ++dest)
+	{
+		DWORD fg = fg2rgb[colormap[source[span.NextOne ()]]];
+		DWORD bg = bg2rgb[*dest];
+		fg = (fg+bg) | 0x1f07c1f;
+		*dest = RGB32k[0][0][fg & (fg>>15)];
+	}
+}
+
+//==========================================================================
+//
+// R_DrawSpanAddClampP_SSE2
+//
+//==========================================================================
+
+void R_DrawSpanAddClampP_SSE2 (void)
+{
+	const BYTE *source = ds_source;
+	const BYTE *colormap = ds_colormap;
+	DWORD *fg2rgb = dc_srcblend;
+	DWORD *bg2rgb = dc_destblend;
+	FSSE2Span span;
+	BYTE *dest = span.dest;
+	int count = span.count;
+	FSSE2Ints spot, color;
+
+	for (; count >= 4; count -= 4, dest += 4)
+	{
+		spot.v = span.Next ();
+		color.v = BlendAddClamp (
+			_mm_setr_epi32 (fg2rgb[colormap[source[spot.i[0]]]], fg2rgb[colormap[source[spot.i[1]]]],
+							fg2rgb[colormap[source[spot.i[2]]]], fg2rgb[colormap[source[spot.i[3]]]]),
+			_mm_setr_epi32 (bg2rgb[dest[0]], bg2rgb[dest[1]], bg2rgb[dest[2]], bg2rgb[dest[3]]));
+		dest[0] = RGB32k[0][0][color.i[0]];
+		dest[1] = RGB32k[0][0][color.i[1]];
+		dest[2] = RGB32k[0][0][color.i[2]];
+		dest[3] = RGB32k[0][0][color.i[3]];
+	}
+	for (; count > 0; --count, ++dest)
+	{
+		DWORD a = fg2rgb[colormap[source[span.NextOne ()]]] + bg2rgb[*dest];
+		DWORD b = a;
+
+		a |= 0x01f07c1f;
+		b &= 0x40100400;
+		a &= 0x3fffffff;
+		b = b - (b >> 5);
+		a |= b;
+		*dest = RGB32k[0][0][a & (a>>15)];
+	}
+}
+
+//==========================================================================
+//
+// rt_add4cols_sse2
+//
+// The four columns of a row are blended together.
+//
+//==========================================================================
+
+void STACK_ARGS rt_add4cols_sse2 (int sx, int yl, int yh)
+{
+	int count = yh-yl;
+	if (count < 0)
+		return;
+	count++;
+
+	DWORD *fg2rgb = dc_srcblend;
+	DWORD *bg2rgb = dc_destblend;
+	BYTE *dest = ylookup[yl] + sx + dc_destorg;
+	const BYTE *source = &dc_temp[yl*4];
+	const BYTE *colormap = dc_colormap;
+	int pitch = dc_pitch;
+	FSSE2Ints color;
+
+	do
+	{
+		color.v = BlendAdd (
+			_mm_setr_epi32 (fg2rgb[colormap[source[0]]], fg2rgb[colormap[source[1]]],
+							fg2rgb[colormap[source[2]]], fg2rgb[colormap[source[3]]]),
+			_mm_setr_epi32 (bg2rgb[dest[0]], bg2rgb[dest[1]], bg2rgb[dest[2]], bg2rgb[dest[3]]));
+		dest[0] = RGB32k[0][0][color.i[0]];
+		dest[1] = RGB32k[0][0][color.i[1]];
+		dest[2] = RGB32k[0][0][color.i[2]];
+		dest[3] = RGB32k[0][0][color.i[3]];
+		source += 4;
+		dest += pitch;
+	} while (--count);
+}
+
+//==========================================================================
+//
+// rt_addclamp4cols_sse2
+//
+//==========================================================================
+
+void STACK_ARGS rt_addclamp4cols_sse2 (int sx, int yl, int yh)
+{
+	int count = yh-yl;
+	if (count < 0)
+		return;
+	count++;
+
+	DWORD *fg2rgb = dc_srcblend;
+	DWORD *bg2rgb = dc_destblend;
+	BYTE *dest = ylookup[yl] + sx + dc_destorg;
+	const BYTE *source = &dc_temp[yl*4];
+	const BYTE *colormap = dc_colormap;
+	int pitch = dc_pitch;
+	FSSE2Ints color;
+
+	do
+	{
+		color.v = BlendAddClamp (
+			_mm_setr_epi32 (fg2rgb[colormap[source[0]]], fg2rgb[colormap[source[1]]],
+							fg2rgb[colormap[source[2]]], fg2rgb[colormap[source[3]]]),
+			_mm_setr_epi32 (bg2rgb[dest[0]], bg2rgb[dest[1]], bg2rgb[dest[2]], bg2rgb[dest[3]]));
+		dest[0] = RGB32k[0][0][color.i[0]];
+		dest[1] = RGB32k[0][0][color.i[1]];
+		dest[2] = RGB32k[0][0][color.i[2]];
+		dest[3] = RGB32k[0][0][color.i[3]];
+		source += 4;
+		dest += pitch;
+	} while (--count);
+}
+
+//==========================================================================
+//
+// CCMD r_drawertest
+//
+// Runs every SSE2 drawer and its C counterpart on the same random input
+// and reports any output that differs.
+//
+//==========================================================================
+
+static FRandom pr_drawertest ("DrawerTest");
+
+enum
+{
+	TEST_PITCH = 512,
+	TEST_ROWS = 64
+};
+
+static BYTE TestSource[256*256];
+static BYTE TestColormap[256];
+static BYTE TestBackground[TEST_PITCH*TEST_ROWS];
+static BYTE TestDest[2][TEST_PITCH*TEST_ROWS];
+static BYTE TestTemp[TEST_ROWS*4];
+
+static void RandomizeDrawerTest ()
+{
+	int i;
+
+	for (i = 0; i < 256*256; ++i)		TestSource[i] = pr_drawertest();
+	for (i = 0; i < 256; ++i)			TestColormap[i] = pr_drawertest();
+	for (i = 0; i < TEST_PITCH*TEST_ROWS; ++i)	TestBackground[i] = pr_drawertest();
+
+	ds_xbits = 1 + pr_drawertest() % 8;
+	ds_ybits = 1 + pr_drawertest() % 8;
+	ds_xfrac = pr_drawertest.GenRand32();
+	ds_yfrac = pr_drawertest.GenRand32();
+	ds_xstep = pr_drawertest.GenRand32() >> (pr_drawertest() & 15);
+	ds_ystep = pr_drawertest.GenRand32() >> (pr_drawertest() & 15);
+	ds_x1 = pr_drawertest() % 64;
+	ds_x2 = ds_x1 + pr_drawertest() % (TEST_PITCH - 64);
+	ds_y = 0;
+	ds_source = TestSource;
+	ds_colormap = TestColormap;
+
+	// The unclamped drawers are only used when the levels add up to 1.
+	int fglevel = pr_drawertest() % 65;
+	int bglevel = pr_drawertest() % (65 - fglevel);
+	dc_srcblend = Col2RGB8[fglevel];
+	dc_destblend = Col2RGB8[bglevel];
+	dc_colormap = TestColormap;
+	for (i = 0; i < TEST_ROWS*4; ++i)
+	{
+		TestTemp[i] = pr_drawertest();
+	}
+}
+
+typedef void (*SpanDrawer)(void);
+typedef void (STACK_ARGS *ColsDrawer)(int sx, int yl, int yh);
+
+static bool RunSpanTest (SpanDrawer cfunc, SpanDrawer ssefunc)
+{
+	for (int i = 0; i < 2; ++i)
+	{
+		memcpy (TestDest[i], TestBackground, sizeof(TestBackground));
+		dc_destorg = TestDest[i] - ylookup[0];
+		(i == 0 ? cfunc : ssefunc)();
+	}
+	return memcmp (TestDest[0], TestDest[1], sizeof(TestBackground)) == 0;
+}
+
+static bool RunColsTest (ColsDrawer cfunc, ColsDrawer ssefunc)
+{
+	int sx = pr_drawertest() % (TEST_PITCH - 4);
+	int yh = pr_drawertest() % TEST_ROWS;
+
+	for (int i = 0; i < 2; ++i)
+	{
+		memcpy (TestDest[i], TestBackground, sizeof(TestBackground));
+		dc_destorg = TestDest[i] - ylookup[0];
+		(i == 0 ? cfunc : ssefunc)(sx, 0, yh);
+	}
+	return memcmp (TestDest[0], TestDest[1], sizeof(TestBackground)) == 0;
+}
+
+CCMD (r_drawertest)
+{
+	static const char *const names[] =
+	{
+		"R_DrawSpanP", "R_DrawSpanTranslucentP", "R_DrawSpanAddClampP",
+		"rt_add4cols", "rt_addclamp4cols"
+	};
+	const int numtests = countof(names);
+	int failures[countof(names)] = { 0 };
+	int trials = argv.argc() > 1 ? atoi (argv[1]) : 1000;
+
+	if (!CPU.bSSE2)
+	{
+		Printf ("This CPU does not support SSE2.\n");
+		return;
+	}
+
+	BYTE *savedestorg = dc_destorg;
+	BYTE *savetemp = dc_temp;
+	int savepitch = dc_pitch;
+	dc_pitch = TEST_PITCH;
+	dc_temp = TestTemp;
+
+	for (int trial = 0; trial < trials; ++trial)
+	{
+		RandomizeDrawerTest ();
+		failures[0] += !RunSpanTest (R_DrawSpanP_C, R_DrawSpanP_SSE2);
+		failures[1] += !RunSpanTest (R_DrawSpanTranslucentP_C, R_DrawSpanTranslucentP_SSE2);
+		failures[2] += !RunSpanTest (R_DrawSpanAddClampP_C, R_DrawSpanAddClampP_SSE2);
+		failures[3] += !RunColsTest (rt_add4cols_c, rt_add4cols_sse2);
+		failures[4] += !RunColsTest (rt_addclamp4cols_c, rt_addclamp4cols_sse2);
+	}
+
+	dc_destorg = savedestorg;
+	dc_temp = savetemp;
+	dc_pitch = savepitch;
+
+	for (int i = 0; i < numtests; ++i)
+	{
+		Printf ("%s%-24s %d/%d mismatches\n", failures[i] ? TEXTCOLOR_RED : "",
+			names[i], failures[i], trials);
+	}
+}
+
+#endif
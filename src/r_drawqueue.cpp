@@ -0,0 +1,366 @@
+/*
+** r_drawqueue.cpp
+**
+**---------------------------------------------------------------------------
+** Copyright 2012 The ZDoom Team
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+// HEADER FILES ------------------------------------------------------------
+
+#include <stdlib.h>
+
+#include "doomtype.h"
+#include "doomdef.h"
+#include "r_local.h"
+#include "r_draw.h"
+#include "r_drawqueue.h"
+#include "memarena.h"
+#include "c_cvars.h"
+#include "c_dispatch.h"
+#include "stats.h"
+
+// TYPES -------------------------------------------------------------------
+
+enum
+{
+	DQ_Immediate,
+	DQ_Queued,
+	DQ_Sorted
+};
+
+enum
+{
+	CMD_Vline1,
+	CMD_Prevline1,
+	CMD_Vline4
+};
+
+struct FDrawCmd
+{
+	BYTE Type;
+	BYTE FracBits;
+	const FTexture *Texture;
+	BYTE *Dest;
+	int Count;
+};
+
+struct FVline1Cmd : FDrawCmd
+{
+	fixed_t IScale;
+	fixed_t TextureFrac;
+	BYTE *Colormap;
+	const BYTE *Source;
+};
+
+struct FVline4Cmd : FDrawCmd
+{
+	DWORD Vince[4];
+	DWORD Vplce[4];
+	BYTE *Palookup[4];
+	const BYTE *Source[4];
+};
+
+struct FDrawCmdSort
+{
+	const FTexture *Texture;
+	unsigned int Order;
+	FDrawCmd *Cmd;
+};
+
+// PUBLIC DATA DEFINITIONS -------------------------------------------------
+
+bool DrawQueueRecording;
+
+CVAR (Int, r_drawqueue, DQ_Immediate, 0)
+
+// PRIVATE DATA DEFINITIONS ------------------------------------------------
+
+static FMemArena DrawCmdArena;
+static TArray<FDrawCmd *> DrawCmds;
+static TArray<FDrawCmdSort> DrawCmdSorter;
+static int QueueFracBits;
+static const FTexture *QueueTexture;
+static int QueueMode;
+
+static cycle_t ReplayCycles;
+static unsigned int FrameCmds, FrameFlushes;
+
+// CODE --------------------------------------------------------------------
+
+//==========================================================================
+//
+// R_BeginDrawQueue
+//
+// Starts recording wall drawing if r_drawqueue asks for it. The mode is
+// latched so that changing the cvar mid-frame has no effect until the
+// next R_BeginDrawQueue.
+//
+//==========================================================================
+
+void R_BeginDrawQueue ()
+{
+	QueueMode = clamp<int> (r_drawqueue, DQ_Immediate, DQ_Sorted);
+	DrawQueueRecording = (QueueMode != DQ_Immediate);
+	QueueFracBits = -1;
+	QueueTexture = NULL;
+}
+
+//==========================================================================
+//
+// R_SetupWallVline
+//
+// Replaces setupvline for wallscan. When recording, the fraction bits are
+// remembered for the following commands instead of being applied now.
+//
+//==========================================================================
+
+void R_SetupWallVline (int fracbits, const FTexture *tex)
+{
+	if (DrawQueueRecording)
+	{
+		QueueFracBits = fracbits;
+		QueueTexture = tex;
+	}
+	else
+	{
+		setupvline (fracbits);
+	}
+}
+
+//==========================================================================
+//
+// NewCmd
+//
+//==========================================================================
+
+template<class T> static T *NewCmd (BYTE type)
+{
+	T *cmd = (T *)DrawCmdArena.Alloc (sizeof(T));
+	cmd->Type = type;
+	cmd->FracBits = (BYTE)QueueFracBits;
+	cmd->Texture = QueueTexture;
+	cmd->Dest = dc_dest;
+	cmd->Count = dc_count;
+	DrawCmds.Push (cmd);
+	return cmd;
+}
+
+//==========================================================================
+//
+// R_QueueVline1
+//
+// Records a single column. Returns the texture position after the last
+// pixel, just like the drawer would, so wallscan can keep going.
+//
+//==========================================================================
+
+DWORD R_QueueVline1 (bool prev)
+{
+	FVline1Cmd *cmd = NewCmd<FVline1Cmd> (prev ? CMD_Prevline1 : CMD_Vline1);
+	cmd->IScale = dc_iscale;
+	cmd->TextureFrac = dc_texturefrac;
+	cmd->Colormap = dc_colormap;
+	cmd->Source = dc_source;
+	return (DWORD)dc_texturefrac + (DWORD)dc_iscale * dc_count;
+}
+
+//==========================================================================
+//
+// R_QueueVline4
+//
+// Records four adjacent columns and advances vplce past them.
+//
+//==========================================================================
+
+void R_QueueVline4 ()
+{
+	FVline4Cmd *cmd = NewCmd<FVline4Cmd> (CMD_Vline4);
+	for (int i = 0; i < 4; ++i)
+	{
+		cmd->Vince[i] = vince[i];
+		cmd->Vplce[i] = vplce[i];
+		cmd->Palookup[i] = palookupoffse[i];
+		cmd->Source[i] = bufplce[i];
+		vplce[i] += vince[i] * dc_count;
+	}
+}
+
+//==========================================================================
+//
+// SortCmds
+//
+// Groups commands by texture. Ties keep their recording order so the
+// replay is repeatable from frame to frame.
+//
+//==========================================================================
+
+static int STACK_ARGS SortCmds (const void *a, const void *b)
+{
+	const FDrawCmdSort *x = (const FDrawCmdSort *)a;
+	const FDrawCmdSort *y = (const FDrawCmdSort *)b;
+
+	if (x->Texture != y->Texture)
+	{
+		return x->Texture < y->Texture ? -1 : 1;
+	}
+	return int(x->Order - y->Order);
+}
+
+//==========================================================================
+//
+// ReplayCmd
+//
+//==========================================================================
+
+static inline void ReplayCmd (FDrawCmd *cmd, int &fracbits)
+{
+	if (cmd->FracBits != fracbits)
+	{
+		fracbits = cmd->FracBits;
+		setupvline (fracbits);
+	}
+	dc_dest = cmd->Dest;
+	dc_count = cmd->Count;
+
+	if (cmd->Type == CMD_Vline4)
+	{
+		FVline4Cmd *cmd4 = static_cast<FVline4Cmd *>(cmd);
+		for (int i = 0; i < 4; ++i)
+		{
+			vince[i] = cmd4->Vince[i];
+			vplce[i] = cmd4->Vplce[i];
+			palookupoffse[i] = cmd4->Palookup[i];
+			bufplce[i] = cmd4->Source[i];
+		}
+		dovline4 ();
+	}
+	else
+	{
+		FVline1Cmd *cmd1 = static_cast<FVline1Cmd *>(cmd);
+		dc_iscale = cmd1->IScale;
+		dc_texturefrac = cmd1->TextureFrac;
+		dc_colormap = cmd1->Colormap;
+		dc_source = cmd1->Source;
+		if (cmd->Type == CMD_Prevline1)
+		{
+			doprevline1 ();
+		}
+		else
+		{
+			dovline1 ();
+		}
+	}
+}
+
+//==========================================================================
+//
+// R_FlushDrawQueue
+//
+// Draws everything recorded so far. Recording stays enabled.
+//
+//==========================================================================
+
+void R_FlushDrawQueue ()
+{
+	unsigned int count = DrawCmds.Size();
+	int fracbits = -1;
+
+	if (count == 0)
+	{
+		return;
+	}
+
+	ReplayCycles.Clock();
+	if (QueueMode == DQ_Sorted)
+	{
+		DrawCmdSorter.Resize (count);
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			DrawCmdSorter[i].Texture = DrawCmds[i]->Texture;
+			DrawCmdSorter[i].Order = i;
+			DrawCmdSorter[i].Cmd = DrawCmds[i];
+		}
+		qsort (&DrawCmdSorter[0], count, sizeof(FDrawCmdSort), SortCmds);
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			ReplayCmd (DrawCmdSorter[i].Cmd, fracbits);
+		}
+	}
+	else
+	{
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			ReplayCmd (DrawCmds[i], fracbits);
+		}
+	}
+	ReplayCycles.Unclock();
+
+	FrameCmds += count;
+	FrameFlushes++;
+	DrawCmds.Clear();
+	DrawCmdArena.FreeAll();
+}
+
+//==========================================================================
+//
+// R_EndDrawQueue
+//
+//==========================================================================
+
+void R_EndDrawQueue ()
+{
+	R_FlushDrawQueue ();
+	DrawQueueRecording = false;
+}
+
+//==========================================================================
+//
+// R_ResetDrawQueueStats
+//
+// Called once per frame.
+//
+//==========================================================================
+
+void R_ResetDrawQueueStats ()
+{
+	ReplayCycles.Reset();
+	FrameCmds = 0;
+	FrameFlushes = 0;
+}
+
+ADD_STAT (drawqueue)
+{
+	static const char *const modes[] = { "immediate", "queued", "sorted" };
+	FString out;
+
+	out.Format ("%s: %u cmds in %u flushes, replay=%04.2f ms",
+		modes[clamp<int> (r_drawqueue, DQ_Immediate, DQ_Sorted)],
+		FrameCmds, FrameFlushes, ReplayCycles.TimeMS());
+	return out;
+}
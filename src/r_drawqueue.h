@@ -0,0 +1,80 @@
+/*
+** r_drawqueue.h
+**
+**---------------------------------------------------------------------------
+** Copyright 2012 The ZDoom Team
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+#ifndef __R_DRAWQUEUE_H
+#define __R_DRAWQUEUE_H
+
+#include "r_draw.h"
+
+class FTexture;
+
+// The draw queue records the column drawing done by wallscan while the BSP
+// is walked and replays it afterwards, optionally sorted by texture. It is
+// controlled by r_drawqueue:
+//   0 = draw immediately
+//   1 = queue and replay in BSP order
+//   2 = queue and replay grouped by texture
+//
+// Only opaque walls are queued: they never overdraw each other, so any
+// replay order produces the same image. Anything that has to draw on top
+// of them during the BSP walk (i.e. decals) must flush the queue first.
+
+extern bool DrawQueueRecording;
+
+void R_BeginDrawQueue ();
+void R_FlushDrawQueue ();
+void R_EndDrawQueue ();
+void R_ResetDrawQueueStats ();
+
+void R_SetupWallVline (int fracbits, const FTexture *tex);
+DWORD R_QueueVline1 (bool prev);
+void R_QueueVline4 ();
+
+// These take their parameters from the same globals as the drawers they
+// stand in for.
+inline DWORD R_WallVline1 ()
+{
+	return DrawQueueRecording ? R_QueueVline1 (false) : dovline1 ();
+}
+
+inline DWORD R_WallPrevline1 ()
+{
+	return DrawQueueRecording ? R_QueueVline1 (true) : doprevline1 ();
+}
+
+inline void R_WallVline4 ()
+{
+	if (DrawQueueRecording) R_QueueVline4 (); else dovline4 ();
+}
+
+#endif
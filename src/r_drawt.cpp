@@ -57,11 +57,11 @@
 // dc_ctspan is advanced while drawing into dc_temp.
 // horizspan is advanced up to dc_ctspan when drawing from dc_temp to the screen.
 
-BYTE dc_tempbuff[MAXHEIGHT*4];
-BYTE *dc_temp;
-unsigned int dc_tspans[4][MAXHEIGHT];
-unsigned int *dc_ctspan[4];
-unsigned int *horizspan[4];
+COLUMN_TLS BYTE dc_tempbuff[MAXHEIGHT*4];
+COLUMN_TLS BYTE *dc_temp;
+COLUMN_TLS unsigned int dc_tspans[4][MAXHEIGHT];
+COLUMN_TLS unsigned int *dc_ctspan[4];
+COLUMN_TLS unsigned int *horizspan[4];
 
 #ifdef X86_ASM
 extern "C" void R_SetupShadedCol();
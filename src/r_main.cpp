@@ -56,6 +56,7 @@
 #include "st_start.h"
 #include "v_font.h"
 #include "r_data/colormaps.h"
+#include "r_drawqueue.h"
 #include "farchive.h"
 
 // MACROS ------------------------------------------------------------------
@@ -81,6 +82,7 @@ void R_DeinitSprites();
 // PRIVATE FUNCTION PROTOTYPES ---------------------------------------------
 
 static void R_ShutdownRenderer();
+static void R_ThreadBenchFrame();
 
 // EXTERNAL DATA DECLARATIONS ----------------------------------------------
 
@@ -117,7 +119,7 @@ fixed_t			viewingrangerecip;
 fixed_t			FocalLengthX;
 fixed_t			FocalLengthY;
 float			FocalLengthXfloat;
-FDynamicColormap*basecolormap;		// [RH] colormap currently drawing with
+COLUMN_TLS FDynamicColormap*basecolormap;	// [RH] colormap currently drawing with
 int				fixedlightlev;
 lighttable_t	*fixedcolormap;
 FSpecialColormap *realfixedcolormap;
@@ -151,16 +153,16 @@ angle_t 		xtoviewangle[MAXWIDTH+1];
 bool			foggy;			// [RH] ignore extralight and fullbright?
 int				r_actualextralight;
 
-void (*colfunc) (void);
+COLUMN_TLS void (*colfunc) (void);
 void (*basecolfunc) (void);
 void (*fuzzcolfunc) (void);
 void (*transcolfunc) (void);
-void (*spanfunc) (void);
+RENDER_TLS void (*spanfunc) (void);
 
-void (*hcolfunc_pre) (void);
-void (*hcolfunc_post1) (int hx, int sx, int yl, int yh);
+COLUMN_TLS void (*hcolfunc_pre) (void);
+COLUMN_TLS void (*hcolfunc_post1) (int hx, int sx, int yl, int yh);
 void (*hcolfunc_post2) (int hx, int sx, int yl, int yh);
-void (STACK_ARGS *hcolfunc_post4) (int sx, int yl, int yh);
+COLUMN_TLS void (STACK_ARGS *hcolfunc_post4) (int sx, int yl, int yh);
 
 cycle_t WallCycles, PlaneCycles, MaskedCycles, WallScanCycles;
 
@@ -432,6 +434,35 @@ CUSTOM_CVAR (Int, r_columnmethod, 1, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
 	}
 }
 
+//==========================================================================
+//
+// CVAR r_threads
+//
+// Number of threads to split the parts of the renderer that support it
+// across. 1 keeps everything on the main thread. Builds that use the ia32
+// assembly drawers are always single-threaded.
+//
+//==========================================================================
+
+CUSTOM_CVAR (Int, r_threads, 1, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
+{
+#ifdef RENDER_THREADS
+	if (self < 1)
+	{
+		self = 1;
+	}
+	else if (self > FThreadPool::MAX_THREADS)
+	{
+		self = FThreadPool::MAX_THREADS;
+	}
+#else
+	if (self != 1)
+	{
+		self = 1;
+	}
+#endif
+}
+
 //==========================================================================
 //
 // R_Init
@@ -690,7 +721,9 @@ void R_EnterMirror (drawseg_t *ds, int depth)
 	WindowRight = ds->x2;
 	MirrorFlags = (depth + 1) & 1;
 
+	R_BeginDrawQueue ();
 	R_RenderBSPNode (nodes + numnodes - 1);
+	R_EndDrawQueue ();
 	R_3D_ResetClip(); // reset clips (floor/ceiling)
 
 	R_DrawPlanes ();
@@ -761,6 +794,7 @@ void R_RenderActorView (AActor *actor, bool dontmaplines)
 	PlaneCycles.Reset();
 	MaskedCycles.Reset();
 	WallScanCycles.Reset();
+	R_ResetDrawQueueStats ();
 
 	fakeActive = 0; // kg3D - reset fake floor indicator
 	R_3D_ResetClip(); // reset clips (floor/ceiling)
@@ -818,7 +852,9 @@ void R_RenderActorView (AActor *actor, bool dontmaplines)
 	PO_LinkToSubsectors();
 	if (r_polymost < 2)
 	{
+		R_BeginDrawQueue ();
 		R_RenderBSPNode (nodes + numnodes - 1);	// The head node is the last node output.
+		R_EndDrawQueue ();
 		R_3D_ResetClip(); // reset clips (floor/ceiling)
 	}
 	camera->renderflags = savedflags;
@@ -862,6 +898,11 @@ void R_RenderActorView (AActor *actor, bool dontmaplines)
 	interpolator.RestoreInterpolations ();
 	R_SetupBuffer ();
 
+	if (!bRenderingToCanvas)
+	{
+		R_ThreadBenchFrame ();
+	}
+
 	// If we don't want shadered colormaps, NULL it now so that the
 	// copy to the screen does not use a special colormap shader.
 	if (!r_shadercolormaps)
@@ -987,7 +1028,6 @@ CCMD (clearwallcycles)
 }
 
 #if 1
-// To use these, also uncomment the clock/unclock in wallscan
 static double bestscancycles = HUGE_VAL;
 
 ADD_STAT (scancycles)
@@ -1005,3 +1045,77 @@ CCMD (clearscancycles)
 	bestscancycles = HUGE_VAL;
 }
 #endif
+
+//==========================================================================
+//
+// CCMD r_threadbench
+//
+// Renders the following frames with 1, 2, 4, ... threads, up to the given
+// count (default: the number of processors), and prints the average render
+// times for each step. Stand still while it runs, or the numbers will be
+// meaningless.
+//
+//==========================================================================
+
+enum { THREADBENCH_FRAMES = 70 };
+
+static int ThreadBenchMax;
+static int ThreadBenchSavedThreads;
+static int ThreadBenchFrames;
+static double ThreadBenchWalls, ThreadBenchPlanes, ThreadBenchMasked;
+
+CCMD (r_threadbench)
+{
+#ifndef RENDER_THREADS
+	Printf ("This build can only render on one thread.\n");
+#else
+	int max = argv.argc() > 1 ? atoi (argv[1]) : FThreadPool::GetProcessorCount();
+
+	if (ThreadBenchMax != 0)
+	{
+		Printf ("A thread benchmark is already running.\n");
+		return;
+	}
+	ThreadBenchMax = clamp<int> (max, 1, FThreadPool::MAX_THREADS);
+	ThreadBenchSavedThreads = r_threads;
+	ThreadBenchFrames = 0;
+	ThreadBenchWalls = ThreadBenchPlanes = ThreadBenchMasked = 0;
+	r_threads = 1;
+	Printf ("%dx%d, %d frames per step\n", viewwidth, viewheight, THREADBENCH_FRAMES);
+	Printf ("threads   walls  planes  masked   total\n");
+#endif
+}
+
+static void R_ThreadBenchFrame ()
+{
+	if (ThreadBenchMax == 0)
+	{
+		return;
+	}
+	ThreadBenchWalls += WallCycles.TimeMS();
+	ThreadBenchPlanes += PlaneCycles.TimeMS();
+	ThreadBenchMasked += MaskedCycles.TimeMS();
+	if (++ThreadBenchFrames < THREADBENCH_FRAMES)
+	{
+		return;
+	}
+
+	double walls = ThreadBenchWalls / THREADBENCH_FRAMES;
+	double planes = ThreadBenchPlanes / THREADBENCH_FRAMES;
+	double masked = ThreadBenchMasked / THREADBENCH_FRAMES;
+	int threads = r_threads;
+
+	Printf ("%7d %7.2f %7.2f %7.2f %7.2f\n", threads, walls, planes, masked, walls + planes + masked);
+
+	ThreadBenchFrames = 0;
+	ThreadBenchWalls = ThreadBenchPlanes = ThreadBenchMasked = 0;
+	if (threads >= ThreadBenchMax)
+	{
+		r_threads = ThreadBenchSavedThreads;
+		ThreadBenchMax = 0;
+	}
+	else
+	{
+		r_threads = MIN (threads * 2, ThreadBenchMax);
+	}
+}
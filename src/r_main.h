@@ -53,7 +53,7 @@ extern fixed_t			centeryfrac;
 extern fixed_t			yaspectmul;
 extern float			iyaspectmulfloat;
 
-extern FDynamicColormap*basecolormap;	// [RH] Colormap for sector currently being drawn
+extern COLUMN_TLS FDynamicColormap*basecolormap;	// [RH] Colormap for sector currently being drawn
 
 extern int				linecount;
 extern int				loopcount;
@@ -107,18 +107,18 @@ extern FSpecialColormap*realfixedcolormap;
 // Function pointers to switch refresh/drawing functions.
 // Used to select shadow mode etc.
 //
-extern void 			(*colfunc) (void);
+extern COLUMN_TLS void	(*colfunc) (void);
 extern void 			(*basecolfunc) (void);
 extern void 			(*fuzzcolfunc) (void);
 extern void				(*transcolfunc) (void);
 // No shadow effects on floors.
-extern void 			(*spanfunc) (void);
+extern RENDER_TLS void	(*spanfunc) (void);
 
 // [RH] Function pointers for the horizontal column drawers.
-extern void (*hcolfunc_pre) (void);
-extern void (*hcolfunc_post1) (int hx, int sx, int yl, int yh);
+extern COLUMN_TLS void (*hcolfunc_pre) (void);
+extern COLUMN_TLS void (*hcolfunc_post1) (int hx, int sx, int yl, int yh);
 extern void (*hcolfunc_post2) (int hx, int sx, int yl, int yh);
-extern void (STACK_ARGS *hcolfunc_post4) (int sx, int yl, int yh);
+extern COLUMN_TLS void (STACK_ARGS *hcolfunc_post4) (int sx, int yl, int yh);
 
 
 void R_InitTextureMapping ();
@@ -134,6 +134,10 @@ void R_SetupBuffer ();
 
 void R_RenderViewToCanvas (AActor *actor, DCanvas *canvas, int x, int y, int width, int height, bool dontmaplines = false);
 
+// [r_benchmark.cpp] Offscreen rendering benchmark
+bool R_StartBenchViews (const char *viewfile, const char *outfile, bool quit);
+void R_BenchViewsTicker ();
+
 // [RH] Initialize multires stuff for renderer
 void R_MultiresInit (void);
 
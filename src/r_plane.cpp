@@ -58,6 +58,8 @@
 #include "r_3dfloors.h"
 #include "v_palette.h"
 #include "r_data/colormaps.h"
+#include "r_drawqueue.h"
+#include "memarena.h"
 
 #ifdef _MSC_VER
 #pragma warning(disable:4244)
@@ -82,6 +84,19 @@ static visplane_t		*visplanes[MAXVISPLANES+1];	// killough
 static visplane_t		*freetail;					// killough
 static visplane_t		**freehead = &freetail;		// killough
 
+// Column storage for the visplanes. Everything in it is thrown away by
+// R_ClearPlanes (true).
+static FMemArena		PlaneColumns;
+static size_t			PlaneColumnBytes;
+static int				PlanesUsed, PlanesMerged, PlaneFlatChanges;
+
+// The planes R_DrawPlanes is about to draw, possibly sorted.
+static TArray<visplane_t *> PlaneDrawList;
+
+CVAR (Bool, r_mergeplanes, true, 0)
+CVAR (Bool, r_sortplanes, true, 0)
+CVAR (Bool, r_tiledflats, false, 0)
+
 visplane_t 				*floorplane;
 visplane_t 				*ceilingplane;
 
@@ -121,28 +136,31 @@ short					ceilingclip[MAXWIDTH];
 // texture mapping
 //
 
-static fixed_t			planeheight;
+static RENDER_TLS fixed_t	planeheight;
+static RENDER_TLS fixed_t	planevis;
+static RENDER_TLS FDynamicColormap *planecolormap;
+static RENDER_TLS bool		planetiled;		// ds_source is from GetPixelsTiled()
 
 extern "C" {
 //
 // spanend holds the end of a plane span in each screen row
 //
-short					spanend[MAXHEIGHT];
+COLUMN_TLS short		spanend[MAXHEIGHT];
 BYTE					*tiltlighting[MAXWIDTH];
 
-int						planeshade;
+RENDER_TLS int			planeshade;
 FVector3				plane_sz, plane_su, plane_sv;
 float					planelightfloat;
-bool					plane_shade;
-fixed_t					pviewx, pviewy;
+RENDER_TLS bool			plane_shade;
+RENDER_TLS fixed_t		pviewx, pviewy;
 
 void R_DrawTiltedPlane_ASM (int y, int x1);
 }
 
 fixed_t 				yslope[MAXHEIGHT];
-static fixed_t			xscale, yscale;
-static DWORD			xstepscale, ystepscale;
-static DWORD			basexfrac, baseyfrac;
+static RENDER_TLS fixed_t	xscale, yscale;
+static RENDER_TLS DWORD	xstepscale, ystepscale;
+static RENDER_TLS DWORD	basexfrac, baseyfrac;
 
 #ifdef X86_ASM
 extern "C" void R_SetSpanSource_ASM (const BYTE *flat);
@@ -152,6 +170,9 @@ extern "C" void R_SetTiltedSpanSource_ASM (const BYTE *flat);
 extern "C" BYTE *ds_curcolormap, *ds_cursource, *ds_curtiltedsource;
 #endif
 void					R_DrawSinglePlane (visplane_t *, fixed_t alpha, bool additive, bool masked);
+static void				R_SetupNormalPlane (visplane_t *, fixed_t alpha, bool additive, bool masked);
+static bool				R_QueueThreadedPlane (visplane_t *pl);
+static void				R_DrawThreadedPlanes ();
 
 //==========================================================================
 //
@@ -188,7 +209,8 @@ void R_DeinitPlanes ()
 // R_MapPlane
 //
 // Globals used: planeheight, ds_source, basexscale, baseyscale,
-// pviewx, pviewy, xoffs, yoffs, basecolormap, xscale, yscale.
+// pviewx, pviewy, xoffs, yoffs, planecolormap, planevis, xscale, yscale.
+// All of them are per-thread, so this may run on any render thread.
 //
 //==========================================================================
 
@@ -217,8 +239,8 @@ void R_MapPlane (int y, int x1)
 	if (plane_shade)
 	{
 		// Determine lighting based on the span's distance from the viewer.
-		ds_colormap = basecolormap->Maps + (GETPALOOKUP (
-			FixedMul (GlobVis, abs (centeryfrac - (y << FRACBITS))), planeshade) << COLORMAPSHIFT);
+		ds_colormap = planecolormap->Maps + (GETPALOOKUP (
+			FixedMul (planevis, abs (centeryfrac - (y << FRACBITS))), planeshade) << COLORMAPSHIFT);
 	}
 
 #ifdef X86_ASM
@@ -528,6 +550,13 @@ void R_ClearPlanes (bool fullclear)
 
 	if (fullclear)
 	{
+		// Every plane is on the freelist now, so their columns can go.
+		PlaneColumns.FreeAll();
+		PlaneColumnBytes = 0;
+		PlanesUsed = 0;
+		PlanesMerged = 0;
+		PlaneFlatChanges = 0;
+
 		// opening / clipping determination
 		clearbufshort (floorclip, viewwidth, viewheight);
 		// [RH] clip ceiling to console bottom
@@ -544,7 +573,7 @@ void R_ClearPlanes (bool fullclear)
 // new_visplane
 //
 // New function, by Lee Killough
-// [RH] top and bottom buffers get allocated immediately after the visplane.
+// The plane starts out without any columns. R_CheckPlane adds them.
 //
 //==========================================================================
 
@@ -554,9 +583,8 @@ static visplane_t *new_visplane (unsigned hash)
 
 	if (check == NULL)
 	{
-		check = (visplane_t *)M_Malloc (sizeof(*check) + sizeof(*check->top)*(MAXWIDTH*2));
-		memset(check, 0, sizeof(*check) + sizeof(*check->top)*(MAXWIDTH*2));
-		check->bottom = &check->top[MAXWIDTH+2];
+		check = (visplane_t *)M_Malloc (sizeof(*check));
+		memset(check, 0, sizeof(*check));
 	}
 	else if (NULL == (freetail = freetail->next))
 	{
@@ -565,9 +593,59 @@ static visplane_t *new_visplane (unsigned hash)
 
 	check->next = visplanes[hash];
 	visplanes[hash] = check;
+	check->top = check->bottom = NULL;
+	check->left = 0;
+	check->right = -1;
+	PlanesUsed++;
 	return check;
 }
 
+//==========================================================================
+//
+// R_ReservePlaneColumns
+//
+// Makes sure the plane has column storage for [x1,x2]. Columns that have
+// not been marked yet have a top of 0x7fff. Planes tend to keep growing
+// sideways as more walls are added, so some room is left on either side.
+//
+//==========================================================================
+
+static void R_ReservePlaneColumns (visplane_t *pl, int x1, int x2)
+{
+	if (x1 >= pl->left && x2 <= pl->right)
+	{
+		return;
+	}
+
+	int slack = (x2 - x1 + 1) / 2;
+	int left = MAX (0, x1 - slack);
+	int right = MIN (viewwidth - 1, x2 + slack);
+
+	if (pl->top != NULL)
+	{
+		left = MIN (left, pl->left);
+		right = MAX (right, pl->right);
+	}
+
+	int count = right - left + 1;
+	unsigned short *top = (unsigned short *)PlaneColumns.Alloc (count * 2 * sizeof(unsigned short));
+	unsigned short *bottom = top + count;
+
+	PlaneColumnBytes += count * 2 * sizeof(unsigned short);
+	clearbufshort (top, count, 0x7fff);
+	top -= left;
+	bottom -= left;
+	if (pl->minx <= pl->maxx)
+	{
+		memcpy (&top[pl->minx], &pl->top[pl->minx], (pl->maxx - pl->minx + 1) * sizeof(*top));
+		memcpy (&bottom[pl->minx], &pl->bottom[pl->minx], (pl->maxx - pl->minx + 1) * sizeof(*bottom));
+	}
+	pl->top = top;
+	pl->bottom = bottom;
+	pl->left = left;
+	pl->right = right;
+}
+
 
 //==========================================================================
 //
@@ -720,8 +798,6 @@ visplane_t *R_FindPlane (const secplane_t &height, FTextureID picnum, int lightl
 	check->MirrorFlags = MirrorFlags;
 	check->CurrentSkybox = CurrentSkybox;
 
-	clearbufshort (check->top, viewwidth, 0x7fff);
-
 	return check;
 }
 
@@ -768,6 +844,7 @@ visplane_t *R_CheckPlane (visplane_t *pl, int start, int stop)
 	if (x > intrh)
 	{
 		// use the same visplane
+		R_ReservePlaneColumns (pl, unionl, unionh);
 		pl->minx = unionl;
 		pl->maxx = unionh;
 	}
@@ -809,9 +886,11 @@ visplane_t *R_CheckPlane (visplane_t *pl, int start, int stop)
 		new_pl->MirrorFlags = pl->MirrorFlags;
 		new_pl->CurrentSkybox = pl->CurrentSkybox;
 		pl = new_pl;
+		pl->minx = viewwidth;
+		pl->maxx = -1;
+		R_ReservePlaneColumns (pl, start, stop);
 		pl->minx = start;
 		pl->maxx = stop;
-		clearbufshort (pl->top, viewwidth, 0x7fff);
 	}
 	return pl;
 }
@@ -1017,6 +1096,311 @@ static void R_DrawSkyStriped (visplane_t *pl)
 	centeryfrac = centerysave;
 }
 
+//==========================================================================
+//
+// Threaded plane drawing
+//
+// Opaque, unsloped flats are by far the most common kind of plane, and
+// once they are set up, mapping their spans touches nothing but per-thread
+// state and the rows being drawn. With r_threads above 1, R_DrawPlanes
+// queues them up instead of drawing them and then splits the view into
+// horizontal slices, one per thread. Every thread draws the parts of all
+// queued planes that fall inside its own slice. No two visplanes from the
+// same pass cover the same pixel, so the order they are drawn in does not
+// matter, and the output is identical to the single-threaded path.
+//
+// Skies, slopes and r_drawflat still go through R_DrawSinglePlane on the
+// main thread.
+//
+//==========================================================================
+
+EXTERN_CVAR (Int, r_threads)
+
+struct FThreadedPlane
+{
+	visplane_t *Plane;
+	FTexture *Tex;
+	const BYTE *Source;
+	bool Tiled;
+};
+
+static TArray<FThreadedPlane> ThreadedPlanes;
+static void (*ThreadedSpanFunc)(void);
+static int NumPlaneSlices;
+static cycle_t PlaneThreadCycles[FThreadPool::MAX_THREADS];
+static int PlaneThreadsUsed;
+
+//==========================================================================
+//
+// R_QueueThreadedPlane
+//
+// Returns false if the plane needs to be drawn on the main thread.
+// Anything that is not thread-safe, like creating the texture's pixels,
+// is done here.
+//
+//==========================================================================
+
+static bool R_QueueThreadedPlane (visplane_t *pl)
+{
+	if (pl->minx > pl->maxx)
+	{
+		return true;
+	}
+	if (pl->picnum == skyflatnum || pl->height.a != 0 || pl->height.b != 0)
+	{
+		return false;
+	}
+
+	FTexture *tex = TexMan(pl->picnum, true);
+
+	if (tex->UseType == FTexture::TEX_Null)
+	{
+		return true;
+	}
+	pl->xscale = MulScale16 (pl->xscale, tex->xScale);
+	pl->yscale = MulScale16 (pl->yscale, tex->yScale);
+
+	FThreadedPlane *tp = &ThreadedPlanes[ThreadedPlanes.Reserve(1)];
+	tp->Plane = pl;
+	tp->Tex = tex;
+	tp->Tiled = r_tiledflats && tex->CanTilePixels();
+	tp->Source = tp->Tiled ? tex->GetPixelsTiled() : tex->GetPixels();
+	return true;
+}
+
+//==========================================================================
+//
+// R_DrawPlaneSlice
+//
+// Thread pool job: draws every queued plane's spans for one slice.
+//
+//==========================================================================
+
+static void R_DrawPlaneSlice (void *userdata, int slice, int thread)
+{
+	int y1 = viewheight * slice / NumPlaneSlices;
+	int y2 = viewheight * (slice + 1) / NumPlaneSlices;
+
+	PlaneThreadCycles[thread].Clock();
+	spanfunc = ThreadedSpanFunc;
+	for (unsigned i = 0; i < ThreadedPlanes.Size(); ++i)
+	{
+		visplane_t *pl = ThreadedPlanes[i].Plane;
+
+		R_SetupSpanBits (ThreadedPlanes[i].Tex);
+		ds_source = ThreadedPlanes[i].Source;
+		planetiled = ThreadedPlanes[i].Tiled;
+		planeshade = LIGHT2SHADE(pl->lightlevel);
+		R_SetupNormalPlane (pl, OPAQUE, false, false);
+		R_MapVisPlaneRows (pl, R_MapPlane, y1, y2);
+	}
+	PlaneThreadCycles[thread].Unclock();
+}
+
+//==========================================================================
+//
+// R_DrawThreadedPlanes
+//
+//==========================================================================
+
+static void R_DrawThreadedPlanes ()
+{
+	int i;
+
+	NumPlaneSlices = MIN<int> (r_threads, viewheight);
+	ThreadPool.Reserve (NumPlaneSlices);
+	PlaneThreadsUsed = MIN (NumPlaneSlices, ThreadPool.GetThreadCount());
+	for (i = 0; i < PlaneThreadsUsed; ++i)
+	{
+		PlaneThreadCycles[i].Reset();
+	}
+	ThreadedSpanFunc = spanfunc;
+	FTexture::CacheFrozen = true;
+	ThreadPool.Run (R_DrawPlaneSlice, NULL, NumPlaneSlices);
+	FTexture::CacheFrozen = false;
+	ThreadedPlanes.Clear();
+	NetUpdate ();
+}
+
+ADD_STAT(planethreads)
+{
+	FString out;
+
+	if (PlaneThreadsUsed == 0)
+	{
+		out = "planes are drawn on the main thread";
+	}
+	else
+	{
+		out.Format ("%d slices:", NumPlaneSlices);
+		for (int i = 0; i < PlaneThreadsUsed; ++i)
+		{
+			out.AppendFormat (" %04.1f", PlaneThreadCycles[i].TimeMS());
+		}
+		out += " ms";
+	}
+	return out;
+}
+
+//==========================================================================
+//
+// R_PlanesMatch
+//
+// True if the two planes would have been the same visplane if their
+// columns had not overlapped when R_CheckPlane saw them.
+//
+//==========================================================================
+
+static bool R_PlanesMatch (const visplane_t *a, const visplane_t *b)
+{
+	return a->height == b->height &&
+		a->picnum == b->picnum &&
+		a->lightlevel == b->lightlevel &&
+		a->xoffs == b->xoffs &&
+		a->yoffs == b->yoffs &&
+		a->colormap == b->colormap &&
+		a->xscale == b->xscale &&
+		a->yscale == b->yscale &&
+		a->angle == b->angle &&
+		a->sky == b->sky &&
+		a->skybox == b->skybox &&
+		a->extralight == b->extralight &&
+		a->visibility == b->visibility &&
+		a->viewx == b->viewx &&
+		a->viewy == b->viewy &&
+		a->viewz == b->viewz &&
+		a->viewangle == b->viewangle &&
+		a->Alpha == b->Alpha &&
+		a->Additive == b->Additive &&
+		a->CurrentMirror == b->CurrentMirror &&
+		a->MirrorFlags == b->MirrorFlags &&
+		a->CurrentSkybox == b->CurrentSkybox;
+}
+
+//==========================================================================
+//
+// R_MergePlane
+//
+// Moves src's columns into dest if none of them are in use by both.
+//
+//==========================================================================
+
+static bool R_MergePlane (visplane_t *dest, visplane_t *src)
+{
+	int x1 = MAX (dest->minx, src->minx);
+	int x2 = MIN (dest->maxx, src->maxx);
+	int x;
+
+	for (x = x1; x <= x2; ++x)
+	{
+		if (dest->top[x] != 0x7fff && src->top[x] != 0x7fff)
+		{
+			return false;
+		}
+	}
+
+	x1 = MIN (dest->minx, src->minx);
+	x2 = MAX (dest->maxx, src->maxx);
+	R_ReservePlaneColumns (dest, x1, x2);
+	for (x = src->minx; x <= src->maxx; ++x)
+	{
+		if (src->top[x] != 0x7fff)
+		{
+			dest->top[x] = src->top[x];
+			dest->bottom[x] = src->bottom[x];
+		}
+	}
+	dest->minx = x1;
+	dest->maxx = x2;
+	return true;
+}
+
+//==========================================================================
+//
+// R_MergePlanes
+//
+// R_CheckPlane starts a new visplane as soon as a wall's columns overlap
+// the plane's, even when the wall ends up marking none of the shared
+// columns. Combining such planes again before drawing saves the per-plane
+// setup and lets spans run across the seam. Only the normal planes of the
+// current pass are merged. Skybox and 3D floor planes are left alone.
+//
+//==========================================================================
+
+static void R_MergePlanes ()
+{
+	for (int i = 0; i < MAXVISPLANES; i++)
+	{
+		for (visplane_t *pl = visplanes[i]; pl != NULL; pl = pl->next)
+		{
+			if (pl->sky < 0 || pl->minx > pl->maxx ||
+				pl->CurrentMirror != CurrentMirror || pl->CurrentSkybox != CurrentSkybox)
+			{
+				continue;
+			}
+			for (visplane_t **probe = &pl->next; *probe != NULL; )
+			{
+				visplane_t *other = *probe;
+
+				if (other->minx <= other->maxx && R_PlanesMatch (pl, other) && R_MergePlane (pl, other))
+				{ // move to freelist
+					*probe = other->next;
+					other->next = NULL;
+					*freehead = other;
+					freehead = &other->next;
+					PlanesMerged++;
+				}
+				else
+				{
+					probe = &other->next;
+				}
+			}
+		}
+	}
+}
+
+ADD_STAT (visplanes)
+{
+	FString out;
+	out.Format ("%d visplanes, %d merged, %d flat changes, %u KB of columns",
+		PlanesUsed, PlanesMerged, PlaneFlatChanges, (unsigned)(PlaneColumnBytes / 1024));
+	return out;
+}
+
+//==========================================================================
+//
+// R_ComparePlanes
+//
+// Sorts planes so that the ones sharing a flat, colormap and scale are
+// drawn after each other. The normal planes of one pass never overlap, so
+// the order they are drawn in does not affect the output.
+//
+//==========================================================================
+
+static int STACK_ARGS R_ComparePlanes (const void *a, const void *b)
+{
+	const visplane_t *x = *(const visplane_t **)a;
+	const visplane_t *y = *(const visplane_t **)b;
+
+	if (x->picnum != y->picnum)
+	{
+		return x->picnum.GetIndex() - y->picnum.GetIndex();
+	}
+	if (x->colormap != y->colormap)
+	{
+		return x->colormap < y->colormap ? -1 : 1;
+	}
+	if (x->xscale != y->xscale)
+	{
+		return x->xscale < y->xscale ? -1 : 1;
+	}
+	if (x->yscale != y->yscale)
+	{
+		return x->yscale < y->yscale ? -1 : 1;
+	}
+	return x->lightlevel - y->lightlevel;
+}
+
 //==========================================================================
 //
 // R_DrawPlanes
@@ -1033,9 +1417,19 @@ int R_DrawPlanes ()
 	visplane_t *pl;
 	int i;
 	int vpcount = 0;
+	bool threaded = false;
 
 	ds_color = 3;
 
+	if (r_mergeplanes)
+	{
+		R_MergePlanes ();
+	}
+
+#ifdef RENDER_THREADS
+	threaded = r_threads > 1 && !r_drawflat && !tilt;
+#endif
+
 	for (i = 0; i < MAXVISPLANES; i++)
 	{
 		for (pl = visplanes[i]; pl; pl = pl->next)
@@ -1045,14 +1439,36 @@ int R_DrawPlanes ()
 				continue;
 			// kg3D - draw only real planes now
 			if(pl->sky >= 0) {
-				vpcount++;
-				R_DrawSinglePlane (pl, OPAQUE, false, false);
+				PlaneDrawList.Push (pl);
 			}
 		}
 	}
+	if (r_sortplanes && PlaneDrawList.Size() > 1)
+	{
+		qsort (&PlaneDrawList[0], PlaneDrawList.Size(), sizeof(visplane_t *), R_ComparePlanes);
+	}
+	for (unsigned int j = 0; j < PlaneDrawList.Size(); ++j)
+	{
+		pl = PlaneDrawList[j];
+		vpcount++;
+		if (j == 0 || pl->picnum != PlaneDrawList[j-1]->picnum)
+		{
+			PlaneFlatChanges++;
+		}
+		if (!threaded || !R_QueueThreadedPlane (pl))
+		{
+			R_DrawSinglePlane (pl, OPAQUE, false, false);
+		}
+	}
+	PlaneDrawList.Clear();
+	if (ThreadedPlanes.Size() > 0)
+	{
+		R_DrawThreadedPlanes ();
+	}
 	return vpcount;
 }
 
+
 // kg3D - draw all visplanes with "height"
 void R_DrawHeightPlanes(fixed_t height)
 {
@@ -1124,12 +1540,18 @@ void R_DrawSinglePlane (visplane_t *pl, fixed_t alpha, bool additive, bool maske
 		R_SetupSpanBits(tex);
 		pl->xscale = MulScale16 (pl->xscale, tex->xScale);
 		pl->yscale = MulScale16 (pl->yscale, tex->yScale);
-		ds_source = tex->GetPixels ();
+
+		bool normal = r_drawflat || ((pl->height.a == 0 && pl->height.b == 0) && !tilt);
+
+		// Only the opaque span drawer knows the tiled layout.
+		planetiled = r_tiledflats && normal && alpha >= OPAQUE && !masked && !additive &&
+			tex->CanTilePixels();
+		ds_source = planetiled ? tex->GetPixelsTiled() : tex->GetPixels();
 
 		basecolormap = pl->colormap;
 		planeshade = LIGHT2SHADE(pl->lightlevel);
 
-		if (r_drawflat || ((pl->height.a == 0 && pl->height.b == 0) && !tilt))
+		if (normal)
 		{
 			R_DrawNormalPlane (pl, alpha, additive, masked);
 		}
@@ -1295,7 +1717,9 @@ void R_DrawSkyBoxes ()
 		viewzStack.Push (viewz);
 		visplaneStack.Push (pl);
 
+		R_BeginDrawQueue ();
 		R_RenderBSPNode (nodes + numnodes - 1);
+		R_EndDrawQueue ();
 		R_3D_ResetClip(); // reset clips (floor/ceiling)
 		R_DrawPlanes ();
 
@@ -1505,6 +1929,21 @@ void R_DrawNormalPlane (visplane_t *pl, fixed_t alpha, bool additive, bool maske
 		return;
 	}
 
+	R_SetupNormalPlane (pl, alpha, additive, masked);
+	R_MapVisPlane (pl, R_MapPlane);
+}
+
+//==========================================================================
+//
+// R_SetupNormalPlane
+//
+// Calculates the per-plane values used by R_MapPlane. Everything it sets
+// is per-thread, so the threaded plane pass can call it from any thread.
+//
+//==========================================================================
+
+static void R_SetupNormalPlane (visplane_t *pl, fixed_t alpha, bool additive, bool masked)
+{
 	angle_t planeang = pl->angle;
 	xscale = pl->xscale << (16 - ds_xbits);
 	yscale = pl->yscale << (16 - ds_ybits);
@@ -1545,9 +1984,10 @@ void R_DrawNormalPlane (visplane_t *pl, fixed_t alpha, bool additive, bool maske
 
 	planeheight = abs (FixedMul (pl->height.d, -pl->height.ic) - viewz);
 
-	GlobVis = FixedDiv (r_FloorVisibility, planeheight);
+	planevis = FixedDiv (r_FloorVisibility, planeheight);
+	planecolormap = pl->colormap;
 	if (fixedlightlev >= 0)
-		ds_colormap = basecolormap->Maps + fixedlightlev, plane_shade = false;
+		ds_colormap = planecolormap->Maps + fixedlightlev, plane_shade = false;
 	else if (fixedcolormap)
 		ds_colormap = fixedcolormap, plane_shade = false;
 	else
@@ -1596,11 +2036,10 @@ void R_DrawNormalPlane (visplane_t *pl, fixed_t alpha, bool additive, bool maske
 			}
 			else
 			{
-				spanfunc = R_DrawSpan;
+				spanfunc = planetiled ? R_DrawSpanTiledP_C : R_DrawSpan;
 			}
 		}
 	}
-	R_MapVisPlane (pl, R_MapPlane);
 }
 
 //==========================================================================
@@ -1737,10 +2176,24 @@ void R_DrawTiltedPlane (visplane_t *pl, fixed_t alpha, bool additive, bool maske
 //==========================================================================
 
 void R_MapVisPlane (visplane_t *pl, void (*mapfunc)(int y, int x1))
+{
+	R_MapVisPlaneRows (pl, mapfunc, 0, viewheight);
+}
+
+//==========================================================================
+//
+// R_MapVisPlaneRows
+//
+// Like R_MapVisPlane, but only maps the spans for rows [y1,y2). Threads
+// that work on different rows never touch the same part of spanend.
+//
+//==========================================================================
+
+void R_MapVisPlaneRows (visplane_t *pl, void (*mapfunc)(int y, int x1), int y1, int y2)
 {
 	int x = pl->maxx;
-	int t2 = pl->top[x];
-	int b2 = pl->bottom[x];
+	int t2 = clamp<int> (pl->top[x], y1, y2);
+	int b2 = clamp<int> (pl->bottom[x], y1, y2);
 
 	if (b2 > t2)
 	{
@@ -1749,8 +2202,8 @@ void R_MapVisPlane (visplane_t *pl, void (*mapfunc)(int y, int x1))
 
 	for (--x; x >= pl->minx; --x)
 	{
-		int t1 = pl->top[x];
-		int b1 = pl->bottom[x];
+		int t1 = clamp<int> (pl->top[x], y1, y2);
+		int b1 = clamp<int> (pl->bottom[x], y1, y2);
 		const int xr = x+1;
 		int stop;
 
@@ -1778,8 +2231,8 @@ void R_MapVisPlane (visplane_t *pl, void (*mapfunc)(int y, int x1))
 			spanend[--b1] = x;
 		}
 
-		t2 = pl->top[x];
-		b2 = pl->bottom[x];
+		t2 = clamp<int> (pl->top[x], y1, y2);
+		b2 = clamp<int> (pl->bottom[x], y1, y2);
 		basexfrac -= xstepscale;
 		baseyfrac -= ystepscale;
 	}
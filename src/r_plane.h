@@ -61,9 +61,12 @@ struct visplane_s
 	int CurrentMirror; // mirror counter, counts all of them
 	int MirrorFlags; // this is not related to CurrentMirror
 
-	unsigned short *bottom;			// [RH] bottom and top arrays are dynamically
-	unsigned short pad;				//		allocated immediately after the
-	unsigned short top[3];			//		visplane.
+	// The top and bottom arrays are indexed by screen column but only
+	// cover [left,right]. They are allocated from a pool that is emptied
+	// once per frame and get reallocated when the plane grows past them.
+	int			left, right;
+	unsigned short *top;
+	unsigned short *bottom;
 };
 typedef struct visplane_s visplane_t;
 
@@ -93,6 +96,7 @@ void R_DrawSkyPlane (visplane_t *pl);
 void R_DrawNormalPlane (visplane_t *pl, fixed_t alpha, bool additive, bool masked);
 void R_DrawTiltedPlane (visplane_t *pl, fixed_t alpha, bool additive, bool masked);
 void R_MapVisPlane (visplane_t *pl, void (*mapfunc)(int y, int x1));
+void R_MapVisPlaneRows (visplane_t *pl, void (*mapfunc)(int y, int x1), int y1, int y2);
 
 visplane_t *R_FindPlane
 ( const secplane_t &height,
@@ -852,8 +852,9 @@ void Polymost_Responder (event_t *ev)
 
 
 
-extern fixed_t WallSZ1, WallSZ2, WallTX1, WallTX2, WallTY1, WallTY2, WallCX1, WallCX2, WallCY1, WallCY2;
-extern int WallSX1, WallSX2;
+extern COLUMN_TLS fixed_t WallSZ1, WallSZ2;
+extern fixed_t WallTX1, WallTX2, WallTY1, WallTY2, WallCX1, WallCX2, WallCY1, WallCY2;
+extern COLUMN_TLS int WallSX1, WallSX2;
 extern float WallUoverZorg, WallUoverZstep, WallInvZorg, WallInvZstep, WallDepthScale, WallDepthOrg;
 extern fixed_t	rw_backcz1, rw_backcz2;
 extern fixed_t	rw_backfz1, rw_backfz2;
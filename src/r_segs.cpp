@@ -52,6 +52,7 @@
 #include "r_3dfloors.h"
 #include "v_palette.h"
 #include "r_data/colormaps.h"
+#include "r_drawqueue.h"
 
 #define WALLYREPEAT 8
 
@@ -90,16 +91,18 @@ int OWallMost (short *mostbuf, fixed_t z);
 int WallMost (short *mostbuf, const secplane_t &plane);
 void PrepWall (fixed_t *swall, fixed_t *lwall, fixed_t walxrepeat);
 void PrepLWall (fixed_t *lwall, fixed_t walxrepeat);
-extern fixed_t WallSZ1, WallSZ2, WallTX1, WallTX2, WallTY1, WallTY2, WallCX1, WallCX2, WallCY1, WallCY2;
-extern int WallSX1, WallSX2;
+extern COLUMN_TLS fixed_t WallSZ1, WallSZ2;
+extern fixed_t WallTX1, WallTX2, WallTY1, WallTY2, WallCX1, WallCX2, WallCY1, WallCY2;
+extern COLUMN_TLS int WallSX1, WallSX2;
+extern cycle_t WallScanCycles;
 extern float WallUoverZorg, WallUoverZstep, WallInvZorg, WallInvZstep, WallDepthScale, WallDepthOrg;
 
-int		wallshade;
+COLUMN_TLS int		wallshade;
 
 short	walltop[MAXWIDTH];	// [RH] record max extents of wall
 short	wallbottom[MAXWIDTH];
-short	wallupper[MAXWIDTH];
-short	walllower[MAXWIDTH];
+COLUMN_TLS short	wallupper[MAXWIDTH];
+COLUMN_TLS short	walllower[MAXWIDTH];
 fixed_t	swall[MAXWIDTH];
 fixed_t	lwall[MAXWIDTH];
 fixed_t	lwallscale;
@@ -119,8 +122,8 @@ bool			rw_markmirror;
 bool			rw_havehigh;
 bool			rw_havelow;
 
-fixed_t			rw_light;		// [RH] Scale lights with viewsize adjustments
-fixed_t			rw_lightstep;
+COLUMN_TLS fixed_t	rw_light;		// [RH] Scale lights with viewsize adjustments
+COLUMN_TLS fixed_t	rw_lightstep;
 fixed_t			rw_lightleft;
 
 static fixed_t	rw_frontlowertop;
@@ -128,7 +131,7 @@ static fixed_t	rw_frontlowertop;
 static int		rw_x;
 static int		rw_stopx;
 fixed_t			rw_offset;
-static fixed_t	rw_scalestep;
+static COLUMN_TLS fixed_t	rw_scalestep;
 static fixed_t	rw_midtexturemid;
 static fixed_t	rw_toptexturemid;
 static fixed_t	rw_bottomtexturemid;
@@ -141,7 +144,7 @@ static fixed_t	rw_bottomtexturescaley;
 
 FTexture		*rw_pic;
 
-static fixed_t	*maskedtexturecol;
+static COLUMN_TLS fixed_t	*maskedtexturecol;
 static FTexture	*WallSpriteTile;
 
 static void R_RenderDecal (side_t *wall, DBaseDecal *first, drawseg_t *clipper, int pass);
@@ -179,8 +182,8 @@ CVAR(Bool, r_drawmirrors, true, 0)
 //
 // R_RenderMaskedSegRange
 //
-fixed_t *MaskedSWall;
-fixed_t MaskedScaleY;
+COLUMN_TLS fixed_t *MaskedSWall;
+COLUMN_TLS fixed_t MaskedScaleY;
 
 static void BlastMaskedColumn (void (*blastfunc)(const BYTE *pixels, const FTexture::Span *spans), FTexture *tex)
 {
@@ -260,7 +263,10 @@ void R_RenderMaskedSegRange (drawseg_t *ds, int x1, int x2)
 		return;
 	}
 
-	NetUpdate ();
+	if (!MaskedThreadsActive)
+	{
+		NetUpdate ();
+	}
 
 	frontsector = curline->frontsector;
 	backsector = curline->backsector;
@@ -284,11 +290,9 @@ void R_RenderMaskedSegRange (drawseg_t *ds, int x1, int x2)
 	{
 		for (i = frontsector->e->XFloor.lightlist.Size() - 1; i >= 0; i--)
 		{
-			if (!(fake3D & FAKE3D_CLIPTOP))
-			{
-				sclipTop = sec->ceilingplane.ZatPoint(viewx, viewy);
-			}
-			if (sclipTop <= frontsector->e->XFloor.lightlist[i].plane.ZatPoint(viewx, viewy))
+			fixed_t cliptop = (fake3D & FAKE3D_CLIPTOP) ? sclipTop : sec->ceilingplane.ZatPoint(viewx, viewy);
+
+			if (cliptop <= frontsector->e->XFloor.lightlist[i].plane.ZatPoint(viewx, viewy))
 			{
 				lightlist_t *lit = &frontsector->e->XFloor.lightlist[i];
 				basecolormap = lit->extra_colormap;
@@ -1048,7 +1052,7 @@ inline fixed_t prevline1 (fixed_t vince, BYTE *colormap, int count, fixed_t vplc
 	dc_texturefrac = vplce;
 	dc_source = bufplce;
 	dc_dest = dest;
-	return doprevline1 ();
+	return R_WallPrevline1 ();
 }
 
 void wallscan (int x1, int x2, short *uwal, short *dwal, fixed_t *swal, fixed_t *lwal,
@@ -1071,12 +1075,11 @@ void wallscan (int x1, int x2, short *uwal, short *dwal, fixed_t *swal, fixed_t
 		return;
 	}
 
-//extern cycle_t WallScanCycles;
-//clock (WallScanCycles);
+	WallScanCycles.Clock();
 
 	rw_pic->GetHeight();	// Make sure texture size is loaded
 	shiftval = rw_pic->HeightBits;
-	setupvline (32-shiftval);
+	R_SetupWallVline (32-shiftval, rw_pic);
 	yrepeat >>= 2 + shiftval;
 	texturemid = dc_texturemid << (16 - shiftval);
 	xoffset = rw_offset;
@@ -1114,7 +1117,7 @@ void wallscan (int x1, int x2, short *uwal, short *dwal, fixed_t *swal, fixed_t
 		dc_count = y2ve[0] - y1ve[0];
 		dc_texturefrac = texturemid + FixedMul (dc_iscale, (y1ve[0]<<FRACBITS)-centeryfrac+FRACUNIT);
 
-		dovline1();
+		R_WallVline1();
 	}
 
 	for(; x <= x2-3; x += 4)
@@ -1175,7 +1178,7 @@ void wallscan (int x1, int x2, short *uwal, short *dwal, fixed_t *swal, fixed_t
 		{
 			dc_count = d4-u4;
 			dc_dest = ylookup[u4]+x+dc_destorg;
-			dovline4();
+			R_WallVline4();
 		}
 
 		BYTE *i = x+ylookup[d4]+dc_destorg;
@@ -1207,10 +1210,10 @@ void wallscan (int x1, int x2, short *uwal, short *dwal, fixed_t *swal, fixed_t
 		dc_count = y2ve[0] - y1ve[0];
 		dc_texturefrac = texturemid + FixedMul (dc_iscale, (y1ve[0]<<FRACBITS)-centeryfrac+FRACUNIT);
 
-		dovline1();
+		R_WallVline1();
 	}
 
-//unclock (WallScanCycles);
+	WallScanCycles.Unclock();
 
 	NetUpdate ();
 }
@@ -2599,6 +2602,10 @@ void R_StoreWallRange (int start, int stop)
 	}
 
 	// [RH] Draw any decals bound to the seg
+	if (curline->sidedef->AttachedDecals != NULL)
+	{ // The wall must be on screen before they can be drawn on top of it.
+		R_FlushDrawQueue ();
+	}
 	for (DBaseDecal *decal = curline->sidedef->AttachedDecals; decal != NULL; decal = decal->WallNext)
 	{
 		R_RenderDecal (curline->sidedef, decal, ds_p, 0);
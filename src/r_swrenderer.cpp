@@ -98,6 +98,7 @@ void FSoftwareRenderer::PrecacheTexture(FTexture *tex, int cache)
 		else
 		{
 			tex->Unload ();
+			tex->Uncache ();
 		}
 	}
 }
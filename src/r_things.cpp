@@ -40,6 +40,7 @@
 #include "c_console.h"
 #include "c_cvars.h"
 #include "c_dispatch.h"
+#include "m_random.h"
 #include "doomstat.h"
 #include "v_video.h"
 #include "sc_man.h"
@@ -58,10 +59,12 @@
 #include "r_segs.h"
 #include "r_3dfloors.h"
 #include "v_palette.h"
+#include "v_text.h"
 #include "r_data/r_translate.h"
 #include "r_data/colormaps.h"
 #include "r_data/voxels.h"
 #include "p_local.h"
+#include "stats.h"
 
 // [RH] A c-buffer. Used for keeping track of offscreen voxel spans.
 
@@ -145,6 +148,10 @@ static vissprite_t **spritesorter;
 static int spritesortersize = 0;
 static int vsprcount;
 
+// Sprites hidden behind solid walls are rejected in R_ProjectSprite.
+CVAR (Bool, r_spriteocclusion, true, 0)
+static int SpritesTested, SpritesOccluded;
+
 
 void R_DeinitSprites()
 {
@@ -188,6 +195,7 @@ void R_ClearSprites (void)
 {
 	vissprite_p = firstvissprite;
 	DrewAVoxel = false;
+	SpritesTested = SpritesOccluded = 0;
 }
 
 
@@ -225,13 +233,21 @@ vissprite_t *R_NewVisSprite (void)
 // Masked means: partly transparent, i.e. stored
 //	in posts/runs of opaque pixels.
 //
-short*			mfloorclip;
-short*			mceilingclip;
+COLUMN_TLS short*		mfloorclip;
+COLUMN_TLS short*		mceilingclip;
+
+COLUMN_TLS fixed_t 		spryscale;
+COLUMN_TLS fixed_t 		sprtopscreen;
+
+COLUMN_TLS bool			sprflipvert;
 
-fixed_t 		spryscale;
-fixed_t 		sprtopscreen;
+// The columns this thread may draw to during the masked pass. Outside of
+// the threaded masked pass, that is the whole screen.
+static COLUMN_TLS int	MaskedBandLeft = 0;
+static COLUMN_TLS int	MaskedBandRight = MAXWIDTH - 1;
 
-bool			sprflipvert;
+// True while the masked pass is split across threads.
+bool			MaskedThreadsActive;
 
 void R_DrawMaskedColumn (const BYTE *column, const FTexture::Span *span)
 {
@@ -339,15 +355,19 @@ void R_DrawVisSprite (vissprite_t *vis)
 
 	if (mode != DontDraw)
 	{
+		// Only draw the part of the sprite inside this thread's band.
+		dc_x = MAX<int> (vis->x1, MaskedBandLeft);
+		x2 = MIN<int> (vis->x2, MaskedBandRight) + 1;
+
 		if (mode == DoDraw0)
 		{
 			// One column at a time
-			stop4 = vis->x1;
+			stop4 = dc_x;
 		}
 		else	 // DoDraw1
 		{
 			// Up to four columns at a time
-			stop4 = (vis->x2 + 1) & ~3;
+			stop4 = x2 & ~3;
 		}
 
 		tex = vis->pic;
@@ -355,14 +375,11 @@ void R_DrawVisSprite (vissprite_t *vis)
 		sprflipvert = false;
 		dc_iscale = 0xffffffffu / (unsigned)vis->yscale;
 		dc_texturemid = vis->texturemid;
-		frac = vis->startfrac;
 		xiscale = vis->xiscale;
+		frac = vis->startfrac + (dc_x - vis->x1) * xiscale;
 
 		sprtopscreen = centeryfrac - FixedMul (dc_texturemid, spryscale);
 
-		dc_x = vis->x1;
-		x2 = vis->x2 + 1;
-
 		if (dc_x < x2)
 		{
 			while ((dc_x < stop4) && (dc_x & 3))
@@ -398,7 +415,10 @@ void R_DrawVisSprite (vissprite_t *vis)
 
 	R_FinishSetPatchStyle ();
 
-	NetUpdate ();
+	if (!MaskedThreadsActive)
+	{
+		NetUpdate ();
+	}
 }
 
 void R_DrawVisVoxel(vissprite_t *spr, int minslabz, int maxslabz, short *cliptop, short *clipbot)
@@ -717,6 +737,17 @@ void R_ProjectSprite (AActor *thing, int fakeside, F3DFloor *fakefloor, F3DFloor
 		iscale = (tex->GetWidth() << FRACBITS) / (x2 - x1);
 		x2--;
 
+		// Skip sprites that are completely behind walls already drawn.
+		if (r_spriteocclusion)
+		{
+			SpritesTested++;
+			if (R_CheckSpriteOccluded (MAX (x1, WindowLeft), MIN (x2, WindowRight), tz))
+			{
+				SpritesOccluded++;
+				return;
+			}
+		}
+
 		fixed_t yscale = SafeDivScale16(spritescaleY, tex->yScale);
 
 		// store information in a vissprite
@@ -1491,6 +1522,119 @@ static void swap(vissprite_t *&a, vissprite_t *&b)
 }
 #endif
 
+//==========================================================================
+//
+// R_RadixSortSprites
+//
+// Stable LSD radix sort of a sprite list by the matching keys, smallest key
+// first, one byte per pass. A pass is skipped when every key has the same
+// byte in it, which for depth keys is usually the case for the high bytes.
+// Because the sort is stable, the result is exactly what std::stable_sort
+// produces for a comparison that orders the same way as the keys.
+//
+//==========================================================================
+
+CVAR (Bool, r_radixsort, true, 0)
+
+static TArray<DWORD> SpriteKeys32[2];
+static TArray<QWORD> SpriteKeys64[2];
+static TArray<vissprite_t *> SpriteSortTemp;
+
+template<class KeyType>
+static void R_RadixSortSprites (KeyType *keys, KeyType *tempkeys, vissprite_t **sprites, int count)
+{
+	vissprite_t **const out = sprites;
+	vissprite_t **temp;
+	unsigned int counts[256];
+	int i;
+
+	if ((int)SpriteSortTemp.Size() < count)
+	{
+		SpriteSortTemp.Resize(count);
+	}
+	temp = &SpriteSortTemp[0];
+
+	for (unsigned int shift = 0; shift < sizeof(KeyType)*8; shift += 8)
+	{
+		memset (counts, 0, sizeof(counts));
+		for (i = 0; i < count; ++i)
+		{
+			counts[(keys[i] >> shift) & 255]++;
+		}
+		if (counts[(keys[0] >> shift) & 255] == (unsigned)count)
+		{
+			continue;
+		}
+		unsigned int total = 0;
+		for (i = 0; i < 256; ++i)
+		{
+			unsigned int c = counts[i];
+			counts[i] = total;
+			total += c;
+		}
+		for (i = 0; i < count; ++i)
+		{
+			unsigned int pos = counts[(keys[i] >> shift) & 255]++;
+			tempkeys[pos] = keys[i];
+			temp[pos] = sprites[i];
+		}
+		swapvalues (keys, tempkeys);
+		swapvalues (sprites, temp);
+	}
+	if (sprites != out)
+	{
+		memcpy (out, sprites, count * sizeof(*out));
+	}
+}
+
+//==========================================================================
+//
+// R_SortSpriteList
+//
+// Sorts a list of sprites with one of the two comparisons above. The radix
+// path builds keys that order the same way: inverted, sign-flipped depth
+// for sv_compare, and the bit pattern of the (never negative) squared
+// distance for sv_compare2d.
+//
+//==========================================================================
+
+static void R_SortSpriteList (vissprite_t **sprites, int count, bool (*compare)(vissprite_t *, vissprite_t *), bool radix)
+{
+	int i;
+
+	if (count < 2)
+	{
+		return;
+	}
+	if (radix && compare == sv_compare)
+	{
+		SpriteKeys32[0].Resize(count);
+		SpriteKeys32[1].Resize(count);
+		DWORD *keys = &SpriteKeys32[0][0];
+		for (i = 0; i < count; ++i)
+		{
+			keys[i] = ~(DWORD(sprites[i]->idepth) ^ 0x80000000u);
+		}
+		R_RadixSortSprites (keys, &SpriteKeys32[1][0], sprites, count);
+	}
+	else if (radix && compare == sv_compare2d)
+	{
+		SpriteKeys64[0].Resize(count);
+		SpriteKeys64[1].Resize(count);
+		QWORD *keys = &SpriteKeys64[0][0];
+		for (i = 0; i < count; ++i)
+		{
+			double dist = TVector2<double>(sprites[i]->deltax, sprites[i]->deltay).LengthSquared();
+			memcpy (&keys[i], &dist, sizeof(QWORD));
+		}
+		R_RadixSortSprites (keys, &SpriteKeys64[1][0], sprites, count);
+	}
+	else
+	{
+		std::stable_sort(&sprites[0], &sprites[count], compare);
+	}
+}
+
 void R_SortVisSprites (bool (*compare)(vissprite_t *, vissprite_t *), size_t first)
 {
 	int i;
@@ -1527,26 +1671,196 @@ void R_SortVisSprites (bool (*compare)(vissprite_t *, vissprite_t *), size_t fir
 		}
 	}
 
-	std::stable_sort(&spritesorter[0], &spritesorter[vsprcount], compare);
+	R_SortSpriteList (spritesorter, vsprcount, compare, r_radixsort);
+}
+
+//==========================================================================
+//
+// CCMD r_sortbench
+//
+// Times the comparison sort against the radix sort on random sprite lists
+// and checks that both produce the same draw order.
+//
+//==========================================================================
+
+static FRandom pr_sortbench ("SortBench");
+
+CCMD (r_sortbench)
+{
+	int count = argv.argc() > 1 ? atoi(argv[1]) : 1000;
+	int runs = argv.argc() > 2 ? atoi(argv[2]) : 100;
+	int i, j, pass;
+
+	if (count < 2 || runs < 1)
+	{
+		Printf ("Usage: r_sortbench [sprites] [runs]\n");
+		return;
+	}
+
+	TArray<vissprite_t> sprites;
+	TArray<vissprite_t *> list, sorted[2];
+	sprites.Resize(count);
+	list.Resize(count);
+	sorted[0].Resize(count);
+	sorted[1].Resize(count);
+
+	for (pass = 0; pass < 2; ++pass)
+	{
+		bool (*compare)(vissprite_t *, vissprite_t *) = pass == 0 ? sv_compare : sv_compare2d;
+		cycle_t times[2];
+		bool same = true;
+
+		times[0].Reset();
+		times[1].Reset();
+		for (j = 0; j < runs; ++j)
+		{
+			// Keep the depth range small enough that ties are common, since
+			// those are where an unstable sort would give itself away.
+			for (i = 0; i < count; ++i)
+			{
+				sprites[i].idepth = (pr_sortbench() << 8) | (pr_sortbench() & 0xF0);
+				sprites[i].deltax = (pr_sortbench() - 128) << 20;
+				sprites[i].deltay = (pr_sortbench() - 128) << 20;
+				list[i] = &sprites[i];
+			}
+			for (i = 0; i < 2; ++i)
+			{
+				memcpy (&sorted[i][0], &list[0], count * sizeof(vissprite_t *));
+				times[i].Clock();
+				R_SortSpriteList (&sorted[i][0], count, compare, i == 1);
+				times[i].Unclock();
+			}
+			if (memcmp (&sorted[0][0], &sorted[1][0], count * sizeof(vissprite_t *)) != 0)
+			{
+				same = false;
+			}
+		}
+		double sortms = times[0].TimeMS() / runs;
+		double radixms = times[1].TimeMS() / runs;
+		Printf ("%s: %d sprites, stable_sort %.4f ms, radix %.4f ms (%.2fx)%s\n",
+			pass == 0 ? "depth" : "2D distance", count, sortms, radixms,
+			radixms > 0 ? sortms / radixms : 0., same ? "" : TEXTCOLOR_RED " ORDER DIFFERS");
+	}
 }
 
 
 //
 // R_DrawSprite
 //
+//==========================================================================
+//
+// R_GetSpriteLightListColormap
+//
+// Returns the colormap for a sprite in a sector with a 3D floor light
+// list, or NULL if it keeps the one it was projected with.
+//
+//==========================================================================
+
+static lighttable_t *R_GetSpriteLightListColormap (vissprite_t *spr)
+{
+	F3DFloor *rover;
+	FDynamicColormap *mybasecolormap;
+	sector_t *sec = NULL;
+	fixed_t cliptop;
+	int i;
+
+	if (fixedcolormap || fixedlightlev >= 0 || spr->sector->e == NULL || spr->sector->e->XFloor.lightlist.Size() == 0)
+	{
+		return NULL;
+	}
+	if (fake3D & FAKE3D_CLIPTOP)
+	{
+		cliptop = sclipTop;
+	}
+	else
+	{
+		cliptop = spr->sector->ceilingplane.ZatPoint(viewx, viewy);
+	}
+	for (i = spr->sector->e->XFloor.lightlist.Size() - 1; i >= 0; i--)
+	{
+		if (cliptop <= spr->sector->e->XFloor.lightlist[i].plane.Zat0()) 
+		{
+			rover = spr->sector->e->XFloor.lightlist[i].caster;
+			if (rover) 
+			{
+				if (rover->flags & FF_DOUBLESHADOW && cliptop <= rover->bottom.plane->Zat0())
+				{
+					break;
+				}
+				sec = rover->model;
+				if (rover->flags & FF_FADEWALLS)
+				{
+					mybasecolormap = sec->ColorMap;
+				}
+				else
+				{
+					mybasecolormap = spr->sector->e->XFloor.lightlist[i].extra_colormap;
+				}
+			}
+			break;
+		}
+	}
+	if (sec == NULL)
+	{
+		return NULL;
+	}
+
+	// found new values, recalculate
+	INTBOOL invertcolormap = (spr->Style.RenderStyle.Flags & STYLEF_InvertOverlay);
+
+	if (spr->Style.RenderStyle.Flags & STYLEF_InvertSource)
+	{
+		invertcolormap = !invertcolormap;
+	}
+
+	// Sprites that are added to the scene must fade to black.
+	if (spr->Style.RenderStyle == LegacyRenderStyles[STYLE_Add] && mybasecolormap->Fade != 0)
+	{
+		mybasecolormap = GetSpecialLights(mybasecolormap->Color, 0, mybasecolormap->Desaturate);
+	}
+
+	if (spr->Style.RenderStyle.Flags & STYLEF_FadeToBlack)
+	{
+		if (invertcolormap)
+		{ // Fade to white
+			mybasecolormap = GetSpecialLights(mybasecolormap->Color, MAKERGB(255,255,255), mybasecolormap->Desaturate);
+			invertcolormap = false;
+		}
+		else
+		{ // Fade to black
+			mybasecolormap = GetSpecialLights(mybasecolormap->Color, MAKERGB(0,0,0), mybasecolormap->Desaturate);
+		}
+	}
+
+	// get light level
+	if (invertcolormap)
+	{
+		mybasecolormap = GetSpecialLights(mybasecolormap->Color, mybasecolormap->Fade.InverseColor(), mybasecolormap->Desaturate);
+	}
+	if (!foggy && (spr->renderflags & RF_FULLBRIGHT))
+	{ // full bright
+		return mybasecolormap->Maps;
+	}
+	else
+	{ // diminished light
+		int shade = LIGHT2SHADE(sec->lightlevel + r_actualextralight);
+		return mybasecolormap->Maps + (GETPALOOKUP (
+			(fixed_t)DivScale12 (r_SpriteVisibility, spr->depth), shade) << COLORMAPSHIFT);
+	}
+}
+
 void R_DrawSprite (vissprite_t *spr)
 {
+	// Shared by the masked pass threads, since each only uses its own band.
 	static short clipbot[MAXWIDTH];
 	static short cliptop[MAXWIDTH];
+	vissprite_t litspr;
 	drawseg_t *ds;
 	int i;
 	int x1, x2;
 	int r1, r2;
 	short topclip, botclip;
 	short *clip1, *clip2;
-	lighttable_t *colormap = spr->Style.colormap;
-	F3DFloor *rover;
-	FDynamicColormap *mybasecolormap;
 
 	// [RH] Check for particles
 	if (!spr->bIsVoxel && spr->pic == NULL)
@@ -1558,8 +1872,8 @@ void R_DrawSprite (vissprite_t *spr)
 		return;
 	}
 
-	x1 = spr->x1;
-	x2 = spr->x2;
+	x1 = MAX<int> (spr->x1, MaskedBandLeft);
+	x2 = MIN<int> (spr->x2, MaskedBandRight);
 
 	// [RH] Quickly reject sprites with bad x ranges.
 	if (x1 > x2)
@@ -1574,86 +1888,12 @@ void R_DrawSprite (vissprite_t *spr)
 	if ((fake3D & FAKE3D_CLIPTOP)    && spr->gzb >= sclipTop) return;
 
 	// kg3D - correct colors now
-	if (!fixedcolormap && fixedlightlev < 0 && spr->sector->e && spr->sector->e->XFloor.lightlist.Size()) 
-	{
-		if (!(fake3D & FAKE3D_CLIPTOP))
-		{
-			sclipTop = spr->sector->ceilingplane.ZatPoint(viewx, viewy);
-		}
-		sector_t *sec = NULL;
-		for (i = spr->sector->e->XFloor.lightlist.Size() - 1; i >= 0; i--)
-		{
-			if (sclipTop <= spr->sector->e->XFloor.lightlist[i].plane.Zat0()) 
-			{
-				rover = spr->sector->e->XFloor.lightlist[i].caster;
-				if (rover) 
-				{
-					if (rover->flags & FF_DOUBLESHADOW && sclipTop <= rover->bottom.plane->Zat0())
-					{
-						break;
-					}
-					sec = rover->model;
-					if (rover->flags & FF_FADEWALLS)
-					{
-						mybasecolormap = sec->ColorMap;
-					}
-					else
-					{
-						mybasecolormap = spr->sector->e->XFloor.lightlist[i].extra_colormap;
-					}
-				}
-				break;
-			}
-		}
-		// found new values, recalculate
-		if (sec) 
-		{
-			INTBOOL invertcolormap = (spr->Style.RenderStyle.Flags & STYLEF_InvertOverlay);
-
-			if (spr->Style.RenderStyle.Flags & STYLEF_InvertSource)
-			{
-				invertcolormap = !invertcolormap;
-			}
-
-			// Sprites that are added to the scene must fade to black.
-			if (spr->Style.RenderStyle == LegacyRenderStyles[STYLE_Add] && mybasecolormap->Fade != 0)
-			{
-				mybasecolormap = GetSpecialLights(mybasecolormap->Color, 0, mybasecolormap->Desaturate);
-			}
-
-			if (spr->Style.RenderStyle.Flags & STYLEF_FadeToBlack)
-			{
-				if (invertcolormap)
-				{ // Fade to white
-					mybasecolormap = GetSpecialLights(mybasecolormap->Color, MAKERGB(255,255,255), mybasecolormap->Desaturate);
-					invertcolormap = false;
-				}
-				else
-				{ // Fade to black
-					mybasecolormap = GetSpecialLights(mybasecolormap->Color, MAKERGB(0,0,0), mybasecolormap->Desaturate);
-				}
-			}
-
-			// get light level
-			if (invertcolormap)
-			{
-				mybasecolormap = GetSpecialLights(mybasecolormap->Color, mybasecolormap->Fade.InverseColor(), mybasecolormap->Desaturate);
-			}
-			if (fixedlightlev >= 0)
-			{
-				spr->Style.colormap = mybasecolormap->Maps + fixedlightlev;
-			}
-			else if (!foggy && (spr->renderflags & RF_FULLBRIGHT))
-			{ // full bright
-				spr->Style.colormap = mybasecolormap->Maps;
-			}
-			else
-			{ // diminished light
-				spriteshade = LIGHT2SHADE(sec->lightlevel + r_actualextralight);
-				spr->Style.colormap = mybasecolormap->Maps + (GETPALOOKUP (
-					(fixed_t)DivScale12 (r_SpriteVisibility, spr->depth), spriteshade) << COLORMAPSHIFT);
-			}
-		}
+	lighttable_t *litmap = R_GetSpriteLightListColormap (spr);
+	if (litmap != NULL)
+	{ // Draw a relit copy, so the vissprite itself is left alone.
+		litspr = *spr;
+		litspr.Style.colormap = litmap;
+		spr = &litspr;
 	}
 
 	// [RH] Initialize the clipping arrays to their largest possible range
@@ -1801,7 +2041,6 @@ void R_DrawSprite (vissprite_t *spr)
 
 	if (topclip >= botclip)
 	{
-		spr->Style.colormap = colormap;
 		return;
 	}
 
@@ -1915,7 +2154,6 @@ void R_DrawSprite (vissprite_t *spr)
 			}
 			if (i == x2)
 			{
-				spr->Style.colormap = colormap;
 				return;
 			}
 		}
@@ -1933,7 +2171,6 @@ void R_DrawSprite (vissprite_t *spr)
 		int maxvoxely = spr->gzb > hzb ? INT_MAX : (spr->gzt - hzb) / spr->yscale;
 		R_DrawVisVoxel(spr, minvoxely, maxvoxely, cliptop, clipbot);
 	}
-	spr->Style.colormap = colormap;
 }
 
 // kg3D:
@@ -1972,20 +2209,221 @@ void R_DrawMaskedSingle (bool renew)
 		if (ds->fake) continue;
 		if (ds->maskedtexturecol != -1 || ds->bFogBoundary)
 		{
-			R_RenderMaskedSegRange (ds, ds->x1, ds->x2);
+			int x1 = MAX<int> (ds->x1, MaskedBandLeft);
+			int x2 = MIN<int> (ds->x2, MaskedBandRight);
+
+			if (x1 <= x2)
+			{
+				R_RenderMaskedSegRange (ds, x1, x2);
+			}
 		}
 	}
 }
 
+//==========================================================================
+//
+// Threaded masked pass
+//
+// With r_threads above 1, the masked pass can be split into bands of
+// columns. Every band walks the same back-to-front list of sprites and
+// drawsegs but clips them to its own columns, so no two threads ever touch
+// the same pixels and the order within each column does not change.
+//
+//==========================================================================
+
+CVAR (Bool, r_threadedmasked, true, 0)
+EXTERN_CVAR (Int, r_threads)
+
+static int NumMaskedBands;
+static cycle_t MaskedThreadCycles[FThreadPool::MAX_THREADS];
+static int MaskedThreadsUsed;
+static FDynamicColormap *MaskedBaseColormap;
+
+//==========================================================================
+//
+// R_PrepareMaskedTexture
+//
+// Makes sure the texture's pixels and spans exist and that it is marked
+// as used for the texture cache, so that the band threads only ever read
+// them.
+//
+//==========================================================================
+
+static void R_PrepareMaskedTexture (FTexture *tex)
+{
+	const FTexture::Span *spans;
+
+	tex->GetColumn (0, &spans);
+}
+
+//==========================================================================
+//
+// R_PrepareThreadedMasked
+//
+// Returns true if this scene's masked pass can be split into bands. Voxels,
+// 3D floors and mid textures that tile vertically go through code with
+// more shared state, so scenes with any of them stay on the main thread.
+// Anything the band threads would otherwise have to create on demand is
+// created here.
+//
+//==========================================================================
+
+static bool R_PrepareThreadedMasked ()
+{
+#ifndef COLUMN_THREADS
+	return false;
+#else
+	drawseg_t *ds;
+	int i;
+
+	if (!r_threadedmasked || r_threads < 2 || viewwidth < 16 || DrewAVoxel || height_top != NULL)
+	{
+		return false;
+	}
+	for (ds = firstdrawseg; ds < ds_p; ++ds)
+	{
+		if (ds->fake)
+		{
+			continue;
+		}
+		if (ds->bFakeBoundary)
+		{
+			return false;
+		}
+		if (ds->maskedtexturecol != -1 &&
+			((ds->curline->linedef->flags & ML_WRAP_MIDTEX) ||
+			 (ds->curline->sidedef->Flags & WALLF_WRAP_MIDTEX)))
+		{
+			return false;
+		}
+	}
+	for (ds = firstdrawseg; ds < ds_p; ++ds)
+	{
+		if (!ds->fake && ds->maskedtexturecol != -1)
+		{
+			FTexture *tex = TexMan(ds->curline->sidedef->GetTexture(side_t::mid), true);
+			if (i_compatflags & COMPATF_MASKEDMIDTEX)
+			{
+				tex = tex->GetRawTexture();
+			}
+			R_PrepareMaskedTexture (tex);
+		}
+	}
+	for (i = 0; i < vsprcount; ++i)
+	{
+		vissprite_t *spr = spritesorter[i];
+
+		if (spr->pic != NULL && spr->sector != NULL)
+		{
+			R_PrepareMaskedTexture (spr->pic);
+			// Any colormaps the light list needs get created now.
+			R_GetSpriteLightListColormap (spr);
+		}
+	}
+	return true;
+#endif
+}
+
+//==========================================================================
+//
+// R_DrawMaskedBand
+//
+// Thread pool job: draws one band of the masked pass.
+//
+//==========================================================================
+
+static void R_DrawMaskedBand (void *userdata, int slice, int thread)
+{
+	MaskedThreadCycles[thread].Clock();
+	// Keep the bands a multiple of four wide, so the four-column drawers
+	// group the columns the same way as when drawing on one thread.
+	MaskedBandLeft = (viewwidth * slice / NumMaskedBands) & ~3;
+	if (slice == NumMaskedBands - 1)
+	{
+		MaskedBandRight = viewwidth - 1;
+	}
+	else
+	{
+		MaskedBandRight = ((viewwidth * (slice + 1) / NumMaskedBands) & ~3) - 1;
+	}
+	basecolormap = MaskedBaseColormap;
+	R_DrawMaskedSingle (false);
+	MaskedThreadCycles[thread].Unclock();
+}
+
+//==========================================================================
+//
+// R_DrawThreadedMasked
+//
+//==========================================================================
+
+static void R_DrawThreadedMasked ()
+{
+	int i;
+
+	NumMaskedBands = MIN<int> (r_threads, viewwidth / 8);
+	ThreadPool.Reserve (NumMaskedBands);
+	MaskedThreadsUsed = MIN (NumMaskedBands, ThreadPool.GetThreadCount());
+	for (i = 0; i < MaskedThreadsUsed; ++i)
+	{
+		MaskedThreadCycles[i].Reset();
+	}
+	MaskedBaseColormap = basecolormap;
+	MaskedThreadsActive = true;
+	FTexture::CacheFrozen = true;
+	ThreadPool.Run (R_DrawMaskedBand, NULL, NumMaskedBands);
+	FTexture::CacheFrozen = false;
+	MaskedThreadsActive = false;
+	MaskedBandLeft = 0;
+	MaskedBandRight = MAXWIDTH - 1;
+	NetUpdate ();
+}
+
+ADD_STAT(spriteocclusion)
+{
+	FString out;
+
+	out.Format ("%d of %d sprites occluded", SpritesOccluded, SpritesTested);
+	return out;
+}
+
+ADD_STAT(maskedthreads)
+{
+	FString out;
+
+	if (MaskedThreadsUsed == 0)
+	{
+		out = "the masked pass is drawn on the main thread";
+	}
+	else
+	{
+		out.Format ("%d bands:", NumMaskedBands);
+		for (int i = 0; i < MaskedThreadsUsed; ++i)
+		{
+			out.AppendFormat (" %04.1f", MaskedThreadCycles[i].TimeMS());
+		}
+		out += " ms";
+	}
+	return out;
+}
+
 void R_DrawHeightPlanes(fixed_t height); // kg3D - fake planes
 
 void R_DrawMasked (void)
 {
 	R_SortVisSprites (DrewAVoxel ? sv_compare2d : sv_compare, firstvissprite - vissprites);
 
+	MaskedThreadsUsed = 0;
 	if (height_top == NULL)
 	{ // kg3D - no visible 3D floors, normal rendering
-		R_DrawMaskedSingle(false);
+		if (R_PrepareThreadedMasked ())
+		{
+			R_DrawThreadedMasked ();
+		}
+		else
+		{
+			R_DrawMaskedSingle(false);
+		}
 	}
 	else
 	{ // kg3D - correct sorting
@@ -2211,7 +2649,13 @@ static void R_DrawMaskedSegsBehindParticle (const vissprite_t *vis)
 		}
 		if (Scale (ds->siz2 - ds->siz1, (x2 + x1)/2 - ds->sx1, ds->sx2 - ds->sx1) + ds->siz1 < vis->idepth)
 		{
-			R_RenderMaskedSegRange (ds, MAX<int> (ds->x1, x1), MIN<int> (ds->x2, x2-1));
+			int r1 = MAX<int> (MAX<int> (ds->x1, x1), MaskedBandLeft);
+			int r2 = MIN<int> (MIN<int> (ds->x2, x2-1), MaskedBandRight);
+
+			if (r1 <= r2)
+			{
+				R_RenderMaskedSegRange (ds, r1, r2);
+			}
 		}
 	}
 }
@@ -2225,11 +2669,16 @@ void R_DrawParticle (vissprite_t *vis)
 	BYTE color = vis->Style.colormap[vis->startfrac];
 	int yl = vis->gzb;
 	int ycount = vis->gzt - yl + 1;
-	int x1 = vis->x1;
-	int countbase = vis->x2 - x1 + 1;
+	int x1 = MAX<int> (vis->x1, MaskedBandLeft);
+	int countbase = MIN<int> (vis->x2, MaskedBandRight) - x1 + 1;
 
 	R_DrawMaskedSegsBehindParticle (vis);
 
+	if (countbase <= 0)
+	{
+		return;
+	}
+
 	// vis->renderflags holds translucency level (0-255)
 	{
 		fixed_t fglevel, bglevel;
@@ -89,22 +89,24 @@ extern short			zeroarray[MAXWIDTH];
 extern short			screenheightarray[MAXWIDTH];
 
 // vars for R_DrawMaskedColumn
-extern short*			mfloorclip;
-extern short*			mceilingclip;
-extern fixed_t			spryscale;
-extern fixed_t			sprtopscreen;
-extern bool				sprflipvert;
+extern COLUMN_TLS short*		mfloorclip;
+extern COLUMN_TLS short*		mceilingclip;
+extern COLUMN_TLS fixed_t		spryscale;
+extern COLUMN_TLS fixed_t		sprtopscreen;
+extern COLUMN_TLS bool			sprflipvert;
 
 extern fixed_t			pspritexscale;
 extern fixed_t			pspriteyscale;
 extern fixed_t			pspritexiscale;
 
 
+extern bool				MaskedThreadsActive;
+
 void R_DrawMaskedColumn (const BYTE *column, const FTexture::Span *spans);
 
 
 void R_CacheSprite (spritedef_t *sprite);
-void R_SortVisSprites (int (STACK_ARGS *compare)(const void *, const void *), size_t first);
+void R_SortVisSprites (bool (*compare)(vissprite_t *, vissprite_t *), size_t first);
 void R_AddSprites (sector_t *sec, int lightlevel, int fakeside);
 void R_AddPSprites ();
 void R_DrawSprites ();
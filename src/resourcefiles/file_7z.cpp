@@ -48,6 +48,8 @@ extern "C" {
 #include "7zCrc.h"
 }
 
+#define SEVENZIPCACHE_ID	MAKE_ID('7','Z','0','1')
+
 
 //-----------------------------------------------------------------------
 //
@@ -192,6 +194,10 @@ class F7ZFile : public FResourceFile
 
 	static int STACK_ARGS lumpcmp(const void * a, const void * b);
 
+	bool OpenArchive(bool quiet);
+	bool ReadDirectoryCache(FDirectoryCache &cache);
+	void WriteDirectoryCache();
+
 public:
 	F7ZFile(const char * filename, FileReader *filer);
 	bool Open(bool quiet);
@@ -226,16 +232,16 @@ F7ZFile::F7ZFile(const char * filename, FileReader *filer)
 
 //==========================================================================
 //
-// Open it
+// Reads the archive's headers. When the lump list came from the directory
+// cache, this is put off until the first lump is read.
 //
 //==========================================================================
 
-bool F7ZFile::Open(bool quiet)
+bool F7ZFile::OpenArchive(bool quiet)
 {
-	Archive = new C7zArchive(Reader);
-	int skipped = 0;
 	SRes res;
 
+	Archive = new C7zArchive(Reader);
 	res = Archive->Open();
 	if (res != SZ_OK)
 	{
@@ -263,6 +269,29 @@ bool F7ZFile::Open(bool quiet)
 		}
 		return false;
 	}
+	return true;
+}
+
+//==========================================================================
+//
+// Open it
+//
+//==========================================================================
+
+bool F7ZFile::Open(bool quiet)
+{
+	FDirectoryCache cache;
+	int skipped = 0;
+
+	if (cache.Load(Filename, SEVENZIPCACHE_ID) && ReadDirectoryCache(cache))
+	{
+		if (!quiet) Printf(", %d lumps\n", NumLumps);
+		return true;
+	}
+	if (!OpenArchive(quiet))
+	{
+		return false;
+	}
 	NumLumps = Archive->DB.db.NumFiles;
 
 	Lumps = new F7ZLump[NumLumps];
@@ -297,9 +326,88 @@ bool F7ZFile::Open(bool quiet)
 
 	// Entries in archives are sorted alphabetically
 	qsort(&Lumps[0], NumLumps, sizeof(F7ZLump), lumpcmp);
+	WriteDirectoryCache();
+	return true;
+}
+
+//==========================================================================
+//
+// Directory cache
+//
+// Stores the finished lump list. Besides the file's size and time, the
+// start header, which locates and checksums the archive's own headers,
+// must still be unchanged.
+//
+//==========================================================================
+
+bool F7ZFile::ReadDirectoryCache(FDirectoryCache &cache)
+{
+	BYTE cached[k7zStartHeaderSize], header[k7zStartHeaderSize];
+
+	cache.ReadBlock(cached, sizeof(cached));
+	if (cache.Failed() ||
+		Reader->Seek(0, SEEK_SET) != 0 ||
+		Reader->Read(header, sizeof(header)) != sizeof(header) ||
+		memcmp(header, cached, sizeof(header)) != 0)
+	{
+		return false;
+	}
+
+	DWORD count = cache.ReadLong();
+	if (cache.Failed() || count > 0xFFFFFF)	// sanity check before allocating
+	{
+		return false;
+	}
+	Lumps = new F7ZLump[count];
+	for (DWORD i = 0; i < count; ++i)
+	{
+		F7ZLump *lump_p = &Lumps[i];
+
+		lump_p->FullName = copystring(cache.ReadString());
+		cache.ReadBlock(lump_p->Name, 8);
+		lump_p->Name[8] = 0;
+		lump_p->Namespace = (int)cache.ReadLong();
+		lump_p->LumpSize = cache.ReadLong();
+		lump_p->Flags = cache.ReadByte();
+		lump_p->Position = cache.ReadLong();
+		lump_p->Owner = this;
+	}
+	if (cache.Failed())
+	{
+		delete[] Lumps;
+		Lumps = NULL;
+		return false;
+	}
+	NumLumps = count;
 	return true;
 }
 
+void F7ZFile::WriteDirectoryCache()
+{
+	FDirectoryCache cache;
+	BYTE header[k7zStartHeaderSize];
+
+	if (Reader->Seek(0, SEEK_SET) != 0 ||
+		Reader->Read(header, sizeof(header)) != sizeof(header))
+	{
+		return;
+	}
+	cache.WriteBlock(header, sizeof(header));
+	cache.WriteLong(NumLumps);
+	for (DWORD i = 0; i < NumLumps; ++i)
+	{
+		F7ZLump *lump_p = &Lumps[i];
+
+		cache.WriteString(lump_p->FullName);
+		cache.WriteBlock(lump_p->Name, 8);
+		cache.WriteLong(lump_p->Namespace);
+		cache.WriteLong(lump_p->LumpSize);
+		cache.WriteByte(lump_p->Flags);
+		cache.WriteLong(lump_p->Position);
+	}
+	cache.Save(Filename, SEVENZIPCACHE_ID);
+}
+
 //==========================================================================
 //
 // 
@@ -326,8 +434,17 @@ F7ZFile::~F7ZFile()
 
 int F7ZLump::FillCache()
 {
+	F7ZFile *file = static_cast<F7ZFile*>(Owner);
+
 	Cache = new char[LumpSize];
-	static_cast<F7ZFile*>(Owner)->Archive->Extract(Position, Cache);
+	if (file->Archive == NULL && !file->OpenArchive(false))
+	{
+		memset(Cache, 0, LumpSize);
+	}
+	else
+	{
+		file->Archive->Extract(Position, Cache);
+	}
 	RefCount = 1;
 	return 1;
 }
@@ -250,12 +250,12 @@ public:
 	{
 		if(!Compressed)
 		{
-			const char * buffer = Owner->Reader->GetBuffer();
+			const char * buffer = Owner->Reader->GetBufferAt(Position, LumpSize);
 
 			if (buffer != NULL)
 			{
 				// This is an in-memory file so the cache can point directly to the file's data.
-				Cache = const_cast<char*>(buffer) + Position;
+				Cache = const_cast<char*>(buffer);
 				RefCount = -1;
 				return -1;
 			}
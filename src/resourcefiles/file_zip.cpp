@@ -102,6 +102,8 @@ enum
 	LUMPFZIP_NEEDFILESTART = 128
 };
 
+#define ZIPCACHE_ID		MAKE_ID('P','K','0','1')
+
 //==========================================================================
 //
 // Zip Lump
@@ -117,9 +119,12 @@ struct FZipLump : public FResourceLump
 
 	virtual FileReader *GetReader();
 	virtual int FillCache();
+	virtual bool ReadCompressed(const char *&data, char *&storage);
+	virtual bool Decompress(const char *data, char *dest);
 
 private:
 	void SetLumpAddress();
+	bool Unpack(FileReader *in, char *dest);
 	virtual int GetFileOffset() 
 	{ 
 		if (Method != METHOD_STORED) return -1;
@@ -140,6 +145,9 @@ class FZipFile : public FResourceFile
 
 	static int STACK_ARGS lumpcmp(const void * a, const void * b);
 
+	bool ReadDirectoryCache(FDirectoryCache &cache);
+	void WriteDirectoryCache(DWORD centraldir, const FZipEndOfCentralDirectory &info);
+
 public:
 	FZipFile(const char * filename, FileReader *file);
 	virtual ~FZipFile();
@@ -172,12 +180,19 @@ FZipFile::FZipFile(const char * filename, FileReader *file)
 
 bool FZipFile::Open(bool quiet)
 {
+	FDirectoryCache cache;
+
+	Lumps = NULL;
+	if (cache.Load(Filename, ZIPCACHE_ID) && ReadDirectoryCache(cache))
+	{
+		if (!quiet) Printf(", %d lumps\n", NumLumps);
+		return true;
+	}
+
 	DWORD centraldir = Zip_FindCentralDir(Reader);
 	FZipEndOfCentralDirectory info;
 	int skipped = 0;
 
-	Lumps = NULL;
-
 	if (centraldir == 0)
 	{
 		if (!quiet) Printf("\n%s: ZIP file corrupt!\n", Filename);
@@ -269,9 +284,89 @@ bool FZipFile::Open(bool quiet)
 	
 	// Entries in Zips are sorted alphabetically.
 	qsort(Lumps, NumLumps, sizeof(FZipLump), lumpcmp);
+	WriteDirectoryCache(centraldir, info);
+	return true;
+}
+
+//==========================================================================
+//
+// Directory cache
+//
+// Stores the finished lump list. Besides the file's size and time, the
+// end of central directory record must still be where it was, unchanged.
+//
+//==========================================================================
+
+bool FZipFile::ReadDirectoryCache(FDirectoryCache &cache)
+{
+	FZipEndOfCentralDirectory cached, info;
+	DWORD centraldir = cache.ReadLong();
+
+	cache.ReadBlock(&cached, sizeof(cached));
+	if (cache.Failed() ||
+		Reader->Seek(centraldir, SEEK_SET) != 0 ||
+		Reader->Read(&info, sizeof(info)) != sizeof(info) ||
+		memcmp(&info, &cached, sizeof(info)) != 0)
+	{
+		return false;
+	}
+
+	DWORD count = cache.ReadLong();
+	if (cache.Failed() || count > LittleShort(info.NumEntries))
+	{
+		return false;
+	}
+	Lumps = new FZipLump[count];
+	for (DWORD i = 0; i < count; ++i)
+	{
+		FZipLump *lump_p = &Lumps[i];
+
+		lump_p->FullName = copystring(cache.ReadString());
+		cache.ReadBlock(lump_p->Name, 8);
+		lump_p->Name[8] = 0;
+		lump_p->Namespace = (int)cache.ReadLong();
+		lump_p->LumpSize = cache.ReadLong();
+		lump_p->Flags = cache.ReadByte();
+		lump_p->Method = cache.ReadByte();
+		lump_p->GPFlags = cache.ReadWord();
+		lump_p->CompressedSize = cache.ReadLong();
+		lump_p->Position = cache.ReadLong();
+		lump_p->Owner = this;
+	}
+	if (cache.Failed())
+	{
+		delete[] Lumps;
+		Lumps = NULL;
+		return false;
+	}
+	NumLumps = count;
 	return true;
 }
 
+void FZipFile::WriteDirectoryCache(DWORD centraldir, const FZipEndOfCentralDirectory &info)
+{
+	FDirectoryCache cache;
+
+	cache.WriteLong(centraldir);
+	cache.WriteBlock(&info, sizeof(info));
+	cache.WriteLong(NumLumps);
+	for (DWORD i = 0; i < NumLumps; ++i)
+	{
+		FZipLump *lump_p = &Lumps[i];
+
+		cache.WriteString(lump_p->FullName);
+		cache.WriteBlock(lump_p->Name, 8);
+		cache.WriteLong(lump_p->Namespace);
+		cache.WriteLong(lump_p->LumpSize);
+		cache.WriteByte(lump_p->Flags);
+		cache.WriteByte(lump_p->Method);
+		cache.WriteWord(lump_p->GPFlags);
+		cache.WriteLong(lump_p->CompressedSize);
+		cache.WriteLong(lump_p->Position);
+	}
+	cache.Save(Filename, ZIPCACHE_ID);
+}
+
 //==========================================================================
 //
 // Zip file
@@ -336,64 +431,131 @@ int FZipLump::FillCache()
 	if (Flags & LUMPFZIP_NEEDFILESTART) SetLumpAddress();
 	const char *buffer;
 
-	if (Method == METHOD_STORED && (buffer = Owner->Reader->GetBuffer()) != NULL)
+	if (Method == METHOD_STORED && (buffer = Owner->Reader->GetBufferAt(Position, LumpSize)) != NULL)
 	{
 		// This is an in-memory file so the cache can point directly to the file's data.
-		Cache = const_cast<char*>(buffer) + Position;
+		Cache = const_cast<char*>(buffer);
 		RefCount = -1;
 		return -1;
 	}
 
 	Owner->Reader->Seek(Position, SEEK_SET);
 	Cache = new char[LumpSize];
+	if (!Unpack(Owner->Reader, Cache))
+	{
+		assert(0);
+		return 0;
+	}
+	RefCount = 1;
+	return 1;
+}
+
+//==========================================================================
+//
+// Reads the lump's data from the file, positioned at its start, and
+// decompresses it into dest
+//
+//==========================================================================
+
+bool FZipLump::Unpack(FileReader *in, char *dest)
+{
 	switch (Method)
 	{
 		case METHOD_STORED:
 		{
-			Owner->Reader->Read(Cache, LumpSize);
+			in->Read(dest, LumpSize);
 			break;
 		}
 
 		case METHOD_DEFLATE:
 		{
-			FileReaderZ frz(*Owner->Reader, true);
-			frz.Read(Cache, LumpSize);
+			FileReaderZ frz(*in, true);
+			frz.Read(dest, LumpSize);
 			break;
 		}
 
 		case METHOD_BZIP2:
 		{
-			FileReaderBZ2 frz(*Owner->Reader);
-			frz.Read(Cache, LumpSize);
+			FileReaderBZ2 frz(*in);
+			frz.Read(dest, LumpSize);
 			break;
 		}
 
 		case METHOD_LZMA:
 		{
-			FileReaderLZMA frz(*Owner->Reader, LumpSize, true);
-			frz.Read(Cache, LumpSize);
+			FileReaderLZMA frz(*in, LumpSize, true);
+			frz.Read(dest, LumpSize);
 			break;
 		}
 
 		case METHOD_IMPLODE:
 		{
 			FZipExploder exploder;
-			exploder.Explode((unsigned char *)Cache, LumpSize, Owner->Reader, CompressedSize, GPFlags);
+			exploder.Explode((unsigned char *)dest, LumpSize, in, CompressedSize, GPFlags);
 			break;
 		}
 
 		case METHOD_SHRINK:
 		{
-			ShrinkLoop((unsigned char *)Cache, LumpSize, Owner->Reader, CompressedSize);
+			ShrinkLoop((unsigned char *)dest, LumpSize, in, CompressedSize);
 			break;
 		}
 
 		default:
-			assert(0);
-			return 0;
+			return false;
 	}
-	RefCount = 1;
-	return 1;
+	return true;
+}
+
+//==========================================================================
+//
+// Gets the compressed data so that another thread can decompress it.
+// Stored lumps are left to FillCache, which can usually avoid copying them.
+//
+//==========================================================================
+
+bool FZipLump::ReadCompressed(const char *&data, char *&storage)
+{
+	if (Method == METHOD_STORED)
+	{
+		return false;
+	}
+	if (Flags & LUMPFZIP_NEEDFILESTART) SetLumpAddress();
+
+	// A bad directory entry must not send a worker thread past the end
+	// of the mapping. If the data does not fit, the read below fails.
+	const char *buffer = Owner->Reader->GetBufferAt(Position, CompressedSize);
+	if (buffer != NULL)
+	{
+		data = buffer;
+		storage = NULL;
+	}
+	else
+	{
+		storage = new char[CompressedSize];
+		Owner->Reader->Seek(Position, SEEK_SET);
+		if (Owner->Reader->Read(storage, CompressedSize) != CompressedSize)
+		{
+			delete[] storage;
+			storage = NULL;
+			return false;
+		}
+		data = storage;
+	}
+	return true;
+}
+
+//==========================================================================
+//
+// Decompresses data returned by ReadCompressed. This does not touch the
+// archive, so it is safe to call from a worker thread.
+//
+//==========================================================================
+
+bool FZipLump::Decompress(const char *data, char *dest)
+{
+	MemoryReader in(data, CompressedSize);
+	return Unpack(&in, dest);
 }
 
 
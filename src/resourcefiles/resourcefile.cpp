@@ -34,10 +34,39 @@
 **
 */
 
+#include <sys/types.h>
+#include <sys/stat.h>
+
 #include "resourcefile.h"
 #include "cmdlib.h"
 #include "w_wad.h"
 #include "doomerrors.h"
+#include "m_crc32.h"
+#include "p_setup.h"
+#include "c_cvars.h"
+#include "c_dispatch.h"
+#include "stats.h"
+
+CVAR (Bool, wad_cachedirectories, true, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
+
+// Unreferenced lump data kept around for reuse, in megabytes. 0 frees a
+// lump's cache as soon as its last reference is released.
+CUSTOM_CVAR (Int, lump_cachesize, 16, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
+{
+	if (self < 0)
+	{
+		self = 0;
+	}
+	else
+	{
+		FResourceLump::TrimCache (size_t(self) << 20);
+	}
+}
+
+static FResourceLump *IdleHead, *IdleTail;
+static size_t IdleBytes;
+static unsigned IdleCount;
+static unsigned CacheHits, CacheMisses, CacheEvictions;
 
 
 
@@ -79,6 +108,10 @@ FResourceLump::~FResourceLump()
 		delete [] FullName;
 		FullName = NULL;
 	}
+	if (IsIdle())
+	{
+		UnlinkIdle();
+	}
 	if (Cache != NULL && RefCount >= 0)
 	{
 		delete [] Cache;
@@ -211,18 +244,29 @@ void *FResourceLump::CacheLump()
 {
 	if (Cache != NULL)
 	{
-		if (RefCount > 0) RefCount++;
+		if (RefCount > 0)
+		{
+			RefCount++;
+		}
+		else if (IsIdle())
+		{
+			UnlinkIdle();
+			RefCount = 1;
+			CacheHits++;
+		}
 	}
 	else if (LumpSize > 0)
 	{
 		FillCache();
+		CacheMisses++;
 	}
 	return Cache;
 }
 
 //==========================================================================
 //
-// Decrements reference counter and frees lump if counter reaches 0
+// Decrements reference counter. When it reaches 0 the data is kept on
+// the idle list if it fits into lump_cachesize and freed otherwise.
 //
 //==========================================================================
 
@@ -232,13 +276,122 @@ int FResourceLump::ReleaseCache()
 	{
 		if (--RefCount == 0)
 		{
-			delete [] Cache;
-			Cache = NULL;
+			size_t budget = size_t(*lump_cachesize) << 20;
+
+			if ((size_t)LumpSize <= budget)
+			{
+				LinkIdle();
+				TrimCache(budget);
+			}
+			else
+			{
+				delete [] Cache;
+				Cache = NULL;
+			}
 		}
 	}
 	return RefCount;
 }
 
+//==========================================================================
+//
+// Idle list maintenance
+//
+//==========================================================================
+
+bool FResourceLump::IsIdle() const
+{
+	return LRUPrev != NULL || IdleHead == this;
+}
+
+void FResourceLump::LinkIdle()
+{
+	LRUPrev = IdleTail;
+	LRUNext = NULL;
+	if (IdleTail != NULL)
+	{
+		IdleTail->LRUNext = this;
+	}
+	else
+	{
+		IdleHead = this;
+	}
+	IdleTail = this;
+	IdleBytes += LumpSize;
+	IdleCount++;
+}
+
+void FResourceLump::UnlinkIdle()
+{
+	if (LRUPrev != NULL)
+	{
+		LRUPrev->LRUNext = LRUNext;
+	}
+	else
+	{
+		IdleHead = LRUNext;
+	}
+	if (LRUNext != NULL)
+	{
+		LRUNext->LRUPrev = LRUPrev;
+	}
+	else
+	{
+		IdleTail = LRUPrev;
+	}
+	LRUPrev = LRUNext = NULL;
+	IdleBytes -= LumpSize;
+	IdleCount--;
+}
+
+void FResourceLump::Evict()
+{
+	UnlinkIdle();
+	delete [] Cache;
+	Cache = NULL;
+	CacheEvictions++;
+}
+
+//==========================================================================
+//
+// Frees the least recently released lumps until the idle list fits
+// into the given number of bytes.
+//
+//==========================================================================
+
+void FResourceLump::TrimCache(size_t budget)
+{
+	while (IdleBytes > budget && IdleHead != NULL)
+	{
+		IdleHead->Evict();
+	}
+}
+
+//==========================================================================
+//
+// Lump cache statistics
+//
+//==========================================================================
+
+ADD_STAT (lumpcache)
+{
+	FString out;
+	unsigned lookups = CacheHits + CacheMisses;
+
+	// Only lumps taken back from the idle list count as hits. Lumps that
+	// were still referenced would have been served without it.
+	out.Format ("idle: %u lumps, %.2f of %d MB  hits: %u/%u (%.1f%%)  evicted: %u",
+		IdleCount, IdleBytes / 1048576.0, *lump_cachesize,
+		CacheHits, lookups, lookups > 0 ? CacheHits * 100.0 / lookups : 0.0,
+		CacheEvictions);
+	return out;
+}
+
+CCMD (flushlumpcache)
+{
+	FResourceLump::TrimCache (0);
+}
+
 //==========================================================================
 //
 // Opens a resource file
@@ -264,7 +417,7 @@ FResourceFile *FResourceFile::OpenResourceFile(const char *filename, FileReader
 	{
 		try
 		{
-			file = new FileReader(filename);
+			file = new MappedFileReader(filename);
 		}
 		catch (CRecoverableError &)
 		{
@@ -336,12 +489,12 @@ FileReader *FUncompressedLump::GetReader()
 
 int FUncompressedLump::FillCache()
 {
-	const char * buffer = Owner->Reader->GetBuffer();
+	const char * buffer = Owner->Reader->GetBufferAt(Position, LumpSize);
 
 	if (buffer != NULL)
 	{
 		// This is an in-memory file so the cache can point directly to the file's data.
-		Cache = const_cast<char*>(buffer) + Position;
+		Cache = const_cast<char*>(buffer);
 		RefCount = -1;
 		return -1;
 	}
@@ -432,3 +585,243 @@ int FExternalLump::FillCache()
 	return 1;
 }
 
+
+//==========================================================================
+//
+// FDirectoryCache
+//
+// The cache file is a header identifying the archive followed by whatever
+// the format wrote. Everything is little endian.
+//
+//==========================================================================
+
+#define DIRCACHE_ID			MAKE_ID('Z','D','I','R')
+#define DIRCACHE_VERSION	1
+
+FString FDirectoryCache::GetCacheName(const char *filename, bool create)
+{
+	FString path = GetCachePath();
+	path += "/lumpdir";
+	if (create) CreatePath(path);
+	path.AppendFormat("/%s-%08x.zdc", ExtractFileBase(filename, true).GetChars(),
+		CalcCRC32((const BYTE *)filename, (unsigned int)strlen(filename)));
+	return path;
+}
+
+bool FDirectoryCache::GetFileStamp(const char *filename, DWORD &size, DWORD &time)
+{
+	struct stat info;
+
+	if (stat(filename, &info) != 0 || (info.st_mode & S_IFDIR))
+	{
+		return false;
+	}
+	size = DWORD(info.st_size);
+	time = DWORD(info.st_mtime);
+	return true;
+}
+
+bool FDirectoryCache::Load(const char *filename, DWORD format)
+{
+	DWORD size, time;
+
+	if (!wad_cachedirectories || filename == NULL || !GetFileStamp(filename, size, time))
+	{
+		return false;
+	}
+
+	FILE *f = fopen(GetCacheName(filename, false), "rb");
+	if (f == NULL)
+	{
+		return false;
+	}
+	fseek(f, 0, SEEK_END);
+	long len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	if (len > 0)
+	{
+		Data.Resize(len);
+		if (fread(&Data[0], 1, len, f) != (size_t)len)
+		{
+			Data.Clear();
+		}
+	}
+	fclose(f);
+
+	Pos = 0;
+	Error = Data.Size() == 0;
+	if (ReadLong() != DIRCACHE_ID || ReadLong() != DIRCACHE_VERSION || ReadLong() != format ||
+		ReadLong() != size || ReadLong() != time)
+	{
+		return false;
+	}
+	const char *name = ReadString();
+	return !Error && stricmp(name, filename) == 0;
+}
+
+void FDirectoryCache::Save(const char *filename, DWORD format)
+{
+	DWORD size, time;
+
+	if (!wad_cachedirectories || filename == NULL || !GetFileStamp(filename, size, time))
+	{
+		return;
+	}
+
+	FILE *f = fopen(GetCacheName(filename, true), "wb");
+	if (f == NULL)
+	{
+		return;
+	}
+
+	FDirectoryCache header;
+	header.WriteLong(DIRCACHE_ID);
+	header.WriteLong(DIRCACHE_VERSION);
+	header.WriteLong(format);
+	header.WriteLong(size);
+	header.WriteLong(time);
+	header.WriteString(filename);
+	fwrite(&header.Data[0], 1, header.Data.Size(), f);
+	if (Data.Size() > 0)
+	{
+		fwrite(&Data[0], 1, Data.Size(), f);
+	}
+	fclose(f);
+}
+
+void FDirectoryCache::ReadBlock(void *dest, unsigned int len)
+{
+	if (Error || Pos + len > Data.Size())
+	{
+		memset(dest, 0, len);
+		Error = true;
+		return;
+	}
+	memcpy(dest, &Data[Pos], len);
+	Pos += len;
+}
+
+BYTE FDirectoryCache::ReadByte()
+{
+	BYTE v;
+	ReadBlock(&v, 1);
+	return v;
+}
+
+WORD FDirectoryCache::ReadWord()
+{
+	BYTE v[2];
+	ReadBlock(v, 2);
+	return v[0] | (v[1] << 8);
+}
+
+DWORD FDirectoryCache::ReadLong()
+{
+	BYTE v[4];
+	ReadBlock(v, 4);
+	return v[0] | (v[1] << 8) | (v[2] << 16) | (DWORD(v[3]) << 24);
+}
+
+// The string stays valid as long as the cache does.
+const char *FDirectoryCache::ReadString()
+{
+	unsigned int len = ReadWord();
+
+	if (Error || Pos + len >= Data.Size() || Data[Pos + len] != 0)
+	{
+		Error = true;
+		return "";
+	}
+	const char *str = (const char *)&Data[Pos];
+	Pos += len + 1;
+	return str;
+}
+
+void FDirectoryCache::WriteBlock(const void *src, unsigned int len)
+{
+	if (len > 0)
+	{
+		memcpy(&Data[Data.Reserve(len)], src, len);
+	}
+}
+
+void FDirectoryCache::WriteByte(BYTE v)
+{
+	Data.Push(v);
+}
+
+void FDirectoryCache::WriteWord(WORD v)
+{
+	WriteByte(BYTE(v));
+	WriteByte(BYTE(v >> 8));
+}
+
+void FDirectoryCache::WriteLong(DWORD v)
+{
+	WriteWord(WORD(v));
+	WriteWord(WORD(v >> 16));
+}
+
+void FDirectoryCache::WriteString(const char *str)
+{
+	unsigned int len = (unsigned int)strlen(str);
+	WriteWord(WORD(len));
+	WriteBlock(str, len + 1);
+}
+
+//==========================================================================
+//
+// CCMD lumpdirbench
+//
+// Opens every loaded archive again, once parsing its directory and once
+// from the directory cache, to see what the cache saves at startup.
+//
+//==========================================================================
+
+CCMD (lumpdirbench)
+{
+	int runs = argv.argc() > 1 ? atoi(argv[1]) : 5;
+	bool oldcache = wad_cachedirectories;
+	cycle_t parsed, cached;
+	int files = 0;
+
+	if (runs < 1) runs = 1;
+
+	parsed.Reset();
+	cached.Reset();
+	for (int i = 0; i < Wads.GetNumWads(); ++i)
+	{
+		const char *filename = Wads.GetWadFullName(i);
+		FResourceFile *resfile;
+
+		if (filename == NULL || !FileExists(filename))
+		{
+			continue;
+		}
+		files++;
+
+		// Make sure the cache is there before timing it.
+		wad_cachedirectories = true;
+		delete FResourceFile::OpenResourceFile(filename, NULL, true);
+
+		for (int run = 0; run < runs; ++run)
+		{
+			wad_cachedirectories = false;
+			parsed.Clock();
+			resfile = FResourceFile::OpenResourceFile(filename, NULL, true);
+			parsed.Unclock();
+			delete resfile;
+
+			wad_cachedirectories = true;
+			cached.Clock();
+			resfile = FResourceFile::OpenResourceFile(filename, NULL, true);
+			cached.Unclock();
+			delete resfile;
+		}
+	}
+	wad_cachedirectories = oldcache;
+
+	Printf ("%d archives x %d runs\n", files, runs);
+	Printf ("parsed: %.3f ms per run, cached: %.3f ms per run\n",
+		parsed.TimeMS() / runs, cached.TimeMS() / runs);
+}
@@ -26,6 +26,11 @@ struct FResourceLump
 	FResourceFile *	Owner;
 	int				Namespace;
 
+	// Lumps nobody references any more keep their cache on this list, most
+	// recently released last, until lump_cachesize forces them out.
+	FResourceLump *	LRUPrev;
+	FResourceLump *	LRUNext;
+
 	FResourceLump()
 	{
 		FullName = NULL;
@@ -35,6 +40,7 @@ struct FResourceLump
 		RefCount = 0;
 		Namespace = 0;	// ns_global
 		*Name = 0;
+		LRUPrev = LRUNext = NULL;
 	}
 
 	virtual ~FResourceLump();
@@ -48,9 +54,23 @@ struct FResourceLump
 	void *CacheLump();
 	int ReleaseCache();
 
+	static void TrimCache(size_t budget);
+
+	// Lets FWadCollection::PrefetchLumps fill the cache on other threads.
+	// ReadCompressed runs on the main thread and returns the raw data, which
+	// either points into the archive or is a new block returned in storage.
+	// Decompress must only use that data and may run on any thread.
+	virtual bool ReadCompressed(const char *&data, char *&storage) { return false; }
+	virtual bool Decompress(const char *data, char *dest) { return false; }
+
 protected:
 	virtual int FillCache() = 0;
 
+private:
+	bool IsIdle() const;
+	void LinkIdle();
+	void UnlinkIdle();
+	void Evict();
 };
 
 class FResourceFile
@@ -116,6 +136,40 @@ struct FExternalLump : public FResourceLump
 
 };
 
+// Keeps the parsed directory of an archive on disk so that opening the
+// archive again does not have to parse it. A cache is only used while the
+// archive's size and modification time still match; each format stores
+// whatever else it needs to check that it is still valid.
+class FDirectoryCache
+{
+public:
+	FDirectoryCache() : Pos(0), Error(false) {}
+
+	bool Load(const char *filename, DWORD format);
+	void Save(const char *filename, DWORD format);
+
+	BYTE ReadByte();
+	WORD ReadWord();
+	DWORD ReadLong();
+	const char *ReadString();
+	void ReadBlock(void *dest, unsigned int len);
+	bool Failed() const { return Error; }
+
+	void WriteByte(BYTE v);
+	void WriteWord(WORD v);
+	void WriteLong(DWORD v);
+	void WriteString(const char *str);
+	void WriteBlock(const void *src, unsigned int len);
+
+private:
+	TArray<BYTE> Data;
+	unsigned int Pos;
+	bool Error;
+
+	static FString GetCacheName(const char *filename, bool create);
+	static bool GetFileStamp(const char *filename, DWORD &size, DWORD &time);
+};
+
 
 
 
@@ -488,6 +488,25 @@ void S_PrecacheLevel ()
 			level.info->PrecacheSounds[i].MarkUsed();
 		}
 
+		// Decompress the sounds that aren't loaded yet on all cores first.
+		TArray<int> lumps;
+		for (i = 1; i < S_sfx.Size(); ++i)
+		{
+			if (S_sfx[i].bUsed && !S_sfx[i].bPlayerReserve && !S_sfx[i].bRandomHeader)
+			{
+				sfxinfo_t *sfx = &S_sfx[i];
+				while (sfx->link != sfxinfo_t::NO_LINK)
+				{
+					sfx = &S_sfx[sfx->link];
+				}
+				if (!sfx->data.isValid() && sfx->lumpnum >= 0)
+				{
+					lumps.Push (sfx->lumpnum);
+				}
+			}
+		}
+		Wads.PrefetchLumps (lumps);
+
 		for (i = 1; i < S_sfx.Size(); ++i)
 		{
 			if (S_sfx[i].bUsed)
@@ -495,6 +514,7 @@ void S_PrecacheLevel ()
 				S_CacheSound (&S_sfx[i]);
 			}
 		}
+		Wads.ReleasePrefetchedLumps ();
 		for (i = 1; i < S_sfx.Size(); ++i)
 		{
 			if (!S_sfx[i].bUsed && S_sfx[i].link == sfxinfo_t::NO_LINK)
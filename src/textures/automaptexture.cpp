@@ -155,6 +155,7 @@ void FAutomapTexture::MakeTexture ()
 
 const BYTE *FAutomapTexture::GetPixels ()
 {
+	TouchCache ();
 	if (Pixels == NULL)
 	{
 		MakeTexture ();
@@ -170,6 +171,7 @@ const BYTE *FAutomapTexture::GetPixels ()
 
 const BYTE *FAutomapTexture::GetColumn (unsigned int column, const Span **spans_out)
 {
+	TouchCache ();
 	if (Pixels == NULL)
 	{
 		MakeTexture ();
@@ -435,6 +435,7 @@ FTextureFormat FDDSTexture::GetFormat()
 
 const BYTE *FDDSTexture::GetColumn (unsigned int column, const Span **spans_out)
 {
+	TouchCache ();
 	if (Pixels == NULL)
 	{
 		MakeTexture ();
@@ -469,6 +470,7 @@ const BYTE *FDDSTexture::GetColumn (unsigned int column, const Span **spans_out)
 
 const BYTE *FDDSTexture::GetPixels ()
 {
+	TouchCache ();
 	if (Pixels == NULL)
 	{
 		MakeTexture ();
@@ -148,6 +148,7 @@ void FFlatTexture::Unload ()
 
 const BYTE *FFlatTexture::GetColumn (unsigned int column, const Span **spans_out)
 {
+	TouchCache ();
 	if (Pixels == NULL)
 	{
 		MakeTexture ();
@@ -178,6 +179,7 @@ const BYTE *FFlatTexture::GetColumn (unsigned int column, const Span **spans_out
 
 const BYTE *FFlatTexture::GetPixels ()
 {
+	TouchCache ();
 	if (Pixels == NULL)
 	{
 		MakeTexture ();
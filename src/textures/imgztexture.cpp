@@ -153,6 +153,7 @@ void FIMGZTexture::Unload ()
 
 const BYTE *FIMGZTexture::GetColumn (unsigned int column, const Span **spans_out)
 {
+	TouchCache ();
 	if (Pixels == NULL)
 	{
 		MakeTexture ();
@@ -187,6 +188,7 @@ const BYTE *FIMGZTexture::GetColumn (unsigned int column, const Span **spans_out
 
 const BYTE *FIMGZTexture::GetPixels ()
 {
+	TouchCache ();
 	if (Pixels == NULL)
 	{
 		MakeTexture ();
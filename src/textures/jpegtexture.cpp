@@ -321,6 +321,7 @@ FTextureFormat FJPEGTexture::GetFormat()
 
 const BYTE *FJPEGTexture::GetColumn (unsigned int column, const Span **spans_out)
 {
+	TouchCache ();
 	if (Pixels == NULL)
 	{
 		MakeTexture ();
@@ -351,6 +352,7 @@ const BYTE *FJPEGTexture::GetColumn (unsigned int column, const Span **spans_out
 
 const BYTE *FJPEGTexture::GetPixels ()
 {
+	TouchCache ();
 	if (Pixels == NULL)
 	{
 		MakeTexture ();
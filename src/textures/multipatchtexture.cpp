@@ -163,6 +163,7 @@ public:
 
 	int CopyTrueColorPixels(FBitmap *bmp, int x, int y, int rotate, FCopyInfo *inf = NULL);
 	int GetSourceLump() { return DefinitionLump; }
+	void GetSourceLumps(TArray<int> &lumps);
 	FTexture *GetRedirect(bool wantwarped);
 	FTexture *GetRawTexture();
 
@@ -369,6 +370,7 @@ void FMultiPatchTexture::Unload ()
 
 const BYTE *FMultiPatchTexture::GetPixels ()
 {
+	TouchCache ();
 	if (bRedirect)
 	{
 		return Parts->Texture->GetPixels ();
@@ -388,6 +390,7 @@ const BYTE *FMultiPatchTexture::GetPixels ()
 
 const BYTE *FMultiPatchTexture::GetColumn (unsigned int column, const Span **spans_out)
 {
+	TouchCache ();
 	if (bRedirect)
 	{
 		return Parts->Texture->GetColumn (column, spans_out);
@@ -795,6 +798,25 @@ FTexture *FMultiPatchTexture::GetRawTexture()
 	return NumParts == 1 ? Parts->Texture : this;
 }
 
+//==========================================================================
+//
+// FMultiPatchTexture :: GetSourceLumps
+//
+// The definition lump has long been read, so only the patches count.
+//
+//==========================================================================
+
+void FMultiPatchTexture::GetSourceLumps(TArray<int> &lumps)
+{
+	for (int i = 0; i < NumParts; ++i)
+	{
+		if (Parts[i].Texture != NULL)
+		{
+			Parts[i].Texture->GetSourceLumps(lumps);
+		}
+	}
+}
+
 //==========================================================================
 //
 // FMultiPatchTexture :: TexPart :: TexPart
@@ -194,6 +194,7 @@ void FPatchTexture::Unload ()
 
 const BYTE *FPatchTexture::GetPixels ()
 {
+	TouchCache ();
 	if (Pixels == NULL)
 	{
 		MakeTexture ();
@@ -209,6 +210,7 @@ const BYTE *FPatchTexture::GetPixels ()
 
 const BYTE *FPatchTexture::GetColumn (unsigned int column, const Span **spans_out)
 {
+	TouchCache ();
 	if (Pixels == NULL)
 	{
 		MakeTexture ();
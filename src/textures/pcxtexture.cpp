@@ -212,6 +212,7 @@ FTextureFormat FPCXTexture::GetFormat()
 
 const BYTE *FPCXTexture::GetColumn (unsigned int column, const Span **spans_out)
 {
+	TouchCache ();
 	if (Pixels == NULL)
 	{
 		MakeTexture ();
@@ -242,6 +243,7 @@ const BYTE *FPCXTexture::GetColumn (unsigned int column, const Span **spans_out)
 
 const BYTE *FPCXTexture::GetPixels ()
 {
+	TouchCache ();
 	if (Pixels == NULL)
 	{
 		MakeTexture ();
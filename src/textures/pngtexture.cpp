@@ -396,6 +396,7 @@ FTextureFormat FPNGTexture::GetFormat()
 
 const BYTE *FPNGTexture::GetColumn (unsigned int column, const Span **spans_out)
 {
+	TouchCache ();
 	if (Pixels == NULL)
 	{
 		MakeTexture ();
@@ -430,6 +431,7 @@ const BYTE *FPNGTexture::GetColumn (unsigned int column, const Span **spans_out)
 
 const BYTE *FPNGTexture::GetPixels ()
 {
+	TouchCache ();
 	if (Pixels == NULL)
 	{
 		MakeTexture ();
@@ -216,6 +216,7 @@ void FRawPageTexture::Unload ()
 
 const BYTE *FRawPageTexture::GetColumn (unsigned int column, const Span **spans_out)
 {
+	TouchCache ();
 	if (Pixels == NULL)
 	{
 		MakeTexture ();
@@ -239,6 +240,7 @@ const BYTE *FRawPageTexture::GetColumn (unsigned int column, const Span **spans_
 
 const BYTE *FRawPageTexture::GetPixels ()
 {
+	TouchCache ();
 	if (Pixels == NULL)
 	{
 		MakeTexture ();
@@ -45,6 +45,23 @@
 #include "v_video.h"
 #include "m_fixed.h"
 #include "textures/textures.h"
+#include "c_cvars.h"
+#include "stats.h"
+
+// Memory for loaded image textures, in megabytes. 0 means no limit.
+CUSTOM_CVAR (Int, tex_cachesize, 0, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
+{
+	if (self < 0)
+	{
+		self = 0;
+	}
+}
+
+DWORD FTexture::CacheFrame = 1;
+bool FTexture::CacheFrozen;
+static FTexture *CacheHead, *CacheTail;
+static size_t CacheBytes;
+static unsigned CacheCount, CacheEvictions;
 
 typedef bool (*CheckFunc)(FileReader & file);
 typedef FTexture * (*CreateFunc)(FileReader & file, int lumpnum);
@@ -147,7 +164,8 @@ FTexture::FTexture (const char *name, int lumpnum)
   WidthBits(0), HeightBits(0), xScale(FRACUNIT), yScale(FRACUNIT), SourceLump(lumpnum),
   UseType(TEX_Any), bNoDecals(false), bNoRemap0(false), bWorldPanning(false),
   bMasked(true), bAlphaTexture(false), bHasCanvas(false), bWarped(0), bComplex(false), bMultiPatch(false),
-  Rotations(0xFFFF), SkyOffset(0), Width(0), Height(0), WidthMask(0), Native(NULL)
+  Rotations(0xFFFF), SkyOffset(0), Width(0), Height(0), WidthMask(0), Native(NULL),
+  TiledPixels(NULL), TiledSource(NULL), CachePrev(NULL), CacheNext(NULL), LastUsedFrame(0), CacheSize(0), SpanBytes(0)
 {
 	id.SetInvalid();
 	if (name != NULL)
@@ -167,9 +185,236 @@ FTexture::FTexture (const char *name, int lumpnum)
 
 FTexture::~FTexture ()
 {
+	Uncache();
 	KillNative();
 }
 
+//==========================================================================
+//
+// FTexture :: MoveToCacheEnd
+//
+// Marks the texture as used in this frame by moving it to the end of the
+// cache list, adding it first if it was not loaded before.
+//
+//==========================================================================
+
+void FTexture::MoveToCacheEnd ()
+{
+	if (LastUsedFrame != 0)
+	{
+		if (CacheTail == this)
+		{
+			LastUsedFrame = CacheFrame;
+			return;
+		}
+		UnlinkCache ();
+	}
+	else
+	{
+		CacheSize += Width * Height;
+		CacheBytes += CacheSize;
+		CacheCount++;
+	}
+	CachePrev = CacheTail;
+	CacheNext = NULL;
+	if (CacheTail != NULL)
+	{
+		CacheTail->CacheNext = this;
+	}
+	else
+	{
+		CacheHead = this;
+	}
+	CacheTail = this;
+	LastUsedFrame = CacheFrame;
+}
+
+//==========================================================================
+//
+// FTexture :: UnlinkCache
+//
+//==========================================================================
+
+void FTexture::UnlinkCache ()
+{
+	if (CachePrev != NULL)
+	{
+		CachePrev->CacheNext = CacheNext;
+	}
+	else
+	{
+		CacheHead = CacheNext;
+	}
+	if (CacheNext != NULL)
+	{
+		CacheNext->CachePrev = CachePrev;
+	}
+	else
+	{
+		CacheTail = CachePrev;
+	}
+	CachePrev = CacheNext = NULL;
+}
+
+//==========================================================================
+//
+// FTexture :: AddCacheSize
+//
+// Accounts for spans and tiled copies as they are created and freed.
+//
+//==========================================================================
+
+void FTexture::AddCacheSize (int bytes)
+{
+	CacheSize += bytes;
+	if (LastUsedFrame != 0)
+	{
+		CacheBytes += bytes;
+	}
+}
+
+//==========================================================================
+//
+// FTexture :: FreeTiledPixels
+//
+//==========================================================================
+
+void FTexture::FreeTiledPixels ()
+{
+	if (TiledPixels != NULL)
+	{
+		delete[] TiledPixels;
+		TiledPixels = NULL;
+		TiledSource = NULL;
+		AddCacheSize (-(Width * Height));
+	}
+}
+
+//==========================================================================
+//
+// FTexture :: Uncache
+//
+// Frees the tiled copy and takes the texture off the cache list. Every
+// path that calls Unload() must call this too, so the list only counts
+// textures that are actually loaded.
+//
+//==========================================================================
+
+void FTexture::Uncache ()
+{
+	FreeTiledPixels ();
+	if (LastUsedFrame == 0)
+	{
+		return;
+	}
+	UnlinkCache ();
+	CacheBytes -= CacheSize;
+	CacheSize = SpanBytes;
+	CacheCount--;
+	LastUsedFrame = 0;
+}
+
+//==========================================================================
+//
+// FTexture :: StaticTrimCache
+//
+// Called between frames, when no pointers into texture data are held,
+// to unload the least recently used textures that are over the budget.
+// Textures used in the frame just drawn are never unloaded.
+//
+//==========================================================================
+
+void FTexture::StaticTrimCache ()
+{
+	size_t budget = size_t(*tex_cachesize) << 20;
+
+	while (budget > 0 && CacheBytes > budget &&
+		CacheHead != NULL && CacheHead->LastUsedFrame != CacheFrame)
+	{
+		FTexture *tex = CacheHead;
+
+		tex->Uncache ();
+		tex->Unload ();
+		CacheEvictions++;
+	}
+	// Skip 0, which marks textures that are not on the list.
+	if (++CacheFrame == 0)
+	{
+		CacheFrame = 1;
+	}
+}
+
+ADD_STAT (texcache)
+{
+	FString out;
+
+	out.Format ("%u textures, %.2f of %d MB, %u evicted",
+		CacheCount, CacheBytes / 1048576.0, *tex_cachesize, CacheEvictions);
+	return out;
+}
+
+//==========================================================================
+//
+// FTexture :: CanTilePixels
+//
+// Tiling needs both dimensions to be powers of two of at least 8. Canvas
+// and warped textures change every frame, so tiling them would cost more
+// than it saves.
+//
+//==========================================================================
+
+bool FTexture::CanTilePixels ()
+{
+	int width = GetWidth();
+	int height = GetHeight();
+
+	return !bHasCanvas && !bWarped &&
+		WidthBits >= 3 && HeightBits >= 3 &&
+		width == (1 << WidthBits) && height == (1 << HeightBits);
+}
+
+//==========================================================================
+//
+// FTexture :: GetPixelsTiled
+//
+// Returns the same pixels as GetPixels, rearranged into 8x8 tiles of 64
+// bytes. Tiles are stored column by column, and so are the pixels inside
+// each tile, so the pixel at (x,y) lives at
+//   ((x>>3) << (HeightBits+3)) | ((y>>3) << 6) | ((x&7) << 3) | (y&7)
+// The copy is rebuilt whenever the source pixels change.
+//
+//==========================================================================
+
+const BYTE *FTexture::GetPixelsTiled ()
+{
+	bool modified = CheckModified();
+	const BYTE *pixels = GetPixels();
+
+	if (TiledPixels == NULL || modified || pixels != TiledSource)
+	{
+		int width = GetWidth();
+		int height = GetHeight();
+
+		if (TiledPixels == NULL)
+		{
+			TiledPixels = new BYTE[width * height];
+			AddCacheSize (width * height);
+		}
+		for (int x = 0; x < width; ++x)
+		{
+			const BYTE *col = pixels + x * height;
+			BYTE *tilecol = TiledPixels + ((x >> 3) << (HeightBits + 3)) + ((x & 7) << 3);
+
+			for (int y = 0; y < height; ++y)
+			{
+				tilecol[((y >> 3) << 6) | (y & 7)] = col[y];
+			}
+		}
+		TiledSource = pixels;
+	}
+	return TiledPixels;
+}
+
 bool FTexture::CheckModified ()
 {
 	return false;
@@ -215,13 +460,14 @@ void FTexture::HackHack (int newheight)
 {
 }
 
-FTexture::Span **FTexture::CreateSpans (const BYTE *pixels) const
+FTexture::Span **FTexture::CreateSpans (const BYTE *pixels)
 {
 	Span **spans, *span;
 
 	if (!bMasked)
 	{ // Texture does not have holes, so it can use a simpler span structure
-		spans = (Span **)M_Malloc (sizeof(Span*)*Width + sizeof(Span)*2);
+		SpanBytes = sizeof(Span*)*Width + sizeof(Span)*2;
+		spans = (Span **)M_Malloc (SpanBytes);
 		span = (Span *)&spans[Width];
 		for (int x = 0; x < Width; ++x)
 		{
@@ -265,7 +511,8 @@ FTexture::Span **FTexture::CreateSpans (const BYTE *pixels) const
 		}
 
 		// Allocate space for the spans
-		spans = (Span **)M_Malloc (sizeof(Span*)*numcols + sizeof(Span)*numspans);
+		SpanBytes = sizeof(Span*)*numcols + sizeof(Span)*numspans;
+		spans = (Span **)M_Malloc (SpanBytes);
 
 		// Fill in the spans
 		for (x = 0, span = (Span *)&spans[numcols], data_p = pixels; x < numcols; ++x)
@@ -305,12 +552,15 @@ FTexture::Span **FTexture::CreateSpans (const BYTE *pixels) const
 			span++;
 		}
 	}
+	AddCacheSize (SpanBytes);
 	return spans;
 }
 
-void FTexture::FreeSpans (Span **spans) const
+void FTexture::FreeSpans (Span **spans)
 {
 	M_Free (spans);
+	AddCacheSize (-int(SpanBytes));
+	SpanBytes = 0;
 }
 
 void FTexture::CopyToBlock (BYTE *dest, int dwidth, int dheight, int xpos, int ypos, int rotate, const BYTE *translation)
@@ -555,6 +805,15 @@ FTexture *FTexture::GetRawTexture()
 	return this;
 }
 
+void FTexture::GetSourceLumps(TArray<int> &lumps)
+{
+	int lump = GetSourceLump();
+	if (lump >= 0)
+	{
+		lumps.Push(lump);
+	}
+}
+
 void FTexture::SetScaledSize(int fitwidth, int fitheight)
 {
 	xScale = FLOAT2FIXED(float(Width) / fitwidth);
@@ -348,6 +348,7 @@ void FTextureManager::UnloadAll ()
 	for (unsigned int i = 0; i < Textures.Size(); ++i)
 	{
 		Textures[i].Texture->Unload ();
+		Textures[i].Texture->Uncache ();
 	}
 }
 
@@ -1235,11 +1236,32 @@ void FTextureManager::PrecacheLevel (void)
 	memset (hitlist, 0, cnt);
 
 	screen->GetHitlist(hitlist);
+
+	// Textures that stayed loaded from the previous level don't need their
+	// lumps again, so only the new ones are decompressed ahead of time.
+	TArray<int> lumps;
+	for (int i = 0; i < cnt; i++)
+	{
+		FTexture *tex = ByIndex(i);
+		if (hitlist[i] != 0 && tex != NULL &&
+			((unsigned)i >= PrecachedLastLevel.Size() || PrecachedLastLevel[i] == 0))
+		{
+			tex->GetSourceLumps(lumps);
+		}
+	}
+	Wads.PrefetchLumps(lumps);
+
 	for (int i = cnt - 1; i >= 0; i--)
 	{
 		Renderer->PrecacheTexture(ByIndex(i), hitlist[i]);
 	}
+	Wads.ReleasePrefetchedLumps();
 
+	PrecachedLastLevel.Resize(cnt);
+	if (cnt > 0)
+	{
+		memcpy(&PrecachedLastLevel[0], hitlist, cnt);
+	}
 	delete[] hitlist;
 }
 
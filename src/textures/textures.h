@@ -211,17 +211,33 @@ public:
 
 	// Returns the whole texture, stored in column-major order
 	virtual const BYTE *GetPixels () = 0;
+
+	// Returns the whole texture split into 8x8 tiles for R_DrawSpanTiledP_C.
+	// Only valid if CanTilePixels() is true.
+	const BYTE *GetPixelsTiled ();
+	bool CanTilePixels ();
 	
 	virtual int CopyTrueColorPixels(FBitmap *bmp, int x, int y, int rotate=0, FCopyInfo *inf = NULL);
 	int CopyTrueColorTranslated(FBitmap *bmp, int x, int y, int rotate, FRemapTable *remap, FCopyInfo *inf = NULL);
 	virtual bool UseBasePalette();
 	virtual int GetSourceLump() { return SourceLump; }
+	virtual void GetSourceLumps(TArray<int> &lumps);	// every lump loading the texture reads
 	virtual FTexture *GetRedirect(bool wantwarped);
 	virtual FTexture *GetRawTexture();		// for FMultiPatchTexture to override
 	FTextureID GetID() const { return id; }
 
 	virtual void Unload () = 0;
 
+	// Texture cache: image textures note every frame their pixels are
+	// asked for, and at the end of a frame the least recently used ones
+	// are unloaded until tex_cachesize is met again.
+	// The list is not locked. Code that reads textures from other threads
+	// must load them on the main thread first and set CacheFrozen while
+	// the threads run, so nothing touches the list until it is cleared.
+	static void StaticTrimCache ();
+	void Uncache ();
+	static bool CacheFrozen;
+
 	// Returns the native pixel format for this image
 	virtual FTextureFormat GetFormat();
 
@@ -284,11 +300,32 @@ protected:
 	WORD Width, Height, WidthMask;
 	static BYTE GrayMap[256];
 	FNativeTexture *Native;
+	BYTE *TiledPixels;
+	const BYTE *TiledSource;
+	FTexture *CachePrev, *CacheNext;
+	DWORD LastUsedFrame;	// 0 if not on the cache list
+	DWORD CacheSize;		// pixels while on the list, plus spans and tiled copy
+	DWORD SpanBytes;
+	static DWORD CacheFrame;
 
 	FTexture (const char *name = NULL, int lumpnum = -1);
 
-	Span **CreateSpans (const BYTE *pixels) const;
-	void FreeSpans (Span **spans) const;
+	// Called by GetPixels and GetColumn of textures that can reload their
+	// pixels after Unload().
+	void TouchCache ()
+	{
+		if (LastUsedFrame != CacheFrame && !CacheFrozen)
+		{
+			MoveToCacheEnd ();
+		}
+	}
+	void MoveToCacheEnd ();
+	void UnlinkCache ();
+	void AddCacheSize (int bytes);
+	void FreeTiledPixels ();
+
+	Span **CreateSpans (const BYTE *pixels);
+	void FreeSpans (Span **spans);
 	void CalcBitSize ();
 	void CopyInfo(FTexture *other)
 	{
@@ -470,6 +507,7 @@ private:
 	TArray<FSwitchDef *> mSwitchDefs;
 	TArray<FDoorAnimation> mAnimatedDoors;
 	TArray<BYTE *> BuildTileFiles;
+	TArray<BYTE> PrecachedLastLevel;	// textures the previous PrecacheLevel kept loaded
 };
 
 // A texture that doesn't really exist
@@ -203,6 +203,7 @@ FTextureFormat FTGATexture::GetFormat()
 
 const BYTE *FTGATexture::GetColumn (unsigned int column, const Span **spans_out)
 {
+	TouchCache ();
 	if (Pixels == NULL)
 	{
 		MakeTexture ();
@@ -237,6 +238,7 @@ const BYTE *FTGATexture::GetColumn (unsigned int column, const Span **spans_out)
 
 const BYTE *FTGATexture::GetPixels ()
 {
+	TouchCache ();
 	if (Pixels == NULL)
 	{
 		MakeTexture ();
@@ -327,6 +327,9 @@ static void FinishThingdef()
 		mysnprintf(fmt, countof(fmt), "QuestItem%d", i+1);
 		QuestItemClasses[i] = PClass::FindClass(fmt);
 	}
+
+	// All states are known now, so FState::StaticFindStateOwner can use a sorted index.
+	FState::StaticBuildOwnerIndex();
 }
 
 
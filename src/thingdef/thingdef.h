@@ -117,9 +117,13 @@ public:
 //
 //==========================================================================
 
+class FxProgram;
+struct ExpVal;
+
 struct FStateExpression
 {
 	FxExpression *expr;
+	FxProgram *program;
 	const PClass *owner;
 	bool constant;
 	bool cloned;
@@ -138,6 +142,8 @@ public:
 	void Copy(int dest, int src, int cnt);
 	int ResolveAll();
 	FxExpression *Get(int no);
+	FxProgram *GetProgram(int no);
+	bool Eval(int no, AActor *self, ExpVal &val);
 	unsigned int Size() { return expressions.Size(); }
 };
 
@@ -0,0 +1,999 @@
+/*
+** thingdef_bytecode.cpp
+**
+** Compiles resolved DECORATE expressions into a simple register bytecode
+**
+**---------------------------------------------------------------------------
+** Copyright 2012 The ZDoom Team
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+** Every node writes its value into a register chosen by its parent, so
+** the code evaluates operands in exactly the same order as the tree does.
+** This matters for anything that draws random numbers.
+**
+*/
+
+#include <math.h>
+#include "actor.h"
+#include "sc_man.h"
+#include "tarray.h"
+#include "templates.h"
+#include "cmdlib.h"
+#include "i_system.h"
+#include "m_random.h"
+#include "c_dispatch.h"
+#include "stats.h"
+#include "d_player.h"
+#include "doomstat.h"
+#include "v_text.h"
+#include "thingdef.h"
+#include "thingdef_exp.h"
+
+enum
+{
+	FXOP_LOADK,			// A = Constants[Arg]
+	FXOP_SELF,			// A = self
+	FXOP_MEMBER_INT,	// A = int at B + Arg
+	FXOP_MEMBER_BOOL,	// A = bool at B + Arg
+	FXOP_MEMBER_FLOAT,	// A = double at B + Arg
+	FXOP_MEMBER_FIXED,	// A = fixed_t at B + Arg
+	FXOP_MEMBER_ANGLE,	// A = angle_t at B + Arg
+	FXOP_MEMBER_ANY,	// A = member variable Pointers[Arg] of B
+	FXOP_MEMBER_ADDR,	// A = address of B + Arg
+	FXOP_GLOBAL,		// A = global variable Pointers[Arg]
+	FXOP_INDEX,			// A = B[C], Arg is the array size
+	FXOP_EVAL,			// A = expression Pointers[Arg] evaluated by the tree
+
+	FXOP_INTCAST,
+	FXOP_NEGI,
+	FXOP_NEGF,
+	FXOP_BITNOT,
+	FXOP_LNOT,
+	FXOP_BOOL,
+	FXOP_ABS,
+
+	FXOP_ADDI,
+	FXOP_SUBI,
+	FXOP_MULI,
+	FXOP_DIVI,
+	FXOP_MODI,
+	FXOP_SHL,
+	FXOP_SHR,
+	FXOP_USHR,
+	FXOP_AND,
+	FXOP_OR,
+	FXOP_XOR,
+
+	FXOP_ADDF,
+	FXOP_SUBF,
+	FXOP_MULF,
+	FXOP_DIVF,
+	FXOP_MODF,
+
+	FXOP_LTI,
+	FXOP_GTI,
+	FXOP_GEI,
+	FXOP_LEI,
+	FXOP_EQI,
+	FXOP_NEI,
+
+	FXOP_LTF,
+	FXOP_GTF,
+	FXOP_GEF,
+	FXOP_LEF,
+	FXOP_EQF,
+	FXOP_NEF,
+
+	FXOP_JMP,			// goto Arg
+	FXOP_JMPF,			// if (!A) goto Arg
+	FXOP_JMPT,			// if (A) goto Arg
+
+	FXOP_RANDOM,		// A = RNGs[Arg]()
+	FXOP_RANDOMRANGE,	// A = random number between B and C from RNGs[Arg]
+	FXOP_FRANDOM,		// A = float random number in [0,1) from RNGs[Arg]
+	FXOP_FRANDOMRANGE,	// A = A scaled to the range between B and C
+	FXOP_RANDOM2,		// A = RNGs[Arg]->Random2(B)
+
+	FXOP_RET			// return A
+};
+
+//==========================================================================
+//
+// FxCompiler
+//
+//==========================================================================
+
+class FxCompiler
+{
+public:
+	FxProgram *Prog;
+	int NumUsed;
+	bool Failed;
+
+	FxCompiler(FxProgram *prog)
+	{
+		Prog = prog;
+		NumUsed = 0;
+		Failed = false;
+	}
+
+	// Registers are handed out like a stack.
+	int AllocReg()
+	{
+		if (NumUsed >= FX_MAXREGS)
+		{
+			Failed = true;
+			return FX_MAXREGS - 1;
+		}
+		NumUsed++;
+		if (NumUsed > Prog->NumRegs) Prog->NumRegs = NumUsed;
+		return NumUsed - 1;
+	}
+
+	void FreeReg()
+	{
+		if (NumUsed > 0) NumUsed--;
+	}
+
+	int Emit(int op, int a = 0, int b = 0, int c = 0, int arg = 0)
+	{
+		FxInstruction ins;
+		ins.Op = BYTE(op);
+		ins.A = BYTE(a);
+		ins.B = BYTE(b);
+		ins.C = BYTE(c);
+		ins.Arg = arg;
+		return Prog->Code.Push(ins);
+	}
+
+	// Points a jump at the next instruction to be emitted.
+	void Patch(int jump)
+	{
+		Prog->Code[jump].Arg = Prog->Code.Size();
+	}
+
+	int LastOp() const
+	{
+		return Prog->Code.Size() > 0 ? Prog->Code[Prog->Code.Size() - 1].Op : -1;
+	}
+
+	int AddConstant(const ExpVal &val)
+	{
+		return Prog->Constants.Push(val);
+	}
+
+	int AddPointer(void *ptr)
+	{
+		return Prog->Pointers.Push(ptr);
+	}
+
+	int AddRNG(FRandom *rng)
+	{
+		for (unsigned i = 0; i < Prog->RNGs.Size(); ++i)
+		{
+			if (Prog->RNGs[i] == rng) return i;
+		}
+		return Prog->RNGs.Push(rng);
+	}
+
+	void EmitInt(int dest, int val)
+	{
+		ExpVal v;
+		v.Type = VAL_Int;
+		v.Int = val;
+		Emit(FXOP_LOADK, dest, 0, 0, AddConstant(v));
+	}
+
+	void EmitBinary(FxExpression *left, FxExpression *right, int op, int dest)
+	{
+		left->Emit(*this, dest);
+		int r = AllocReg();
+		right->Emit(*this, r);
+		Emit(op, dest, dest, r);
+		FreeReg();
+	}
+};
+
+//==========================================================================
+//
+// Anything that doesn't know how to compile itself is run by the tree.
+//
+//==========================================================================
+
+void FxExpression::Emit(FxCompiler &comp, int dest)
+{
+	comp.Emit(FXOP_EVAL, dest, 0, 0, comp.AddPointer(this));
+	comp.Prog->NumFallbacks++;
+	comp.Prog->Pure = false;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FxConstant::Emit(FxCompiler &comp, int dest)
+{
+	comp.Emit(FXOP_LOADK, dest, 0, 0, comp.AddConstant(value));
+}
+
+void FxIntCast::Emit(FxCompiler &comp, int dest)
+{
+	basex->Emit(comp, dest);
+	comp.Emit(FXOP_INTCAST, dest, dest);
+}
+
+void FxMinusSign::Emit(FxCompiler &comp, int dest)
+{
+	Operand->Emit(comp, dest);
+	comp.Emit(ValueType == VAL_Int ? FXOP_NEGI : FXOP_NEGF, dest, dest);
+}
+
+void FxUnaryNotBitwise::Emit(FxCompiler &comp, int dest)
+{
+	Operand->Emit(comp, dest);
+	comp.Emit(FXOP_BITNOT, dest, dest);
+}
+
+void FxUnaryNotBoolean::Emit(FxCompiler &comp, int dest)
+{
+	Operand->Emit(comp, dest);
+	comp.Emit(FXOP_LNOT, dest, dest);
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FxAddSub::Emit(FxCompiler &comp, int dest)
+{
+	if (Operator != '+' && Operator != '-')
+	{
+		FxExpression::Emit(comp, dest);
+	}
+	else if (ValueType == VAL_Float)
+	{
+		comp.EmitBinary(left, right, Operator == '+' ? FXOP_ADDF : FXOP_SUBF, dest);
+	}
+	else
+	{
+		comp.EmitBinary(left, right, Operator == '+' ? FXOP_ADDI : FXOP_SUBI, dest);
+	}
+}
+
+void FxMulDiv::Emit(FxCompiler &comp, int dest)
+{
+	bool isfloat = ValueType == VAL_Float;
+	int op;
+
+	switch (Operator)
+	{
+	case '*':	op = isfloat ? FXOP_MULF : FXOP_MULI;	break;
+	case '/':	op = isfloat ? FXOP_DIVF : FXOP_DIVI;	break;
+	case '%':	op = isfloat ? FXOP_MODF : FXOP_MODI;	break;
+	default:	FxExpression::Emit(comp, dest);			return;
+	}
+	// A variable divisor may abort the game with "Division by 0".
+	if (Operator != '*' && !right->isConstant())
+	{
+		comp.Prog->Pure = false;
+	}
+	comp.EmitBinary(left, right, op, dest);
+}
+
+void FxCompareRel::Emit(FxCompiler &comp, int dest)
+{
+	bool isfloat = left->ValueType == VAL_Float || right->ValueType == VAL_Float;
+	int op;
+
+	switch (Operator)
+	{
+	case '<':		op = isfloat ? FXOP_LTF : FXOP_LTI;	break;
+	case '>':		op = isfloat ? FXOP_GTF : FXOP_GTI;	break;
+	case TK_Geq:	op = isfloat ? FXOP_GEF : FXOP_GEI;	break;
+	case TK_Leq:	op = isfloat ? FXOP_LEF : FXOP_LEI;	break;
+	default:		FxExpression::Emit(comp, dest);		return;
+	}
+	comp.EmitBinary(left, right, op, dest);
+}
+
+void FxCompareEq::Emit(FxCompiler &comp, int dest)
+{
+	if (left->ValueType == VAL_Float || right->ValueType == VAL_Float)
+	{
+		comp.EmitBinary(left, right, Operator == TK_Eq ? FXOP_EQF : FXOP_NEF, dest);
+	}
+	else if (ValueType == VAL_Int)
+	{
+		comp.EmitBinary(left, right, Operator == TK_Eq ? FXOP_EQI : FXOP_NEI, dest);
+	}
+	else
+	{
+		comp.EmitInt(dest, 0);
+	}
+}
+
+void FxBinaryInt::Emit(FxCompiler &comp, int dest)
+{
+	int op;
+
+	switch (Operator)
+	{
+	case TK_LShift:		op = FXOP_SHL;	break;
+	case TK_RShift:		op = FXOP_SHR;	break;
+	case TK_URShift:	op = FXOP_USHR;	break;
+	case '&':			op = FXOP_AND;	break;
+	case '|':			op = FXOP_OR;	break;
+	case '^':			op = FXOP_XOR;	break;
+	default:			FxExpression::Emit(comp, dest);	return;
+	}
+	comp.EmitBinary(left, right, op, dest);
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FxBinaryLogical::Emit(FxCompiler &comp, int dest)
+{
+	left->Emit(comp, dest);
+	if (Operator == TK_AndAnd || Operator == TK_OrOr)
+	{
+		comp.Emit(FXOP_BOOL, dest, dest);
+		int jump = comp.Emit(Operator == TK_AndAnd ? FXOP_JMPF : FXOP_JMPT, dest);
+		right->Emit(comp, dest);
+		comp.Emit(FXOP_BOOL, dest, dest);
+		comp.Patch(jump);
+	}
+	else
+	{
+		comp.EmitInt(dest, 0);
+	}
+}
+
+void FxConditional::Emit(FxCompiler &comp, int dest)
+{
+	condition->Emit(comp, dest);
+	int jumpfalse = comp.Emit(FXOP_JMPF, dest);
+	truex->Emit(comp, dest);
+	int jumpend = comp.Emit(FXOP_JMP);
+	comp.Patch(jumpfalse);
+	falsex->Emit(comp, dest);
+	comp.Patch(jumpend);
+}
+
+void FxAbs::Emit(FxCompiler &comp, int dest)
+{
+	val->Emit(comp, dest);
+	comp.Emit(FXOP_ABS, dest, dest);
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FxRandom::Emit(FxCompiler &comp, int dest)
+{
+	int rngindex = comp.AddRNG(rng);
+
+	if (min != NULL && max != NULL)
+	{
+		min->Emit(comp, dest);
+		int r = comp.AllocReg();
+		max->Emit(comp, r);
+		comp.Emit(FXOP_RANDOMRANGE, dest, dest, r, rngindex);
+		comp.FreeReg();
+	}
+	else
+	{
+		comp.Emit(FXOP_RANDOM, dest, 0, 0, rngindex);
+	}
+}
+
+void FxFRandom::Emit(FxCompiler &comp, int dest)
+{
+	// The number is drawn before the range is evaluated.
+	comp.Emit(FXOP_FRANDOM, dest, 0, 0, comp.AddRNG(rng));
+	if (min != NULL && max != NULL)
+	{
+		int rmin = comp.AllocReg();
+		int rmax = comp.AllocReg();
+		min->Emit(comp, rmin);
+		max->Emit(comp, rmax);
+		comp.Emit(FXOP_FRANDOMRANGE, dest, rmin, rmax);
+		comp.FreeReg();
+		comp.FreeReg();
+	}
+}
+
+void FxRandom2::Emit(FxCompiler &comp, int dest)
+{
+	mask->Emit(comp, dest);
+	comp.Emit(FXOP_RANDOM2, dest, dest, 0, comp.AddRNG(rng));
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+void FxSelf::Emit(FxCompiler &comp, int dest)
+{
+	comp.Emit(FXOP_SELF, dest);
+}
+
+void FxGlobalVariable::Emit(FxCompiler &comp, int dest)
+{
+	if (AddressRequested)
+	{
+		ExpVal v;
+		v.Type = VAL_Pointer;
+		v.pointer = (void*)var->offset;
+		comp.Emit(FXOP_LOADK, dest, 0, 0, comp.AddConstant(v));
+	}
+	else
+	{
+		comp.Emit(FXOP_GLOBAL, dest, 0, 0, comp.AddPointer(var));
+	}
+}
+
+void FxClassMember::Emit(FxCompiler &comp, int dest)
+{
+	if (classx->ValueType == VAL_Class)
+	{
+		// The tree doesn't implement this either and aborts.
+		FxExpression::Emit(comp, dest);
+		return;
+	}
+	classx->Emit(comp, dest);
+	// Anything but self might be a NULL pointer.
+	if (comp.LastOp() != FXOP_SELF)
+	{
+		comp.Prog->Pure = false;
+	}
+
+	int op;
+	int arg = int(membervar->offset);
+
+	if (AddressRequested)
+	{
+		op = FXOP_MEMBER_ADDR;
+	}
+	else switch (membervar->ValueType.Type)
+	{
+	case VAL_Int:		op = FXOP_MEMBER_INT;	break;
+	case VAL_Bool:		op = FXOP_MEMBER_BOOL;	break;
+	case VAL_Float:		op = FXOP_MEMBER_FLOAT;	break;
+	case VAL_Fixed:		op = FXOP_MEMBER_FIXED;	break;
+	case VAL_Angle:		op = FXOP_MEMBER_ANGLE;	break;
+	default:
+		op = FXOP_MEMBER_ANY;
+		arg = comp.AddPointer(membervar);
+		break;
+	}
+	comp.Emit(op, dest, dest, 0, arg);
+}
+
+void FxArrayElement::Emit(FxCompiler &comp, int dest)
+{
+	// A variable index may abort the game with "Array index out of bounds".
+	if (!index->isConstant())
+	{
+		comp.Prog->Pure = false;
+	}
+	Array->Emit(comp, dest);
+	int r = comp.AllocReg();
+	index->Emit(comp, r);
+	comp.Emit(FXOP_INDEX, dest, dest, r, Array->ValueType.size);
+	comp.FreeReg();
+}
+
+//==========================================================================
+//
+// FxProgram :: Compile
+//
+// Returns NULL if the expression needs more registers than there are.
+//
+//==========================================================================
+
+FxProgram *FxProgram::Compile(FxExpression *x)
+{
+	FxProgram *prog = new FxProgram;
+	FxCompiler comp(prog);
+
+	prog->NumRegs = 0;
+	prog->NumFallbacks = 0;
+	prog->Pure = true;
+
+	int dest = comp.AllocReg();
+	x->Emit(comp, dest);
+	comp.Emit(FXOP_RET, dest);
+
+	if (comp.Failed)
+	{
+		delete prog;
+		return NULL;
+	}
+	prog->Code.ShrinkToFit();
+	prog->Constants.ShrinkToFit();
+	prog->Pointers.ShrinkToFit();
+	prog->RNGs.ShrinkToFit();
+	return prog;
+}
+
+//==========================================================================
+//
+// FxProgram :: Execute
+//
+//==========================================================================
+
+ExpVal FxProgram::Execute(AActor *self) const
+{
+	ExpVal regs[FX_MAXREGS];
+	const FxInstruction *code = &Code[0];
+	const FxInstruction *pc = code;
+
+	for (;;)
+	{
+		const FxInstruction &i = *pc++;
+		ExpVal &a = regs[i.A];
+		const ExpVal &b = regs[i.B];
+		const ExpVal &c = regs[i.C];
+
+		switch (i.Op)
+		{
+		case FXOP_LOADK:
+			a = Constants[i.Arg];
+			break;
+
+		case FXOP_SELF:
+			a.Type = VAL_Object;
+			a.pointer = self;
+			break;
+
+		case FXOP_MEMBER_INT:
+		case FXOP_MEMBER_BOOL:
+		case FXOP_MEMBER_FLOAT:
+		case FXOP_MEMBER_FIXED:
+		case FXOP_MEMBER_ANGLE:
+		case FXOP_MEMBER_ADDR:
+		{
+			char *object = b.GetPointer<char>();
+			if (object == NULL)
+			{
+				I_Error("Accessing member variable without valid object");
+			}
+			object += i.Arg;
+			switch (i.Op)
+			{
+			case FXOP_MEMBER_INT:
+				a.Type = VAL_Int;
+				a.Int = *(int*)object;
+				break;
+			case FXOP_MEMBER_BOOL:
+				a.Type = VAL_Int;
+				a.Int = *(bool*)object;
+				break;
+			case FXOP_MEMBER_FLOAT:
+				a.Type = VAL_Float;
+				a.Float = *(double*)object;
+				break;
+			case FXOP_MEMBER_FIXED:
+				a.Type = VAL_Float;
+				a.Float = (*(fixed_t*)object) / 65536.;
+				break;
+			case FXOP_MEMBER_ANGLE:
+				a.Type = VAL_Float;
+				a.Float = (*(angle_t*)object) * 90./ANGLE_90;
+				break;
+			default:
+				a.Type = VAL_Pointer;
+				a.pointer = object;
+				break;
+			}
+			break;
+		}
+
+		case FXOP_MEMBER_ANY:
+		{
+			char *object = b.GetPointer<char>();
+			if (object == NULL)
+			{
+				I_Error("Accessing member variable without valid object");
+			}
+			PSymbolVariable *var = (PSymbolVariable *)Pointers[i.Arg];
+			a = GetVariableValue(object + var->offset, var->ValueType);
+			break;
+		}
+
+		case FXOP_GLOBAL:
+		{
+			PSymbolVariable *var = (PSymbolVariable *)Pointers[i.Arg];
+			a = GetVariableValue((void*)var->offset, var->ValueType);
+			break;
+		}
+
+		case FXOP_INDEX:
+		{
+			int *arraystart = b.GetPointer<int>();
+			int indexval = c.GetInt();
+
+			if (indexval < 0 || indexval >= i.Arg)
+			{
+				I_Error("Array index out of bounds");
+			}
+			a.Type = VAL_Int;
+			a.Int = arraystart[indexval];
+			break;
+		}
+
+		case FXOP_EVAL:
+			a = ((FxExpression *)Pointers[i.Arg])->EvalExpression(self);
+			break;
+
+		case FXOP_INTCAST:
+			a.Int = b.GetInt();
+			a.Type = VAL_Int;
+			break;
+
+		case FXOP_NEGI:
+			a.Int = -b.GetInt();
+			a.Type = VAL_Int;
+			break;
+
+		case FXOP_NEGF:
+			a.Float = -b.GetFloat();
+			a.Type = VAL_Float;
+			break;
+
+		case FXOP_BITNOT:
+			a.Int = ~b.GetInt();
+			a.Type = VAL_Int;
+			break;
+
+		case FXOP_LNOT:
+			a.Int = !b.GetBool();
+			a.Type = VAL_Int;
+			break;
+
+		case FXOP_BOOL:
+			a.Int = b.GetBool();
+			a.Type = VAL_Int;
+			break;
+
+		case FXOP_ABS:
+			if (b.Type == VAL_Float)
+			{
+				a.Float = fabs(b.Float);
+			}
+			else
+			{
+				a.Int = abs(b.Int);
+			}
+			a.Type = b.Type;
+			break;
+
+#define INTOP(op, expr) \
+		case op: \
+		{ \
+			int v1 = b.GetInt(), v2 = c.GetInt(); \
+			a.Int = (expr); \
+			a.Type = VAL_Int; \
+			break; \
+		}
+#define FLOATOP(op, expr) \
+		case op: \
+		{ \
+			double v1 = b.GetFloat(), v2 = c.GetFloat(); \
+			a.Float = (expr); \
+			a.Type = VAL_Float; \
+			break; \
+		}
+#define FLOATCMP(op, expr) \
+		case op: \
+		{ \
+			double v1 = b.GetFloat(), v2 = c.GetFloat(); \
+			a.Int = (expr); \
+			a.Type = VAL_Int; \
+			break; \
+		}
+
+		INTOP(FXOP_ADDI, v1 + v2)
+		INTOP(FXOP_SUBI, v1 - v2)
+		INTOP(FXOP_MULI, v1 * v2)
+		INTOP(FXOP_SHL, v1 << v2)
+		INTOP(FXOP_SHR, v1 >> v2)
+		INTOP(FXOP_USHR, int((unsigned int)(v1) >> v2))
+		INTOP(FXOP_AND, v1 & v2)
+		INTOP(FXOP_OR, v1 | v2)
+		INTOP(FXOP_XOR, v1 ^ v2)
+		INTOP(FXOP_LTI, v1 < v2)
+		INTOP(FXOP_GTI, v1 > v2)
+		INTOP(FXOP_GEI, v1 >= v2)
+		INTOP(FXOP_LEI, v1 <= v2)
+		INTOP(FXOP_EQI, v1 == v2)
+		INTOP(FXOP_NEI, v1 != v2)
+
+		FLOATOP(FXOP_ADDF, v1 + v2)
+		FLOATOP(FXOP_SUBF, v1 - v2)
+		FLOATOP(FXOP_MULF, v1 * v2)
+		FLOATCMP(FXOP_LTF, v1 < v2)
+		FLOATCMP(FXOP_GTF, v1 > v2)
+		FLOATCMP(FXOP_GEF, v1 >= v2)
+		FLOATCMP(FXOP_LEF, v1 <= v2)
+		FLOATCMP(FXOP_EQF, v1 == v2)
+		FLOATCMP(FXOP_NEF, v1 != v2)
+
+#undef INTOP
+#undef FLOATOP
+#undef FLOATCMP
+
+		case FXOP_DIVI:
+		case FXOP_MODI:
+		{
+			int v1 = b.GetInt(), v2 = c.GetInt();
+			if (v2 == 0)
+			{
+				I_Error("Division by 0");
+			}
+			a.Int = i.Op == FXOP_DIVI ? v1 / v2 : v1 % v2;
+			a.Type = VAL_Int;
+			break;
+		}
+
+		case FXOP_DIVF:
+		case FXOP_MODF:
+		{
+			double v1 = b.GetFloat(), v2 = c.GetFloat();
+			if (v2 == 0)
+			{
+				I_Error("Division by 0");
+			}
+			a.Float = i.Op == FXOP_DIVF ? v1 / v2 : fmod(v1, v2);
+			a.Type = VAL_Float;
+			break;
+		}
+
+		case FXOP_JMP:
+			pc = code + i.Arg;
+			break;
+
+		case FXOP_JMPF:
+			if (!a.GetBool()) pc = code + i.Arg;
+			break;
+
+		case FXOP_JMPT:
+			if (a.GetBool()) pc = code + i.Arg;
+			break;
+
+		case FXOP_RANDOM:
+			a.Int = (*RNGs[i.Arg])();
+			a.Type = VAL_Int;
+			break;
+
+		case FXOP_RANDOMRANGE:
+		{
+			int minval = b.GetInt(), maxval = c.GetInt();
+			if (maxval < minval)
+			{
+				swapvalues (maxval, minval);
+			}
+			a.Int = (*RNGs[i.Arg])(maxval - minval + 1) + minval;
+			a.Type = VAL_Int;
+			break;
+		}
+
+		case FXOP_FRANDOM:
+			a.Float = (*RNGs[i.Arg])(0x40000000) / double(0x40000000);
+			a.Type = VAL_Float;
+			break;
+
+		case FXOP_FRANDOMRANGE:
+		{
+			double minval = b.GetFloat(), maxval = c.GetFloat();
+			if (maxval < minval)
+			{
+				swapvalues (maxval, minval);
+			}
+			a.Float = a.Float * (maxval - minval) + minval;
+			break;
+		}
+
+		case FXOP_RANDOM2:
+			a.Int = RNGs[i.Arg]->Random2(b.GetInt());
+			a.Type = VAL_Int;
+			break;
+
+		case FXOP_RET:
+			return a;
+		}
+	}
+}
+
+//==========================================================================
+//
+// CCMD decoratebench
+//
+// Evaluates every compiled DECORATE expression that can safely run outside
+// of its action function, once with the tree and once as bytecode, and
+// reports the time taken and any results that differ. The random number
+// generators are put back afterwards, so this doesn't affect play.
+//
+//==========================================================================
+
+static bool SameValue(const ExpVal &a, const ExpVal &b)
+{
+	if (a.Type != b.Type) return false;
+	switch (a.Type)
+	{
+	case VAL_Float:
+		return a.Float == b.Float;
+	case VAL_Int:
+	case VAL_Sound:
+	case VAL_Name:
+	case VAL_Color:
+		return a.Int == b.Int;
+	default:
+		return a.pointer == b.pointer;
+	}
+}
+
+CCMD (decoratebench)
+{
+	int runs = argv.argc() > 1 ? atoi(argv[1]) : 100;
+
+	if (gamestate != GS_LEVEL || players[consoleplayer].mo == NULL)
+	{
+		Printf ("You must be in a level to use this command.\n");
+		return;
+	}
+	if (runs < 1)
+	{
+		runs = 1;
+	}
+
+	AActor *self = players[consoleplayer].mo;
+	TArray<FxExpression *> trees;
+	TArray<FxProgram *> progs, seen;
+	TArray<FRandom *> rngs;
+	unsigned int compiled = 0;
+	int fallbacks = 0;
+
+	for (unsigned int i = 0; i < StateParams.Size(); ++i)
+	{
+		FxProgram *prog = StateParams.GetProgram(i);
+		if (prog == NULL) continue;
+
+		// Copied parameters share their program with the original.
+		unsigned int j;
+		for (j = 0; j < seen.Size(); ++j)
+		{
+			if (seen[j] == prog) break;
+		}
+		if (j < seen.Size()) continue;
+
+		seen.Push(prog);
+		compiled++;
+		fallbacks += prog->NumFallbacks;
+		if (!prog->Pure)
+		{
+			continue;
+		}
+		trees.Push(StateParams.Get(i));
+		progs.Push(prog);
+		for (j = 0; j < prog->RNGs.Size(); ++j)
+		{
+			unsigned int k;
+			for (k = 0; k < rngs.Size(); ++k)
+			{
+				if (rngs[k] == prog->RNGs[j]) break;
+			}
+			if (k == rngs.Size())
+			{
+				rngs.Push(prog->RNGs[j]);
+			}
+		}
+	}
+	if (progs.Size() == 0)
+	{
+		Printf ("There are no expressions to run.\n");
+		return;
+	}
+
+	TArray<DWORD> rngstate;
+	rngstate.Resize(rngs.Size() * FRandom::STATE_SIZE);
+	for (unsigned int i = 0; i < rngs.Size(); ++i)
+	{
+		rngs[i]->SaveState(&rngstate[i * FRandom::STATE_SIZE]);
+	}
+
+	TArray<ExpVal> treeresults(progs.Size());
+	cycle_t treetime, codetime;
+	unsigned int i;
+	int mismatches = 0;
+
+	treetime.Reset();
+	treetime.Clock();
+	for (i = 0; i < progs.Size(); ++i)
+	{
+		treeresults.Push(trees[i]->EvalExpression(self));
+	}
+	for (int run = 1; run < runs; ++run)
+	{
+		for (i = 0; i < progs.Size(); ++i)
+		{
+			trees[i]->EvalExpression(self);
+		}
+	}
+	treetime.Unclock();
+
+	for (i = 0; i < rngs.Size(); ++i)
+	{
+		rngs[i]->RestoreState(&rngstate[i * FRandom::STATE_SIZE]);
+	}
+
+	codetime.Reset();
+	codetime.Clock();
+	for (i = 0; i < progs.Size(); ++i)
+	{
+		if (!SameValue(treeresults[i], progs[i]->Execute(self)))
+		{
+			mismatches++;
+		}
+	}
+	for (int run = 1; run < runs; ++run)
+	{
+		for (i = 0; i < progs.Size(); ++i)
+		{
+			progs[i]->Execute(self);
+		}
+	}
+	codetime.Unclock();
+
+	for (i = 0; i < rngs.Size(); ++i)
+	{
+		rngs[i]->RestoreState(&rngstate[i * FRandom::STATE_SIZE]);
+	}
+
+	Printf ("%u expressions, %u compiled, %d nodes left to the tree, %u run\n",
+		StateParams.Size(), compiled, fallbacks, progs.Size());
+	Printf ("tree: %.3f ms  bytecode: %.3f ms per pass (%.2fx)\n",
+		treetime.TimeMS() / runs, codetime.TimeMS() / runs,
+		codetime.TimeMS() > 0 ? treetime.TimeMS() / codetime.TimeMS() : 0.);
+	if (mismatches > 0)
+	{
+		Printf (TEXTCOLOR_RED "%d results differ from the tree\n", mismatches);
+	}
+}
@@ -50,6 +50,8 @@
 
 extern PSymbolTable		 GlobalSymbols;
 
+class FxCompiler;
+
 //==========================================================================
 //
 //
@@ -165,6 +167,7 @@ public:
 	virtual ExpVal EvalExpression (AActor *self);
 	virtual bool isConstant() const;
 	virtual void RequestAddress();
+	virtual void Emit (FxCompiler &comp, int dest);
 
 	FScriptPosition ScriptPosition;
 	FExpressionType ValueType;
@@ -290,6 +293,7 @@ public:
 		return true;
 	}
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxCompiler &comp, int dest);
 };
 
 
@@ -310,6 +314,7 @@ public:
 	FxExpression *Resolve(FCompileContext&);
 
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxCompiler &comp, int dest);
 };
 
 
@@ -344,6 +349,7 @@ public:
 	~FxMinusSign();
 	FxExpression *Resolve(FCompileContext&);
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxCompiler &comp, int dest);
 };
 
 //==========================================================================
@@ -361,6 +367,7 @@ public:
 	~FxUnaryNotBitwise();
 	FxExpression *Resolve(FCompileContext&);
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxCompiler &comp, int dest);
 };
 
 //==========================================================================
@@ -378,6 +385,7 @@ public:
 	~FxUnaryNotBoolean();
 	FxExpression *Resolve(FCompileContext&);
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxCompiler &comp, int dest);
 };
 
 //==========================================================================
@@ -411,6 +419,7 @@ public:
 	FxAddSub(int, FxExpression*, FxExpression*);
 	FxExpression *Resolve(FCompileContext&);
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxCompiler &comp, int dest);
 };
 
 //==========================================================================
@@ -426,6 +435,7 @@ public:
 	FxMulDiv(int, FxExpression*, FxExpression*);
 	FxExpression *Resolve(FCompileContext&);
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxCompiler &comp, int dest);
 };
 
 //==========================================================================
@@ -441,6 +451,7 @@ public:
 	FxCompareRel(int, FxExpression*, FxExpression*);
 	FxExpression *Resolve(FCompileContext&);
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxCompiler &comp, int dest);
 };
 
 //==========================================================================
@@ -456,6 +467,7 @@ public:
 	FxCompareEq(int, FxExpression*, FxExpression*);
 	FxExpression *Resolve(FCompileContext&);
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxCompiler &comp, int dest);
 };
 
 //==========================================================================
@@ -471,6 +483,7 @@ public:
 	FxBinaryInt(int, FxExpression*, FxExpression*);
 	FxExpression *Resolve(FCompileContext&);
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxCompiler &comp, int dest);
 };
 
 //==========================================================================
@@ -491,6 +504,7 @@ public:
 	FxExpression *Resolve(FCompileContext&);
 
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxCompiler &comp, int dest);
 };
 
 //==========================================================================
@@ -511,6 +525,7 @@ public:
 	FxExpression *Resolve(FCompileContext&);
 
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxCompiler &comp, int dest);
 };
 
 //==========================================================================
@@ -530,6 +545,7 @@ public:
 	FxExpression *Resolve(FCompileContext&);
 
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxCompiler &comp, int dest);
 };
 
 //==========================================================================
@@ -551,6 +567,7 @@ public:
 	FxExpression *Resolve(FCompileContext&);
 
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxCompiler &comp, int dest);
 };
 
 //==========================================================================
@@ -564,6 +581,7 @@ class FxFRandom : public FxRandom
 public:
 	FxFRandom(FRandom *, FxExpression *mi, FxExpression *ma, const FScriptPosition &pos);
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxCompiler &comp, int dest);
 };
 
 //==========================================================================
@@ -584,6 +602,7 @@ public:
 	FxExpression *Resolve(FCompileContext&);
 
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxCompiler &comp, int dest);
 };
 
 
@@ -603,6 +622,7 @@ public:
 	FxExpression *Resolve(FCompileContext&);
 	void RequestAddress();
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxCompiler &comp, int dest);
 };
 
 //==========================================================================
@@ -623,6 +643,7 @@ public:
 	FxExpression *Resolve(FCompileContext&);
 	void RequestAddress();
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxCompiler &comp, int dest);
 };
 
 //==========================================================================
@@ -637,6 +658,7 @@ public:
 	FxSelf(const FScriptPosition&);
 	FxExpression *Resolve(FCompileContext&);
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxCompiler &comp, int dest);
 };
 
 //==========================================================================
@@ -657,6 +679,7 @@ public:
 	FxExpression *Resolve(FCompileContext&);
 	//void RequestAddress();
 	ExpVal EvalExpression (AActor *self);
+	void Emit (FxCompiler &comp, int dest);
 };
 
 
@@ -803,6 +826,42 @@ public:
 
 
 
+//==========================================================================
+//
+//	FxProgram
+//
+//	An expression tree compiled into a flat list of instructions that work
+//	on a small register file. Nodes without their own Emit method are
+//	called through their EvalExpression.
+//
+//==========================================================================
+
+enum { FX_MAXREGS = 32 };
+
+struct FxInstruction
+{
+	BYTE Op;
+	BYTE A, B, C;
+	int Arg;
+};
+
+class FxProgram
+{
+public:
+	TArray<FxInstruction> Code;
+	TArray<ExpVal> Constants;
+	TArray<void *> Pointers;
+	TArray<FRandom *> RNGs;		// every random generator it draws from
+	int NumRegs;
+	int NumFallbacks;			// nodes run through EvalExpression
+	bool Pure;					// can be run outside of an action without harm
+
+	static FxProgram *Compile (FxExpression *x);
+	ExpVal Execute (AActor *self) const;
+};
+
+ExpVal GetVariableValue (void *address, FExpressionType &type);
+
 FxExpression *ParseExpression (FScanner &sc, PClass *cls);
 
 
@@ -100,42 +100,40 @@ DEFINE_MEMBER_VARIABLE(meleerange, AActor)
 
 int EvalExpressionI (DWORD xi, AActor *self)
 {
-	FxExpression *x = StateParams.Get(xi);
-	if (x == NULL) return 0;
+	ExpVal val;
+	if (!StateParams.Eval(xi, self, val)) return 0;
 
-	return x->EvalExpression (self).GetInt();
+	return val.GetInt();
 }
 
 int EvalExpressionCol (DWORD xi, AActor *self)
 {
-	FxExpression *x = StateParams.Get(xi);
-	if (x == NULL) return 0;
+	ExpVal val;
+	if (!StateParams.Eval(xi, self, val)) return 0;
 
-	return x->EvalExpression (self).GetColor();
+	return val.GetColor();
 }
 
 FSoundID EvalExpressionSnd (DWORD xi, AActor *self)
 {
-	FxExpression *x = StateParams.Get(xi);
-	if (x == NULL) return 0;
+	ExpVal val;
+	if (!StateParams.Eval(xi, self, val)) return 0;
 
-	return x->EvalExpression (self).GetSoundID();
+	return val.GetSoundID();
 }
 
 double EvalExpressionF (DWORD xi, AActor *self)
 {
-	FxExpression *x = StateParams.Get(xi);
-	if (x == NULL) return 0;
+	ExpVal val;
+	if (!StateParams.Eval(xi, self, val)) return 0;
 
-	return x->EvalExpression (self).GetFloat();
+	return val.GetFloat();
 }
 
 fixed_t EvalExpressionFix (DWORD xi, AActor *self)
 {
-	FxExpression *x = StateParams.Get(xi);
-	if (x == NULL) return 0;
-
-	ExpVal val = x->EvalExpression (self);
+	ExpVal val;
+	if (!StateParams.Eval(xi, self, val)) return 0;
 
 	switch (val.Type)
 	{
@@ -150,26 +148,26 @@ fixed_t EvalExpressionFix (DWORD xi, AActor *self)
 
 FName EvalExpressionName (DWORD xi, AActor *self)
 {
-	FxExpression *x = StateParams.Get(xi);
-	if (x == NULL) return 0;
+	ExpVal val;
+	if (!StateParams.Eval(xi, self, val)) return 0;
 
-	return x->EvalExpression (self).GetName();
+	return val.GetName();
 }
 
 const PClass * EvalExpressionClass (DWORD xi, AActor *self)
 {
-	FxExpression *x = StateParams.Get(xi);
-	if (x == NULL) return 0;
+	ExpVal val;
+	if (!StateParams.Eval(xi, self, val)) return 0;
 
-	return x->EvalExpression (self).GetClass();
+	return val.GetClass();
 }
 
 FState *EvalExpressionState (DWORD xi, AActor *self)
 {
-	FxExpression *x = StateParams.Get(xi);
-	if (x == NULL) return 0;
+	ExpVal val;
+	if (!StateParams.Eval(xi, self, val)) return 0;
 
-	return x->EvalExpression (self).GetState();
+	return val.GetState();
 }
 
 
@@ -179,7 +177,7 @@ FState *EvalExpressionState (DWORD xi, AActor *self)
 //
 //==========================================================================
 
-static ExpVal GetVariableValue (void *address, FExpressionType &type)
+ExpVal GetVariableValue (void *address, FExpressionType &type)
 {
 	// NOTE: This cannot access native variables of types
 	// char, short and float. These need to be redefined if necessary!
@@ -2754,6 +2752,10 @@ void FStateExpressions::Clear()
 		{
 			delete expressions[i].expr;
 		}
+		if (expressions[i].program != NULL && !expressions[i].cloned)
+		{
+			delete expressions[i].program;
+		}
 	}
 	expressions.Clear();
 }
@@ -2769,6 +2771,7 @@ int FStateExpressions::Add(FxExpression *x, const PClass *o, bool c)
 	int idx = expressions.Reserve(1);
 	FStateExpression &exp = expressions[idx];
 	exp.expr = x;
+	exp.program = NULL;
 	exp.owner = o;
 	exp.constant = c;
 	exp.cloned = false;
@@ -2788,6 +2791,7 @@ int FStateExpressions::Reserve(int num, const PClass *cls)
 	for(int i=0; i<num; i++)
 	{
 		exp[i].expr = NULL;
+		exp[i].program = NULL;
 		exp[i].owner = cls;
 		exp[i].constant = false;
 		exp[i].cloned = false;
@@ -2846,6 +2850,7 @@ int FStateExpressions::ResolveAll()
 			// Now that everything coming before has been resolved we may copy the actual pointer.
 			unsigned ii = unsigned((intptr_t)expressions[i].expr);
 			expressions[i].expr = expressions[ii].expr;
+			expressions[i].program = expressions[ii].program;
 		}
 		else if (expressions[i].expr != NULL)
 		{
@@ -2861,6 +2866,10 @@ int FStateExpressions::ResolveAll()
 				expressions[i].expr->ScriptPosition.Message(MSG_ERROR, "Constant expression expected");
 				errorcount++;
 			}
+			else
+			{
+				expressions[i].program = FxProgram::Compile(expressions[i].expr);
+			}
 		}
 	}
 
@@ -2892,3 +2901,32 @@ FxExpression *FStateExpressions::Get(int num)
 	return NULL;
 }
 
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+FxProgram *FStateExpressions::GetProgram(int num)
+{
+	if (num >= 0 && num < int(Size()))
+		return expressions[num].program;
+	return NULL;
+}
+
+//==========================================================================
+//
+// Runs the compiled form of an expression if there is one.
+//
+//==========================================================================
+
+bool FStateExpressions::Eval(int num, AActor *self, ExpVal &val)
+{
+	if (num < 0 || num >= int(Size()) || expressions[num].expr == NULL)
+		return false;
+
+	FxProgram *prog = expressions[num].program;
+	val = prog != NULL ? prog->Execute(self) : expressions[num].expr->EvalExpression(self);
+	return true;
+}
+
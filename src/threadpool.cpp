@@ -0,0 +1,473 @@
+/*
+** threadpool.cpp
+** A minimal pool of worker threads for splitting up heavy loops
+**
+**---------------------------------------------------------------------------
+** Copyright 2012 The ZDoom Team
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+** The pool is deliberately simple: there is only ever one job in flight,
+** the thread that submits it works on it too, and slices are handed out
+** first come, first served. Anything that needs a particular order must
+** impose it itself after Run() returns.
+*/
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include "doomtype.h"
+#include "templates.h"
+#include "i_system.h"
+#include "threadpool.h"
+
+// PUBLIC DATA DEFINITIONS -------------------------------------------------
+
+FThreadPool ThreadPool;
+
+// CODE --------------------------------------------------------------------
+
+#ifdef _WIN32
+
+struct FThreadPool::Signals
+{
+	HANDLE Wake;			// Released once per worker for every job
+	HANDLE Done;			// Released by each worker when it runs out of slices
+	CRITICAL_SECTION SliceLock;
+	bool Quit;
+};
+
+struct FThreadPool::Worker
+{
+	HANDLE Thread;
+	FThreadPool *Pool;
+	int Index;
+
+	static DWORD WINAPI Main(LPVOID arg)
+	{
+		Worker *self = (Worker *)arg;
+		Signals *sync = self->Pool->Sync;
+
+		for (;;)
+		{
+			WaitForSingleObject(sync->Wake, INFINITE);
+			if (sync->Quit)
+			{
+				break;
+			}
+			self->Pool->RunSlices(self->Index);
+			ReleaseSemaphore(sync->Done, 1, NULL);
+		}
+		return 0;
+	}
+};
+
+static FThreadPool::Signals *CreateSignals()
+{
+	FThreadPool::Signals *sync = new FThreadPool::Signals;
+	sync->Wake = CreateSemaphore(NULL, 0, FThreadPool::MAX_THREADS, NULL);
+	sync->Done = CreateSemaphore(NULL, 0, FThreadPool::MAX_THREADS, NULL);
+	InitializeCriticalSection(&sync->SliceLock);
+	sync->Quit = false;
+	if (sync->Wake == NULL || sync->Done == NULL)
+	{
+		I_FatalError("Could not create thread pool semaphores.");
+	}
+	return sync;
+}
+
+static void DestroySignals(FThreadPool::Signals *sync)
+{
+	CloseHandle(sync->Wake);
+	CloseHandle(sync->Done);
+	DeleteCriticalSection(&sync->SliceLock);
+	delete sync;
+}
+
+static bool StartWorker(FThreadPool::Signals *sync, FThreadPool::Worker *worker)
+{
+	DWORD id;
+	worker->Thread = CreateThread(NULL, 0, FThreadPool::Worker::Main, worker, 0, &id);
+	return worker->Thread != NULL;
+}
+
+static void StopWorkers(FThreadPool::Signals *sync, FThreadPool::Worker **workers, int count)
+{
+	sync->Quit = true;
+	ReleaseSemaphore(sync->Wake, count, NULL);
+	for (int i = 0; i < count; ++i)
+	{
+		WaitForSingleObject(workers[i]->Thread, INFINITE);
+		CloseHandle(workers[i]->Thread);
+	}
+	sync->Quit = false;
+}
+
+static void StartJob(FThreadPool::Signals *sync, int numworkers)
+{
+	ReleaseSemaphore(sync->Wake, numworkers, NULL);
+}
+
+static void FinishJob(FThreadPool::Signals *sync, int numworkers)
+{
+	for (int i = 0; i < numworkers; ++i)
+	{
+		WaitForSingleObject(sync->Done, INFINITE);
+	}
+}
+
+static void LockSlices(FThreadPool::Signals *sync)
+{
+	EnterCriticalSection(&sync->SliceLock);
+}
+
+static void UnlockSlices(FThreadPool::Signals *sync)
+{
+	LeaveCriticalSection(&sync->SliceLock);
+}
+
+int FThreadPool::GetProcessorCount()
+{
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return MAX<int>(1, info.dwNumberOfProcessors);
+}
+
+#else
+
+struct FThreadPool::Signals
+{
+	pthread_mutex_t Lock;
+	pthread_cond_t Wake;
+	pthread_cond_t Done;
+	int Generation;			// Incremented for every job
+	int Busy;				// Number of workers still inside the current job
+	bool Quit;
+};
+
+struct FThreadPool::Worker
+{
+	pthread_t Thread;
+	FThreadPool *Pool;
+	int Index;
+	int Generation;
+
+	static void *Main(void *arg)
+	{
+		Worker *self = (Worker *)arg;
+		Signals *sync = self->Pool->Sync;
+
+		pthread_mutex_lock(&sync->Lock);
+		for (;;)
+		{
+			while (!sync->Quit && sync->Generation == self->Generation)
+			{
+				pthread_cond_wait(&sync->Wake, &sync->Lock);
+			}
+			if (sync->Quit)
+			{
+				break;
+			}
+			self->Generation = sync->Generation;
+			pthread_mutex_unlock(&sync->Lock);
+
+			self->Pool->RunSlices(self->Index);
+
+			pthread_mutex_lock(&sync->Lock);
+			if (--sync->Busy == 0)
+			{
+				pthread_cond_signal(&sync->Done);
+			}
+		}
+		pthread_mutex_unlock(&sync->Lock);
+		return NULL;
+	}
+};
+
+static FThreadPool::Signals *CreateSignals()
+{
+	FThreadPool::Signals *sync = new FThreadPool::Signals;
+	pthread_mutex_init(&sync->Lock, NULL);
+	pthread_cond_init(&sync->Wake, NULL);
+	pthread_cond_init(&sync->Done, NULL);
+	sync->Generation = 0;
+	sync->Busy = 0;
+	sync->Quit = false;
+	return sync;
+}
+
+static void DestroySignals(FThreadPool::Signals *sync)
+{
+	pthread_cond_destroy(&sync->Done);
+	pthread_cond_destroy(&sync->Wake);
+	pthread_mutex_destroy(&sync->Lock);
+	delete sync;
+}
+
+static bool StartWorker(FThreadPool::Signals *sync, FThreadPool::Worker *worker)
+{
+	// Workers are only ever added between jobs, so reading the generation
+	// without the lock is safe here.
+	worker->Generation = sync->Generation;
+	return pthread_create(&worker->Thread, NULL, FThreadPool::Worker::Main, worker) == 0;
+}
+
+static void StopWorkers(FThreadPool::Signals *sync, FThreadPool::Worker **workers, int count)
+{
+	pthread_mutex_lock(&sync->Lock);
+	sync->Quit = true;
+	pthread_cond_broadcast(&sync->Wake);
+	pthread_mutex_unlock(&sync->Lock);
+	for (int i = 0; i < count; ++i)
+	{
+		pthread_join(workers[i]->Thread, NULL);
+	}
+	sync->Quit = false;
+}
+
+static void StartJob(FThreadPool::Signals *sync, int numworkers)
+{
+	pthread_mutex_lock(&sync->Lock);
+	sync->Busy = numworkers;
+	sync->Generation++;
+	pthread_cond_broadcast(&sync->Wake);
+	pthread_mutex_unlock(&sync->Lock);
+}
+
+static void FinishJob(FThreadPool::Signals *sync, int numworkers)
+{
+	pthread_mutex_lock(&sync->Lock);
+	while (sync->Busy > 0)
+	{
+		pthread_cond_wait(&sync->Done, &sync->Lock);
+	}
+	pthread_mutex_unlock(&sync->Lock);
+}
+
+static void LockSlices(FThreadPool::Signals *sync)
+{
+	pthread_mutex_lock(&sync->Lock);
+}
+
+static void UnlockSlices(FThreadPool::Signals *sync)
+{
+	pthread_mutex_unlock(&sync->Lock);
+}
+
+int FThreadPool::GetProcessorCount()
+{
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count < 1 ? 1 : (int)count;
+}
+
+#endif
+
+//==========================================================================
+//
+// FThreadPool Constructor
+//
+//==========================================================================
+
+FThreadPool::FThreadPool()
+{
+	Sync = NULL;
+	NumWorkers = 0;
+	CurrentJob = NULL;
+	CurrentData = NULL;
+	NumSlices = 0;
+	NextSlice = 0;
+}
+
+//==========================================================================
+//
+// FThreadPool Destructor
+//
+//==========================================================================
+
+FThreadPool::~FThreadPool()
+{
+	Shutdown();
+}
+
+//==========================================================================
+//
+// ShutdownThreadPool
+//
+//==========================================================================
+
+static void ShutdownThreadPool()
+{
+	ThreadPool.Shutdown();
+}
+
+//==========================================================================
+//
+// FThreadPool :: Reserve
+//
+// Starts more worker threads if fewer than count threads are available.
+// Workers are never stopped until shutdown, since an idle one costs
+// nothing but a little memory.
+//
+//==========================================================================
+
+void FThreadPool::Reserve(int count)
+{
+	if (count > MAX_THREADS)
+	{
+		count = MAX_THREADS;
+	}
+	if (count <= NumWorkers + 1)
+	{
+		return;
+	}
+	if (Sync == NULL)
+	{
+		Sync = CreateSignals();
+		if (this == &ThreadPool)
+		{
+			atterm(ShutdownThreadPool);
+		}
+	}
+	while (NumWorkers + 1 < count)
+	{
+		Worker *worker = new Worker;
+		worker->Pool = this;
+		worker->Index = NumWorkers + 1;
+		if (!StartWorker(Sync, worker))
+		{
+			delete worker;
+			Printf("Could only start %d worker threads.\n", NumWorkers);
+			break;
+		}
+		Workers[NumWorkers++] = worker;
+	}
+}
+
+//==========================================================================
+//
+// FThreadPool :: Shutdown
+//
+//==========================================================================
+
+void FThreadPool::Shutdown()
+{
+	if (Sync != NULL)
+	{
+		StopWorkers(Sync, Workers, NumWorkers);
+		for (int i = 0; i < NumWorkers; ++i)
+		{
+			delete Workers[i];
+		}
+		NumWorkers = 0;
+		DestroySignals(Sync);
+		Sync = NULL;
+	}
+}
+
+//==========================================================================
+//
+// FThreadPool :: Run
+//
+// Calls func for every slice and returns when they are all done.
+//
+//==========================================================================
+
+void FThreadPool::Run(JobFunc func, void *userdata, int numslices)
+{
+	if (numslices <= 0)
+	{
+		return;
+	}
+	if (NumWorkers == 0 || numslices == 1)
+	{
+		for (int i = 0; i < numslices; ++i)
+		{
+			func(userdata, i, 0);
+		}
+		return;
+	}
+
+	// Don't bother waking up workers that will not find anything to do.
+	int numworkers = MIN(NumWorkers, numslices - 1);
+
+	CurrentJob = func;
+	CurrentData = userdata;
+	NumSlices = numslices;
+	NextSlice = 0;
+
+#ifdef _WIN32
+	StartJob(Sync, numworkers);
+	RunSlices(0);
+	FinishJob(Sync, numworkers);
+#else
+	// The pthread version wakes everybody with a broadcast, so every
+	// worker needs to check in.
+	numworkers = NumWorkers;
+	StartJob(Sync, numworkers);
+	RunSlices(0);
+	FinishJob(Sync, numworkers);
+#endif
+
+	CurrentJob = NULL;
+	CurrentData = NULL;
+}
+
+//==========================================================================
+//
+// FThreadPool :: NextJobSlice
+//
+//==========================================================================
+
+int FThreadPool::NextJobSlice()
+{
+	int slice;
+
+	LockSlices(Sync);
+	slice = NextSlice++;
+	UnlockSlices(Sync);
+	return slice;
+}
+
+//==========================================================================
+//
+// FThreadPool :: RunSlices
+//
+//==========================================================================
+
+void FThreadPool::RunSlices(int thread)
+{
+	int slice;
+
+	while ((slice = NextJobSlice()) < NumSlices)
+	{
+		CurrentJob(CurrentData, slice, thread);
+	}
+}
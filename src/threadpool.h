@@ -0,0 +1,90 @@
+/*
+** threadpool.h
+**
+**---------------------------------------------------------------------------
+** Copyright 2012 The ZDoom Team
+** All rights reserved.
+**
+** Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions
+** are met:
+**
+** 1. Redistributions of source code must retain the above copyright
+**    notice, this list of conditions and the following disclaimer.
+** 2. Redistributions in binary form must reproduce the above copyright
+**    notice, this list of conditions and the following disclaimer in the
+**    documentation and/or other materials provided with the distribution.
+** 3. The name of the author may not be used to endorse or promote products
+**    derived from this software without specific prior written permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+** IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+** OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+** IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+** INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+** NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+** THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**---------------------------------------------------------------------------
+**
+*/
+
+#ifndef __THREADPOOL_H
+#define __THREADPOOL_H
+
+// Storage class for variables that need one copy per worker thread.
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+// A set of worker threads that split a job into slices. The calling thread
+// always takes part in the work, so a pool with no workers simply runs every
+// slice in sequence. Jobs do not overlap: Run() returns only after every
+// slice has been finished.
+class FThreadPool
+{
+public:
+	enum { MAX_THREADS = 64 };
+
+	// slice is in [0,numslices); thread is in [0,GetThreadCount()) and is
+	// 0 for the thread that called Run().
+	typedef void (*JobFunc)(void *userdata, int slice, int thread);
+
+	FThreadPool();
+	~FThreadPool();
+
+	// Makes sure at least count threads (including the caller) are available.
+	void Reserve(int count);
+	void Shutdown();
+	int GetThreadCount() const { return NumWorkers + 1; }
+
+	void Run(JobFunc func, void *userdata, int numslices);
+
+	static int GetProcessorCount();
+
+	struct Worker;
+	struct Signals;
+
+private:
+	void RunSlices(int thread);
+	int NextJobSlice();
+
+	Signals *Sync;
+	Worker *Workers[MAX_THREADS];
+	int NumWorkers;
+
+	JobFunc CurrentJob;
+	void *CurrentData;
+	int NumSlices;
+	int NextSlice;
+
+	friend struct Worker;
+};
+
+extern FThreadPool ThreadPool;
+
+#endif
@@ -73,7 +73,7 @@ int CleanWidth, CleanHeight;
 int CleanXfac_1, CleanYfac_1, CleanWidth_1, CleanHeight_1;
 
 // FillSimplePoly uses this
-extern "C" short spanend[MAXHEIGHT];
+extern "C" COLUMN_TLS short spanend[MAXHEIGHT];
 
 CVAR (Bool, hud_scale, false, CVAR_ARCHIVE);
 
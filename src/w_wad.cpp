@@ -47,6 +47,7 @@
 #include "i_system.h"
 #include "cmdlib.h"
 #include "c_dispatch.h"
+#include "c_cvars.h"
 #include "w_wad.h"
 #include "w_zip.h"
 #include "m_crc32.h"
@@ -56,6 +57,8 @@
 #include "doomerrors.h"
 #include "resourcefiles/resourcefile.h"
 #include "md5.h"
+#include "stats.h"
+#include "threadpool.h"
 
 // MACROS ------------------------------------------------------------------
 
@@ -83,6 +86,9 @@ static void PrintLastError ();
 
 FWadCollection Wads;
 
+// Decompress the lumps a level needs on every core before precaching it.
+CVAR (Bool, lump_prefetch, true, CVAR_ARCHIVE)
+
 // PRIVATE DATA DEFINITIONS ------------------------------------------------
 
 // CODE --------------------------------------------------------------------
@@ -105,9 +111,7 @@ void uppercopy (char *to, const char *from)
 }
 
 FWadCollection::FWadCollection ()
-: FirstLumpIndex(NULL), NextLumpIndex(NULL),
-  FirstLumpIndex_FullName(NULL), NextLumpIndex_FullName(NULL), 
-  NumLumps(0)
+: NumLumps(0), PrefetchedLumps(0), PrefetchedBytes(0), PrefetchMS(0)
 {
 }
 
@@ -118,26 +122,10 @@ FWadCollection::~FWadCollection ()
 
 void FWadCollection::DeleteAll ()
 {
-	if (FirstLumpIndex != NULL)
-	{
-		delete[] FirstLumpIndex;
-		FirstLumpIndex = NULL;
-	}
-	if (NextLumpIndex != NULL)
-	{
-		delete[] NextLumpIndex;
-		NextLumpIndex = NULL;
-	}
-	if (FirstLumpIndex_FullName != NULL)
-	{
-		delete[] FirstLumpIndex_FullName;
-		FirstLumpIndex_FullName = NULL;
-	}
-	if (NextLumpIndex_FullName != NULL)
-	{
-		delete[] NextLumpIndex_FullName;
-		NextLumpIndex_FullName = NULL;
-	}
+	// The lumps are about to go away along with their files.
+	Prefetched.Clear();
+	ShortNameIndex.Clear();
+	FullNameIndex.Clear();
 
 	LumpInfo.Clear();
 	NumLumps = 0;
@@ -185,10 +173,6 @@ void FWadCollection::InitMultipleFiles (TArray<FString> &filenames)
 	RenameSprites();
 
 	// [RH] Set up hash table
-	FirstLumpIndex = new DWORD[NumLumps];
-	NextLumpIndex = new DWORD[NumLumps];
-	FirstLumpIndex_FullName = new DWORD[NumLumps];
-	NextLumpIndex_FullName = new DWORD[NumLumps];
 	InitHashChains ();
 	LumpInfo.ShrinkToFit();
 	Files.ShrinkToFit();
@@ -243,7 +227,7 @@ void FWadCollection::AddFile (const char *filename, FileReader *wadinfo)
 		{
 			try
 			{
-				wadinfo = new FileReader(filename);
+				wadinfo = new MappedFileReader(filename);
 			}
 			catch (CRecoverableError &err)
 			{ // Didn't find file
@@ -397,24 +381,22 @@ int FWadCollection::CheckNumForName (const char *name, int space)
 	}
 
 	uppercopy (uname, name);
-	i = FirstLumpIndex[LumpNameHash (uname) % NumLumps];
+	i = ShortNameIndex.Find (qname);
 
+	// Every lump in the chain has this name, so only the namespace is left to check.
 	while (i != NULL_INDEX)
 	{
 		FResourceLump *lump = LumpInfo[i].lump;
 
-		if (lump->qwName == qname)
-		{
-			if (lump->Namespace == space) break;
-			// If the lump is from one of the special namespaces exclusive to Zips
-			// the check has to be done differently:
-			// If we find a lump with this name in the global namespace that does not come
-			// from a Zip return that. WADs don't know these namespaces and single lumps must
-			// work as well.
-			if (space > ns_specialzipdirectory && lump->Namespace == ns_global && 
-				!(lump->Flags & LUMPF_ZIPFILE)) break;
-		}
-		i = NextLumpIndex[i];
+		if (lump->Namespace == space) break;
+		// If the lump is from one of the special namespaces exclusive to Zips
+		// the check has to be done differently:
+		// If we find a lump with this name in the global namespace that does not come
+		// from a Zip return that. WADs don't know these namespaces and single lumps must
+		// work as well.
+		if (space > ns_specialzipdirectory && lump->Namespace == ns_global && 
+			!(lump->Flags & LUMPF_ZIPFILE)) break;
+		i = ShortNameIndex.Next (i);
 	}
 
 	return i != NULL_INDEX ? i : -1;
@@ -436,17 +418,16 @@ int FWadCollection::CheckNumForName (const char *name, int space, int wadnum, bo
 	}
 
 	uppercopy (uname, name);
-	i = FirstLumpIndex[LumpNameHash (uname) % NumLumps];
+	i = ShortNameIndex.Find (qname);
 
 	// If exact is true if will only find lumps in the same WAD, otherwise
 	// also those in earlier WADs.
 
 	while (i != NULL_INDEX &&
-		(lump = LumpInfo[i].lump, lump->qwName != qname ||
-		lump->Namespace != space ||
+		(lump = LumpInfo[i].lump, lump->Namespace != space ||
 		 (exact? (LumpInfo[i].wadnum != wadnum) : (LumpInfo[i].wadnum > wadnum)) ))
 	{
-		i = NextLumpIndex[i];
+		i = ShortNameIndex.Next (i);
 	}
 
 	return i != NULL_INDEX ? i : -1;
@@ -492,11 +473,11 @@ int FWadCollection::CheckNumForFullName (const char *name, bool trynormal, int n
 		return -1;
 	}
 
-	i = FirstLumpIndex_FullName[MakeKey (name) % NumLumps];
+	i = FullNameIndex.Find (FullNameKey (name));
 
 	while (i != NULL_INDEX && stricmp(name, LumpInfo[i].lump->FullName))
 	{
-		i = NextLumpIndex_FullName[i];
+		i = FullNameIndex.Next (i);
 	}
 
 	if (i != NULL_INDEX) return i;
@@ -517,12 +498,12 @@ int FWadCollection::CheckNumForFullName (const char *name, int wadnum)
 		return CheckNumForFullName (name);
 	}
 
-	i = FirstLumpIndex_FullName[MakeKey (name) % NumLumps];
+	i = FullNameIndex.Find (FullNameKey (name));
 
 	while (i != NULL_INDEX && 
 		(stricmp(name, LumpInfo[i].lump->FullName) || LumpInfo[i].wadnum != wadnum))
 	{
-		i = NextLumpIndex_FullName[i];
+		i = FullNameIndex.Next (i);
 	}
 
 	return i != NULL_INDEX ? i : -1;
@@ -637,31 +618,142 @@ DWORD FWadCollection::LumpNameHash (const char *s)
 
 void FWadCollection::InitHashChains (void)
 {
-	char name[8];
-	unsigned int i, j;
+	unsigned int i;
 
-	// Mark all buckets as empty
-	memset (FirstLumpIndex, 255, NumLumps*sizeof(FirstLumpIndex[0]));
-	memset (NextLumpIndex, 255, NumLumps*sizeof(NextLumpIndex[0]));
-	memset (FirstLumpIndex_FullName, 255, NumLumps*sizeof(FirstLumpIndex_FullName[0]));
-	memset (NextLumpIndex_FullName, 255, NumLumps*sizeof(NextLumpIndex_FullName[0]));
+	ShortNameIndex.Init (NumLumps);
+	FullNameIndex.Init (NumLumps);
 
-	// Now set up the chains
+	// Lookups compare the whole 8 characters at once, so the name itself is
+	// the key. Later lumps override earlier ones, so insert them in order.
 	for (i = 0; i < (unsigned)NumLumps; i++)
 	{
-		uppercopy (name, LumpInfo[i].lump->Name);
-		j = LumpNameHash (name) % NumLumps;
-		NextLumpIndex[i] = FirstLumpIndex[j];
-		FirstLumpIndex[j] = i;
+		ShortNameIndex.Insert (LumpInfo[i].lump->qwName, i);
 
 		// Do the same for the full paths
 		if (LumpInfo[i].lump->FullName!=NULL)
 		{
-			j = MakeKey(LumpInfo[i].lump->FullName) % NumLumps;
-			NextLumpIndex_FullName[i] = FirstLumpIndex_FullName[j];
-			FirstLumpIndex_FullName[j] = i;
+			FullNameIndex.Insert (FullNameKey (LumpInfo[i].lump->FullName), i);
+		}
+	}
+}
+
+//==========================================================================
+//
+// FullNameKey
+//
+// Two independent case insensitive 32-bit hashes, so different names
+// practically never end up sharing a key.
+//
+//==========================================================================
+
+QWORD FWadCollection::FullNameKey (const char *name)
+{
+	DWORD fnv = 2166136261u;
+
+	for (const char *c = name; *c != 0; ++c)
+	{
+		fnv = (fnv ^ BYTE(tolower(*c))) * 16777619u;
+	}
+	return (QWORD(fnv) << 32) | MakeKey (name);
+}
+
+//==========================================================================
+//
+// FLumpIndex
+//
+//==========================================================================
+
+void FLumpIndex::Init (DWORD numlumps)
+{
+	DWORD size = 16;
+
+	Clear ();
+	// Keep the table at most half full so probe sequences stay short.
+	while (size < numlumps * 2)
+	{
+		size <<= 1;
+	}
+	Slots = new Slot[size];
+	for (DWORD i = 0; i < size; ++i)
+	{
+		Slots[i].Key = 0;
+		Slots[i].First = NULL_INDEX;
+	}
+	NextLump = new DWORD[numlumps > 0 ? numlumps : 1];
+	Mask = size - 1;
+	NumKeys = 0;
+}
+
+void FLumpIndex::Clear ()
+{
+	if (Slots != NULL)
+	{
+		delete[] Slots;
+		Slots = NULL;
+	}
+	if (NextLump != NULL)
+	{
+		delete[] NextLump;
+		NextLump = NULL;
+	}
+	Mask = 0;
+	NumKeys = 0;
+}
+
+static inline DWORD LumpIndexHash (QWORD key)
+{
+	DWORD hash = (DWORD(key) * 0x9E3779B1u) ^ (DWORD(key >> 32) * 0x85EBCA77u);
+	return hash ^ (hash >> 16);
+}
+
+// Returns the slot holding the key or the empty slot where it would go.
+DWORD FLumpIndex::Probe (QWORD key) const
+{
+	DWORD i = LumpIndexHash (key) & Mask;
+
+	while (Slots[i].First != NULL_INDEX && Slots[i].Key != key)
+	{
+		i = (i + 1) & Mask;
+	}
+	return i;
+}
+
+void FLumpIndex::Insert (QWORD key, DWORD lump)
+{
+	Slot *slot = &Slots[Probe (key)];
+
+	if (slot->First == NULL_INDEX)
+	{
+		slot->Key = key;
+		NumKeys++;
+	}
+	NextLump[lump] = slot->First;
+	slot->First = lump;
+}
+
+DWORD FLumpIndex::Find (QWORD key) const
+{
+	if (Slots == NULL)
+	{
+		return NULL_INDEX;
+	}
+	return Slots[Probe (key)].First;
+}
+
+DWORD FLumpIndex::GetLongestProbe () const
+{
+	DWORD longest = 0;
+
+	for (DWORD i = 0; i <= Mask && Slots != NULL; ++i)
+	{
+		if (Slots[i].First != NULL_INDEX)
+		{
+			// Distance from the key's home slot to where it actually lives
+			DWORD len = ((i - LumpIndexHash (Slots[i].Key)) & Mask) + 1;
+			longest = MAX (longest, len);
 		}
 	}
+	return longest;
 }
 
 //==========================================================================
@@ -1157,6 +1249,141 @@ FileReader *FWadCollection::GetFileReader(int wadnum)
 	return Files[wadnum]->GetReader();
 }
 
+//==========================================================================
+//
+// PrefetchLumps
+//
+// Fills the cache of every compressed lump in the list. The compressed
+// data is gathered on this thread, since the archives can only be read
+// from one place at a time, and then decompressed by the thread pool.
+// Each lump keeps one cache reference until ReleasePrefetchedLumps is
+// called, so everything that reads them in between gets them for free.
+//
+//==========================================================================
+
+struct FLumpPrefetch
+{
+	FResourceLump *Lump;
+	const char *Data;
+	char *Storage;
+	char *Dest;
+	bool Ok;
+};
+
+static void DecompressPrefetchedLump (void *userdata, int slice, int thread)
+{
+	FLumpPrefetch *job = &(*(TArray<FLumpPrefetch> *)userdata)[slice];
+
+	try
+	{
+		job->Ok = job->Lump->Decompress (job->Data, job->Dest);
+	}
+	catch (...)
+	{
+		// Leave it for FillCache, which will report the error properly.
+		job->Ok = false;
+	}
+}
+
+void FWadCollection::PrefetchLumps (const TArray<int> &lumps)
+{
+	TArray<FLumpPrefetch> jobs;
+	cycle_t time;
+	unsigned int i;
+
+	if (!lump_prefetch)
+	{
+		return;
+	}
+
+	time.Reset();
+	time.Clock();
+	for (i = 0; i < lumps.Size(); ++i)
+	{
+		if ((unsigned)lumps[i] >= NumLumps)
+		{
+			continue;
+		}
+		FResourceLump *lump = LumpInfo[lumps[i]].lump;
+		FLumpPrefetch job;
+
+		if (lump->Cache != NULL || lump->LumpSize <= 0)
+		{
+			continue;
+		}
+		if (lump->ReadCompressed (job.Data, job.Storage))
+		{
+			job.Lump = lump;
+			job.Dest = new char[lump->LumpSize];
+			job.Ok = false;
+			// Mark it so a lump listed twice is only done once.
+			lump->Cache = job.Dest;
+			lump->RefCount = 0;
+			jobs.Push (job);
+		}
+	}
+	if (jobs.Size() > 0)
+	{
+		ThreadPool.Reserve (FThreadPool::GetProcessorCount());
+		ThreadPool.Run (DecompressPrefetchedLump, &jobs, jobs.Size());
+	}
+	for (i = 0; i < jobs.Size(); ++i)
+	{
+		FLumpPrefetch *job = &jobs[i];
+
+		if (job->Storage != NULL)
+		{
+			delete[] job->Storage;
+		}
+		if (job->Ok)
+		{
+			job->Lump->RefCount = 1;
+			Prefetched.Push (job->Lump);
+			PrefetchedLumps++;
+			PrefetchedBytes += job->Lump->LumpSize;
+		}
+		else
+		{
+			job->Lump->Cache = NULL;
+			delete[] job->Dest;
+		}
+	}
+	time.Unclock();
+	PrefetchMS += time.TimeMS();
+}
+
+//==========================================================================
+//
+// ReleasePrefetchedLumps
+//
+// Drops the references PrefetchLumps holds. Lumps nobody else has cached
+// in the meantime go to the idle list and are freed once lump_cachesize
+// runs out.
+//
+//==========================================================================
+
+void FWadCollection::ReleasePrefetchedLumps ()
+{
+	for (unsigned int i = 0; i < Prefetched.Size(); ++i)
+	{
+		Prefetched[i]->ReleaseCache ();
+	}
+	Prefetched.Clear();
+}
+
+void FWadCollection::GetPrefetchStats (int &lumps, int &bytes, double &ms) const
+{
+	lumps = PrefetchedLumps;
+	bytes = PrefetchedBytes;
+	ms = PrefetchMS;
+}
+
+void FWadCollection::ResetPrefetchStats ()
+{
+	PrefetchedLumps = PrefetchedBytes = 0;
+	PrefetchMS = 0;
+}
+
 //==========================================================================
 //
 // W_GetWadName
@@ -1482,3 +1709,135 @@ static void PrintLastError ()
 	Printf (TEXTCOLOR_RED "  %s\n", strerror(errno));
 }
 #endif
+
+//==========================================================================
+//
+// CCMD lumphashbench
+//
+// Looks up the short and full name of every lump in the collection.
+// With a lump count, it builds indexes for that many made up lumps
+// instead, since a stock IWAD has only a few thousand.
+//
+//==========================================================================
+
+void LumpHashBench (int runs)
+{
+	TArray<int> namespaces;
+	cycle_t shorttime, fulltime;
+	int found = 0, fullnames = 0;
+	DWORD i;
+
+	for (i = 0; i < Wads.NumLumps; ++i)
+	{
+		namespaces.Push (Wads.LumpInfo[i].lump->Namespace);
+		if (Wads.LumpInfo[i].lump->FullName != NULL) fullnames++;
+	}
+
+	shorttime.Reset();
+	fulltime.Reset();
+	for (int run = 0; run < runs; ++run)
+	{
+		shorttime.Clock();
+		for (i = 0; i < Wads.NumLumps; ++i)
+		{
+			if (Wads.CheckNumForName (Wads.LumpInfo[i].lump->Name, namespaces[i]) >= 0) found++;
+		}
+		shorttime.Unclock();
+
+		fulltime.Clock();
+		for (i = 0; i < Wads.NumLumps; ++i)
+		{
+			const char *fullname = Wads.LumpInfo[i].lump->FullName;
+			if (fullname != NULL && Wads.CheckNumForFullName (fullname) >= 0) found++;
+		}
+		fulltime.Unclock();
+	}
+
+	Printf ("%u lumps, %d with full names, %d lookups found\n", Wads.NumLumps, fullnames, found);
+	Printf ("short names: %u keys in %u slots, longest probe %u, %.1f ns per lookup\n",
+		Wads.ShortNameIndex.GetNumKeys(), Wads.ShortNameIndex.GetNumSlots(), Wads.ShortNameIndex.GetLongestProbe(),
+		shorttime.TimeMS() * 1000000 / MAX<double>(1, double(Wads.NumLumps) * runs));
+	Printf ("full names: %u keys in %u slots, longest probe %u, %.1f ns per lookup\n",
+		Wads.FullNameIndex.GetNumKeys(), Wads.FullNameIndex.GetNumSlots(), Wads.FullNameIndex.GetLongestProbe(),
+		fulltime.TimeMS() * 1000000 / MAX<double>(1, double(fullnames) * runs));
+}
+
+static void SyntheticLumpHashBench (int runs, DWORD numlumps)
+{
+	FLumpIndex shortindex, fullindex;
+	TArray<QWORD> shortkeys;
+	TArray<int> namespaces;
+	TArray<FString> fullnames;
+	cycle_t shorttime, fulltime;
+	int found = 0;
+	DWORD i;
+
+	// Eight character names spread over a few namespaces, every one also
+	// with a path as if it came from a .pk3.
+	shortkeys.Resize (numlumps);
+	namespaces.Resize (numlumps);
+	fullnames.Resize (numlumps);
+	shortindex.Init (numlumps);
+	fullindex.Init (numlumps);
+	for (i = 0; i < numlumps; ++i)
+	{
+		union
+		{
+			char name[9];
+			QWORD qname;
+		};
+		mysnprintf (name, countof(name), "L%07X", i);
+		shortkeys[i] = qname;
+		namespaces[i] = i % 4;
+		fullnames[i].Format ("textures/set%u/lump%u.png", i / 1000, i);
+		shortindex.Insert (qname, i);
+		fullindex.Insert (FWadCollection::FullNameKey (fullnames[i]), i);
+	}
+
+	shorttime.Reset();
+	fulltime.Reset();
+	for (int run = 0; run < runs; ++run)
+	{
+		shorttime.Clock();
+		for (i = 0; i < numlumps; ++i)
+		{
+			DWORD lump = shortindex.Find (shortkeys[i]);
+			while (lump != NULL_INDEX && namespaces[lump] != namespaces[i])
+			{
+				lump = shortindex.Next (lump);
+			}
+			if (lump != NULL_INDEX) found++;
+		}
+		shorttime.Unclock();
+
+		fulltime.Clock();
+		for (i = 0; i < numlumps; ++i)
+		{
+			if (fullindex.Find (FWadCollection::FullNameKey (fullnames[i])) != NULL_INDEX) found++;
+		}
+		fulltime.Unclock();
+	}
+
+	Printf ("%u synthetic lumps, %d lookups found\n", numlumps, found);
+	Printf ("short names: %u keys in %u slots, longest probe %u, %.1f ns per lookup\n",
+		shortindex.GetNumKeys(), shortindex.GetNumSlots(), shortindex.GetLongestProbe(),
+		shorttime.TimeMS() * 1000000 / MAX<double>(1, double(numlumps) * runs));
+	Printf ("full names: %u keys in %u slots, longest probe %u, %.1f ns per lookup\n",
+		fullindex.GetNumKeys(), fullindex.GetNumSlots(), fullindex.GetLongestProbe(),
+		fulltime.TimeMS() * 1000000 / MAX<double>(1, double(numlumps) * runs));
+}
+
+CCMD (lumphashbench)
+{
+	int runs = argv.argc() > 1 ? atoi(argv[1]) : 10;
+	int numlumps = argv.argc() > 2 ? atoi(argv[2]) : 0;
+
+	if (numlumps > 0)
+	{
+		SyntheticLumpHashBench (MAX (runs, 1), numlumps);
+	}
+	else
+	{
+		LumpHashBench (MAX (runs, 1));
+	}
+}
@@ -137,6 +137,42 @@ private:
 	friend class FWadCollection;
 };
 
+// Maps 64-bit keys to lumps with open addressing. Every distinct key has
+// one slot, and lumps sharing a key are chained from the newest to the
+// oldest, so lookups see the lump that overrides all others first.
+class FLumpIndex
+{
+public:
+	FLumpIndex () : Slots(NULL), NextLump(NULL), Mask(0), NumKeys(0) {}
+	~FLumpIndex () { Clear(); }
+
+	void Init (DWORD numlumps);
+	void Clear ();
+	void Insert (QWORD key, DWORD lump);	// must be called in ascending lump order
+	DWORD Find (QWORD key) const;
+	DWORD Next (DWORD lump) const { return NextLump[lump]; }
+
+	DWORD GetNumSlots () const { return Slots != NULL ? Mask + 1 : 0; }
+	DWORD GetNumKeys () const { return NumKeys; }
+	DWORD GetLongestProbe () const;
+
+private:
+	struct Slot
+	{
+		QWORD Key;
+		DWORD First;	// newest lump with this key, or NULL_INDEX if unused
+	};
+	Slot *Slots;
+	DWORD *NextLump;
+	DWORD Mask;
+	DWORD NumKeys;
+
+	DWORD Probe (QWORD key) const;
+
+	FLumpIndex (const FLumpIndex &) {}
+	FLumpIndex &operator= (const FLumpIndex &) { return *this; }
+};
+
 class FWadCollection
 {
 public:
@@ -182,11 +218,17 @@ public:
 	
 	FileReader * GetFileReader(int wadnum);	// Gets a FileReader object to the entire WAD
 
+	void PrefetchLumps (const TArray<int> &lumps);	// Decompresses lumps into the cache on all cores
+	void ReleasePrefetchedLumps ();
+	void GetPrefetchStats (int &lumps, int &bytes, double &ms) const;
+	void ResetPrefetchStats ();
+
 	int FindLump (const char *name, int *lastlump, bool anyns=false);		// [RH] Find lumps with duplication
 	int FindLumpMulti (const char **names, int *lastlump, bool anyns = false, int *nameindex = NULL); // same with multiple possible names
 	bool CheckLumpName (int lump, const char *name);	// [RH] True if lump's name == name
 
 	static DWORD LumpNameHash (const char *name);		// [RH] Create hash key from an 8-char name
+	static QWORD FullNameKey (const char *name);		// Case insensitive 64-bit key for a full name
 
 	int LumpLength (int lump) const;
 	int GetLumpOffset (int lump);					// [RH] Returns offset of lump in the wadfile
@@ -214,18 +256,21 @@ protected:
 	TArray<FResourceFile *> Files;
 	TArray<LumpRecord> LumpInfo;
 
-	DWORD *FirstLumpIndex;	// [RH] Hashing stuff moved out of lumpinfo structure
-	DWORD *NextLumpIndex;
-
-	DWORD *FirstLumpIndex_FullName;	// The same information for fully qualified paths from .zips
-	DWORD *NextLumpIndex_FullName;
+	FLumpIndex ShortNameIndex;		// keyed by the 8 character name as a QWORD
+	FLumpIndex FullNameIndex;		// keyed by FullNameKey for fully qualified paths from .zips
 
 	DWORD NumLumps;					// Not necessarily the same as LumpInfo.Size()
 	DWORD NumWads;
 
+	TArray<FResourceLump *> Prefetched;	// Lumps holding a cache reference from PrefetchLumps
+	int PrefetchedLumps, PrefetchedBytes;
+	double PrefetchMS;
+
 	void SkinHack (int baselump);
 	void InitHashChains ();								// [RH] Set up the lumpinfo hashing
 
+	friend void LumpHashBench (int runs);
+
 private:
 	void RenameSprites();
 	void RenameNerve();